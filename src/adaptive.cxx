@@ -0,0 +1,267 @@
+///
+/// \file adaptive.cxx
+/// \brief Implementation of LednickyAdaptive
+///
+
+#include "adaptive.h"
+
+#include <algorithm>
+#include <cmath>
+
+const std::size_t LednickyAdaptive::INITIAL_INTERVALS;
+const unsigned LednickyAdaptive::MAX_DEPTH;
+
+namespace {
+
+/// Every round is padded to a multiple of this many points, the lanes of
+/// the widest vector, so that none goes through the scalar remainder loop
+const std::size_t ADAPTIVE_ALIGN = 8;
+
+/// Evaluate `eq` at the first `count` values of `kstar` into `cf`, padding
+/// both to a multiple of ADAPTIVE_ALIGN with the last point
+void
+evaluate_aligned(const LednickyEquation_s& eq,
+                 std::vector<double>& kstar,
+                 std::vector<double>& cf,
+                 std::size_t count)
+{
+  const std::size_t padded = (count + ADAPTIVE_ALIGN - 1) / ADAPTIVE_ALIGN * ADAPTIVE_ALIGN;
+  const double last = kstar[count - 1];
+  kstar.resize(padded, last);
+  cf.resize(padded);
+  evaluate_lednicky_equation(eq, kstar.data(), cf.data(), padded);
+  kstar.resize(count);
+  cf.resize(count);
+}
+
+/// Lagrange weights 1 / prod_{l != i} (t[i] - t[l]) of four points, from
+/// a single division
+inline void
+lagrange_weights(const double *t, double *w)
+{
+  const double d0 = (t[0] - t[1]) * (t[0] - t[2]) * (t[0] - t[3]),
+               d1 = (t[1] - t[0]) * (t[1] - t[2]) * (t[1] - t[3]),
+               d2 = (t[2] - t[0]) * (t[2] - t[1]) * (t[2] - t[3]),
+               d3 = (t[3] - t[0]) * (t[3] - t[1]) * (t[3] - t[2]);
+  // the product of about h^12 stays normal for intervals h above 1e-25
+  const double d01 = d0 * d1,
+               d23 = d2 * d3,
+               inverse = 1.0 / (d01 * d23);
+  w[0] = d1 * d23 * inverse;
+  w[1] = d0 * d23 * inverse;
+  w[2] = d3 * d01 * inverse;
+  w[3] = d2 * d01 * inverse;
+}
+
+/// Value at `x` of the cubic through the four points (t[i], y[i])
+inline double
+cubic_at(const double *t, const double *y, double x)
+{
+  double w[4];
+  lagrange_weights(t, w);
+  const double d0 = x - t[0], d1 = x - t[1], d2 = x - t[2], d3 = x - t[3];
+  return y[0] * w[0] * (d1 * d2 * d3) + y[1] * w[1] * (d0 * d2 * d3)
+         + y[2] * w[2] * (d0 * d1 * d3) + y[3] * w[3] * (d0 * d1 * d2);
+}
+
+/// First of the four grid points around interval `j` of a grid of `points`
+inline std::size_t
+stencil(std::size_t j, std::size_t points)
+{
+  return std::min(j > 0 ? j - 1 : 0, points - 4);
+}
+
+inline double
+horner(const double *c, double u)
+{
+  return ((c[3] * u + c[2]) * u + c[1]) * u + c[0];
+}
+
+} // anonymous namespace
+
+LednickyAdaptive::LednickyAdaptive(double tolerance):
+  _tolerance(tolerance),
+  _error(0.0)
+{
+}
+
+void
+LednickyAdaptive::evaluate(const LednickyEquation_s& eq, double *kstar, double *cf)
+{
+  const int bins = eq.totalBins;
+  const double width = eq.maxKstar / bins;
+  for (int xBin = 0; xBin < bins; xBin++) {
+    kstar[xBin] = (xBin + 0.5) * width;
+  }
+  evaluate(eq, kstar, cf, bins);
+}
+
+void
+LednickyAdaptive::evaluate(const LednickyEquation_s& eq,
+                           const double *kstar,
+                           double *cf,
+                           std::size_t count)
+{
+  _error = 0.0;
+  _grid.clear();
+  _values.clear();
+  if (count == 0) {
+    return;
+  }
+
+  const bool ascending = std::is_sorted(kstar, kstar + count);
+  double lower = kstar[0],
+         upper = kstar[count - 1];
+  if (!ascending) {
+    const std::pair<const double*, const double*> range = std::minmax_element(kstar, kstar + count);
+    lower = *range.first;
+    upper = *range.second;
+  }
+  if (!(lower < upper)) {
+    // a single k*, nothing to interpolate
+    _grid.assign(1, lower);
+    _values.resize(1);
+    evaluate_lednicky_equation(eq, _grid.data(), _values.data(), 1);
+    std::fill(cf, cf + count, _values[0]);
+    return;
+  }
+
+  sample(eq, lower, upper);
+
+  // divided differences of the whole grid, shared by the neighbouring
+  // cubics, then the cubic of every interval in Newton form from its
+  // stencil, multiplied out around the start of the interval
+  const std::size_t points = _grid.size();
+  const double *t = _grid.data(),
+               *y = _values.data();
+  _differences.resize(3 * points);
+  double *d1 = _differences.data(),
+         *d2 = d1 + points,
+         *d3 = d2 + points;
+  for (std::size_t i = 0; i + 1 < points; ++i) {
+    d1[i] = (y[i + 1] - y[i]) / (t[i + 1] - t[i]);
+  }
+  for (std::size_t i = 0; i + 2 < points; ++i) {
+    d2[i] = (d1[i + 1] - d1[i]) / (t[i + 2] - t[i]);
+  }
+  for (std::size_t i = 0; i + 3 < points; ++i) {
+    d3[i] = (d2[i + 1] - d2[i]) / (t[i + 3] - t[i]);
+  }
+
+  _coeffs.resize(4 * (points - 1));
+  for (std::size_t j = 0; j + 1 < points; ++j) {
+    const std::size_t s = stencil(j, points);
+    const double ra = t[s] - t[j],
+                 rb = t[s + 1] - t[j],
+                 rc = t[s + 2] - t[j];
+    // y + (u - ra) (d1 + (u - rb) (d2 + (u - rc) d3)), multiplied out from
+    // the innermost factor
+    const double e0 = d2[s] - rc * d3[s],
+                 f1 = e0 - rb * d3[s],
+                 f0 = d1[s] - rb * e0;
+
+    double *c = &_coeffs[4 * j];
+    c[0] = y[s] - ra * f0;
+    c[1] = f0 - ra * f1;
+    c[2] = f1 - ra * d3[s];
+    c[3] = d3[s];
+  }
+
+  const double *c = _coeffs.data();
+  const std::size_t last = points - 2;
+  if (ascending) {
+    // one pass over the intervals
+    std::size_t i = 0;
+    for (std::size_t j = 0; j < last; ++j) {
+      const double *cj = c + 4 * j;
+      for (; i < count && kstar[i] < t[j + 1]; ++i) {
+        cf[i] = horner(cj, kstar[i] - t[j]);
+      }
+    }
+    for (; i < count; ++i) {
+      cf[i] = horner(c + 4 * last, kstar[i] - t[last]);
+    }
+    return;
+  }
+
+  for (std::size_t i = 0; i < count; ++i) {
+    const double k = kstar[i];
+    const std::size_t j = std::min<std::size_t>(std::upper_bound(t, t + points, k) - t - 1, last);
+    cf[i] = horner(c + 4 * j, k - t[j]);
+  }
+}
+
+void
+LednickyAdaptive::sample(const LednickyEquation_s& eq, double lower, double upper)
+{
+  const int intervals = INITIAL_INTERVALS;
+  const double width = (upper - lower) / intervals;
+  _grid.resize(intervals + 1);
+  for (int i = 0; i < intervals; ++i) {
+    _grid[i] = lower + i * width;
+  }
+  _grid[intervals] = upper;
+  evaluate_aligned(eq, _grid, _values, intervals + 1);
+  _pending.resize(intervals);
+  for (int j = 0; j < intervals; ++j) {
+    _pending[j] = j;
+  }
+
+  for (unsigned depth = 0; depth < MAX_DEPTH && !_pending.empty(); ++depth) {
+    // midpoints of every refining interval, evaluated together
+    const std::size_t points = _grid.size(),
+                      refining = _pending.size();
+    const double *t = _grid.data(),
+                 *y = _values.data();
+    _midpoints.resize(refining);
+    for (std::size_t p = 0; p < refining; ++p) {
+      _midpoints[p] = 0.5 * (t[_pending[p]] + t[_pending[p] + 1]);
+    }
+    evaluate_aligned(eq, _midpoints, _midpoint_values, refining);
+
+    // compare with the cubic of the grid so far, all intervals first so the
+    // divisions overlap
+    _misses.resize(refining);
+    for (std::size_t p = 0; p < refining; ++p) {
+      const std::size_t s = stencil(_pending[p], points);
+      _misses[p] = std::fabs(cubic_at(t + s, y + s, _midpoints[p]) - _midpoint_values[p]);
+    }
+
+    // merge the midpoints in, copying the points between refining intervals
+    // as they are
+    const bool last_round = depth + 1 == MAX_DEPTH;
+    const double tolerance = _tolerance;
+    _next_grid.resize(points + refining);
+    _next_values.resize(points + refining);
+    _next_pending.clear();
+    double *next_t = _next_grid.data(),
+           *next_y = _next_values.data();
+    double error = _error;
+    std::size_t copied = 0;
+    for (std::size_t p = 0; p < refining; ++p) {
+      const std::size_t j = _pending[p],
+                        n = j + p + 1;
+      // runs are short; a loop beats a call to memmove
+      for (; copied <= j; ++copied) {
+        next_t[copied + p] = t[copied];
+        next_y[copied + p] = y[copied];
+      }
+
+      next_t[n] = _midpoints[p];
+      next_y[n] = _midpoint_values[p];
+      if (_misses[p] > tolerance && !last_round) {
+        _next_pending.push_back(n - 1);
+        _next_pending.push_back(n);
+      } else {
+        error = std::max(error, _misses[p]);
+      }
+    }
+    std::copy(t + copied, t + points, next_t + copied + refining);
+    std::copy(y + copied, y + points, next_y + copied + refining);
+    _error = error;
+
+    _grid.swap(_next_grid);
+    _values.swap(_next_values);
+    _pending.swap(_next_pending);
+  }
+}
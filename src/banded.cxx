@@ -0,0 +1,175 @@
+///
+/// \file banded.cxx
+/// \brief Implementation of BandedMatrix
+///
+
+#include "banded.h"
+#include "banded_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+/// Band widths are rounded up to a multiple of this many columns, the
+/// lanes of the widest vector
+static const std::size_t BANDED_ALIGN = 8;
+
+static void
+banded_multiply_add_scalar(const double *values,
+                           const std::uint32_t *first,
+                           std::size_t width,
+                           const double *x,
+                           double scale,
+                           double *y,
+                           std::size_t rows)
+{
+  banded_multiply_add_rows<simd::Vec1d>(values, first, width, x, scale, y, rows);
+}
+
+static banded_multiply_add_t
+select_banded_kernel()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  switch (simd::detect()) {
+  case simd::Level::AVX512:
+    return banded_multiply_add_avx512;
+  case simd::Level::AVX2:
+    return banded_multiply_add_avx2;
+  default:
+    break;
+  }
+#endif
+  return banded_multiply_add_scalar;
+}
+
+static banded_multiply_add_t
+banded_kernel()
+{
+  static const banded_multiply_add_t kernel = select_banded_kernel();
+  return kernel;
+}
+
+BandedMatrix::BandedMatrix():
+  _rows(0),
+  _cols(0),
+  _width(0)
+{
+}
+
+/// `width` rounded up to whole vectors, at most `cols`
+static std::size_t
+band_width(std::size_t width, std::size_t cols)
+{
+  return std::min(cols, (width + BANDED_ALIGN - 1) / BANDED_ALIGN * BANDED_ALIGN);
+}
+
+BandedMatrix::BandedMatrix(std::size_t rows, std::size_t cols, std::size_t width):
+  _rows(rows),
+  _cols(cols),
+  _width(band_width(width, cols)),
+  _first(rows, 0),
+  _values(rows * _width, 0.0)
+{
+}
+
+BandedMatrix
+BandedMatrix::from_dense(const double *dense,
+                         std::size_t rows,
+                         std::size_t cols,
+                         double threshold)
+{
+  // occupied columns [begin, end) of every row
+  std::vector<std::size_t> begin(rows, 0), end(rows, 0);
+  std::size_t width = 0;
+  for (std::size_t i = 0; i < rows; ++i) {
+    const double *row = dense + i * cols;
+    std::size_t b = 0, e = cols;
+    while (b < cols && std::fabs(row[b]) <= threshold) {
+      ++b;
+    }
+    while (e > b && std::fabs(row[e - 1]) <= threshold) {
+      --e;
+    }
+    begin[i] = b;
+    end[i] = e;
+    width = std::max(width, e - b);
+  }
+
+  BandedMatrix m(rows, cols, width);
+  for (std::size_t i = 0; i < rows; ++i) {
+    if (begin[i] < end[i]) {
+      m.set_row(i, begin[i], dense + i * cols + begin[i], end[i] - begin[i]);
+    }
+  }
+  return m;
+}
+
+void
+BandedMatrix::set_row(std::size_t row, std::size_t col, const double *values, std::size_t count)
+{
+  if (row >= _rows || count > _width || col + count > _cols) {
+    throw std::invalid_argument("row does not fit into the band of the BandedMatrix");
+  }
+  // padding goes to the right unless the band would leave the matrix
+  const std::size_t first = std::min(col, _cols - _width);
+  double *band = _values.data() + row * _width;
+  std::fill(band, band + _width, 0.0);
+  std::copy(values, values + count, band + (col - first));
+  _first[row] = first;
+}
+
+double
+BandedMatrix::at(std::size_t row, std::size_t col) const
+{
+  if (row >= _rows || col >= _cols) {
+    throw std::out_of_range("BandedMatrix index out of range");
+  }
+  const std::size_t first = _first[row];
+  if (col < first || col >= first + _width) {
+    return 0.0;
+  }
+  return _values[row * _width + (col - first)];
+}
+
+void
+BandedMatrix::normalize_rows()
+{
+  for (std::size_t i = 0; i < _rows; ++i) {
+    double *row = _values.data() + i * _width;
+    double total = 0.0;
+    for (std::size_t j = 0; j < _width; ++j) {
+      total += row[j];
+    }
+    if (total == 0.0) {
+      continue;
+    }
+    for (std::size_t j = 0; j < _width; ++j) {
+      row[j] /= total;
+    }
+  }
+}
+
+void
+BandedMatrix::multiply(const double *x, double *y) const
+{
+  std::fill(y, y + _rows, 0.0);
+  multiply_add(x, 1.0, y);
+}
+
+void
+BandedMatrix::multiply_add(const double *x, double scale, double *y) const
+{
+  multiply_add(x, scale, y, 0, _rows);
+}
+
+void
+BandedMatrix::multiply_add(const double *x, double scale, double *y,
+                           std::size_t row_begin, std::size_t row_end) const
+{
+  row_end = std::min(row_end, _rows);
+  if (row_begin >= row_end || _width == 0) {
+    return;
+  }
+  banded_kernel()(_values.data() + row_begin * _width, _first.data() + row_begin, _width,
+                  x, scale, y + row_begin, row_end - row_begin);
+}
@@ -0,0 +1,92 @@
+///
+/// \file banded.h
+/// \brief Banded sparse matrices for the k* transformations of residual
+///        correlations and momentum resolution
+///
+/// Both kinds of matrix map one k* axis onto another and are nonzero only
+/// near their diagonal. Each row is therefore stored as one contiguous band
+/// of width() values starting at column first(row), all rows with the same
+/// width, zero-padded to a multiple of the widest vector. A product is then
+/// a dot product of contiguous memory per row, with no column indices to
+/// gather, and costs rows x width multiply-adds at close to the memory
+/// bandwidth of the band.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * BandedMatrix
+ * \brief Matrix whose nonzero entries in every row lie within a band of
+ *        fixed width.
+ *
+ * The band of row i covers the columns first(i) .. first(i) + width() - 1,
+ * always inside the matrix. Products are vectorized with the widest
+ * instruction set of the running CPU (see simd::detect()).
+ */
+class BandedMatrix {
+public:
+  /// Empty 0 x 0 matrix
+  BandedMatrix();
+
+  /// Zero `rows` x `cols` matrix with bands of at least `width` columns
+  /// (rounded up as by from_dense()), to be filled by set_row()
+  BandedMatrix(std::size_t rows, std::size_t cols, std::size_t width);
+
+  /**
+   * The banded form of the row-major `rows` x `cols` matrix `dense`:
+   * entries with |value| <= threshold are dropped, and the band is as wide
+   * as the widest remaining row (rounded up to a multiple of 8 columns when
+   * the matrix is that wide). Rows without any entries stay zero.
+   */
+  static BandedMatrix from_dense(const double *dense,
+                                 std::size_t rows,
+                                 std::size_t cols,
+                                 double threshold = 0.0);
+
+  std::size_t rows() const { return _rows; }
+  std::size_t cols() const { return _cols; }
+
+  /// Values stored per row
+  std::size_t width() const { return _width; }
+
+  /// First column of the band of `row`
+  std::size_t first(std::size_t row) const { return _first[row]; }
+
+  /// The width() values of the band of `row`
+  const double* row(std::size_t row) const { return _values.data() + row * _width; }
+
+  /// Entry (row, col), zero outside the band
+  double at(std::size_t row, std::size_t col) const;
+
+  /// Replace row `row` by the `count` values starting at column `col`;
+  /// throws std::invalid_argument if they do not fit into the band or the
+  /// matrix
+  void set_row(std::size_t row, std::size_t col, const double *values, std::size_t count);
+
+  /// Scale every row to unit sum; rows summing to zero are left alone
+  void normalize_rows();
+
+  /// y = A x; x holds cols() values and y rows()
+  void multiply(const double *x, double *y) const;
+
+  /// y += scale A x
+  void multiply_add(const double *x, double scale, double *y) const;
+
+  /// y += scale A x for the rows row_begin .. row_end - 1 only; `y` still
+  /// points at the value of row 0
+  void multiply_add(const double *x, double scale, double *y,
+                    std::size_t row_begin, std::size_t row_end) const;
+
+private:
+  std::size_t _rows;
+  std::size_t _cols;
+  std::size_t _width;
+  std::vector<std::uint32_t> _first;
+
+  /// rows x width, row after row
+  std::vector<double> _values;
+};
@@ -0,0 +1,88 @@
+///
+/// \file banded_kernel.h
+/// \brief Vectorized product of a BandedMatrix with a vector
+///
+/// Internal header, instantiated by banded.cxx (scalar fallback),
+/// kernels_avx2.cxx and kernels_avx512.cxx like the kernels of
+/// lednicky_kernel.h.
+///
+
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/// y[i] += scale * sum_j values[i * width + j] * x[first[i] + j] for
+/// `rows` rows
+typedef void (*banded_multiply_add_t)(const double *values,
+                                      const std::uint32_t *first,
+                                      std::size_t width,
+                                      const double *x,
+                                      double scale,
+                                      double *y,
+                                      std::size_t rows);
+
+void banded_multiply_add_avx2(const double*, const std::uint32_t*, std::size_t,
+                              const double*, double, double*, std::size_t);
+void banded_multiply_add_avx512(const double*, const std::uint32_t*, std::size_t,
+                                const double*, double, double*, std::size_t);
+
+namespace {
+
+/// Two rows at a time, so the two dot products overlap their multiply-add
+/// latencies and share the horizontal sums' shuffles
+template <typename V>
+inline void
+banded_multiply_add_rows(const double *values,
+                         const std::uint32_t *first,
+                         std::size_t width,
+                         const double *x,
+                         double scale,
+                         double *y,
+                         std::size_t rows)
+{
+  using simd::fma;
+  const std::size_t W = V::width;
+
+  std::size_t i = 0;
+  for (; i + 2 <= rows; i += 2) {
+    const double *a0 = values + i * width,
+                 *a1 = a0 + width,
+                 *x0 = x + first[i],
+                 *x1 = x + first[i + 1];
+
+    V acc0(0.0), acc1(0.0);
+    std::size_t j = 0;
+    for (; j + W <= width; j += W) {
+      acc0 = fma(V::load(a0 + j), V::load(x0 + j), acc0);
+      acc1 = fma(V::load(a1 + j), V::load(x1 + j), acc1);
+    }
+    double dot0 = simd::sum(acc0),
+           dot1 = simd::sum(acc1);
+    for (; j < width; ++j) {
+      dot0 += a0[j] * x0[j];
+      dot1 += a1[j] * x1[j];
+    }
+    y[i] += scale * dot0;
+    y[i + 1] += scale * dot1;
+  }
+
+  for (; i < rows; ++i) {
+    const double *a = values + i * width,
+                 *xi = x + first[i];
+    V acc(0.0);
+    std::size_t j = 0;
+    for (; j + W <= width; j += W) {
+      acc = fma(V::load(a + j), V::load(xi + j), acc);
+    }
+    double dot = simd::sum(acc);
+    for (; j < width; ++j) {
+      dot += a[j] * xi[j];
+    }
+    y[i] += scale * dot;
+  }
+}
+
+} // anonymous namespace
@@ -0,0 +1,269 @@
+///
+/// \file batch.cxx
+/// \brief Implementation of LednickyBatch
+///
+
+#include "batch.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+bool
+set_batch_parameter(LednickyEquation_s& eq, const std::string& name, double value)
+{
+  if (name == "radius") eq.radius = value;
+  else if (name == "f0re") eq.f0re = value;
+  else if (name == "f0im") eq.f0im = value;
+  else if (name == "d0") eq.d0 = value;
+  else if (name == "lamPrimary" || name == "lambda") eq.lamPrimary = value;
+  else if (name == "normalization") eq.normalization = value;
+  else if (name == "identical") eq.identical = (value != 0.0);
+  else return false;
+  return true;
+}
+
+static std::string
+trim(const std::string& str)
+{
+  std::size_t begin = 0, end = str.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(str[begin]))) ++begin;
+  while (end > begin && std::isspace(static_cast<unsigned char>(str[end - 1]))) --end;
+  return str.substr(begin, end - begin);
+}
+
+/// A number, or true/false as 1/0
+static double
+parse_batch_value(const std::string& str)
+{
+  if (str == "true") return 1.0;
+  if (str == "false") return 0.0;
+
+  const char *begin = str.c_str();
+  char *end = nullptr;
+  const double value = std::strtod(begin, &end);
+  if (end == begin || *end != '\0') {
+    throw std::invalid_argument("'" + str + "' is not a number");
+  }
+  return value;
+}
+
+/// Split a flat JSON object into alternating keys and values
+static void
+split_json_object(const std::string& line, std::vector<std::string>& fields)
+{
+  fields.clear();
+
+  std::size_t pos = 0;
+  auto skip_space = [&] () {
+    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) ++pos;
+  };
+  auto expect = [&] (char c) {
+    skip_space();
+    if (pos >= line.size() || line[pos] != c) {
+      throw std::invalid_argument(std::string("expected '") + c + "'");
+    }
+    ++pos;
+  };
+
+  expect('{');
+  skip_space();
+  if (pos < line.size() && line[pos] == '}') {
+    return;
+  }
+
+  for (;;) {
+    expect('"');
+    const std::size_t key_end = line.find('"', pos);
+    if (key_end == std::string::npos) {
+      throw std::invalid_argument("unterminated key");
+    }
+    fields.push_back(line.substr(pos, key_end - pos));
+    pos = key_end + 1;
+
+    expect(':');
+    skip_space();
+    const std::size_t value_end = line.find_first_of(",}", pos);
+    if (value_end == std::string::npos) {
+      throw std::invalid_argument("unterminated object");
+    }
+    fields.push_back(trim(line.substr(pos, value_end - pos)));
+    pos = value_end + 1;
+
+    if (line[value_end] == '}') {
+      break;
+    }
+  }
+
+  skip_space();
+  if (pos != line.size()) {
+    throw std::invalid_argument("trailing characters after object");
+  }
+}
+
+LednickyBatch::LednickyBatch(const LednickyEquation_s& base):
+  _base(base),
+  _format(BatchFormat::Detect),
+  _cache(nullptr),
+  _kstar(base.totalBins)
+{
+  for (std::size_t b = 0; b < _kstar.size(); ++b) {
+    _kstar[b] = (b + 0.5) * base.maxKstar / base.totalBins;
+  }
+}
+
+bool
+LednickyBatch::parse_line(const std::string& line, LednickyEquation_s& eq)
+{
+  if (_format == BatchFormat::Detect) {
+    _format = (line[0] == '{') ? BatchFormat::NDJSON : BatchFormat::CSV;
+  }
+
+  eq = _base;
+
+  if (_format == BatchFormat::NDJSON) {
+    split_json_object(line, _fields);
+    for (std::size_t i = 0; i < _fields.size(); i += 2) {
+      if (!set_batch_parameter(eq, _fields[i], parse_batch_value(_fields[i + 1]))) {
+        throw std::invalid_argument("unknown parameter '" + _fields[i] + "'");
+      }
+    }
+  } else {
+    _fields.clear();
+    std::stringstream ss(line);
+    for (std::string field; std::getline(ss, field, ','); ) {
+      _fields.push_back(trim(field));
+    }
+
+    // the first line names the columns
+    if (_columns.empty()) {
+      LednickyEquation_s check;
+      for (const auto& column : _fields) {
+        if (!set_batch_parameter(check, column, 0.0)) {
+          throw std::invalid_argument("unknown column '" + column + "'");
+        }
+      }
+      _columns = _fields;
+      return false;
+    }
+
+    if (_fields.size() != _columns.size()) {
+      throw std::invalid_argument("expected " + std::to_string(_columns.size()) + " fields");
+    }
+    for (std::size_t i = 0; i < _fields.size(); ++i) {
+      set_batch_parameter(eq, _columns[i], parse_batch_value(_fields[i]));
+    }
+  }
+
+  return true;
+}
+
+void
+LednickyBatch::write_preamble(std::ostream& out)
+{
+  const std::size_t bins = this->bins();
+  const double *kstar = this->kstar();
+
+  if (_format == BatchFormat::NDJSON) {
+    out << "{\"kstar\":[";
+    for (std::size_t b = 0; b < bins; ++b) {
+      out << (b ? "," : "") << kstar[b];
+    }
+    out << "]}\n";
+  } else {
+    out << "# kstar";
+    for (std::size_t b = 0; b < bins; ++b) {
+      out << ',' << kstar[b];
+    }
+    out << "\nradius,f0re,f0im,d0,lamPrimary,normalization,identical";
+    for (std::size_t b = 0; b < bins; ++b) {
+      out << ",cf_" << b;
+    }
+    out << '\n';
+  }
+}
+
+void
+LednickyBatch::write_result(std::ostream& out, const LednickyEquation_s& eq, const double *cf)
+{
+  const std::size_t bins = this->bins();
+  const bool json = (_format == BatchFormat::NDJSON);
+
+  if (json) {
+    out << "{\"radius\":" << eq.radius << ",\"f0re\":" << eq.f0re << ",\"f0im\":" << eq.f0im
+        << ",\"d0\":" << eq.d0 << ",\"lamPrimary\":" << eq.lamPrimary
+        << ",\"normalization\":" << eq.normalization
+        << ",\"identical\":" << (eq.identical ? "true" : "false") << ",\"cf\":[";
+  } else {
+    out << eq.radius << ',' << eq.f0re << ',' << eq.f0im << ',' << eq.d0 << ',' << eq.lamPrimary
+        << ',' << eq.normalization << ',' << (eq.identical ? 1 : 0);
+  }
+
+  for (std::size_t b = 0; b < bins; ++b) {
+    if (b || !json) {
+      out << ',';
+    }
+    out << cf[b];
+  }
+
+  out << (json ? "]}\n" : "\n");
+}
+
+std::size_t
+LednickyBatch::run(std::istream& in, std::ostream& out)
+{
+  out << std::setprecision(10);
+
+  bool first = true;
+  return run(in, [&] (const LednickyEquation_s& eq, const double *cf) {
+    if (first) {
+      write_preamble(out);
+      first = false;
+    }
+    write_result(out, eq, cf);
+  });
+}
+
+std::size_t
+LednickyBatch::run(std::istream& in, const sink_t& sink)
+{
+  std::size_t line_number = 0,
+              evaluated = 0;
+  LednickyEquation_s eq;
+  LednickyCurveCache::curve_t curve;
+
+  for (std::string line; std::getline(in, line); ) {
+    ++line_number;
+    line = trim(line);
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    try {
+      if (!parse_line(line, eq)) {
+        continue;
+      }
+    } catch (const std::invalid_argument& err) {
+      throw std::invalid_argument("line " + std::to_string(line_number) + ": " + err.what());
+    }
+
+    const double *cf = nullptr;
+    if (_cache != nullptr) {
+      curve = _cache->evaluate(eq);
+      cf = curve->data();
+    } else {
+      cf = _workspace.evaluate(eq);
+    }
+    _scaled.resize(bins());
+    for (std::size_t b = 0; b < _scaled.size(); ++b) {
+      _scaled[b] = (1.0 + (cf[b] - 1.0) * eq.lamPrimary) / eq.normalization;
+    }
+
+    sink(eq, _scaled.data());
+    ++evaluated;
+  }
+
+  return evaluated;
+}
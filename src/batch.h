@@ -0,0 +1,114 @@
+///
+/// \file batch.h
+/// \brief Streaming evaluation of many parameter sets read line by line
+///
+
+#pragma once
+
+#include "lednicky.h"
+#include "curvecache.h"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// Text formats understood by LednickyBatch
+enum class BatchFormat {
+  /// Unknown until the first parameter line has been seen
+  Detect,
+
+  /// A header line naming the columns, then one parameter set per line
+  CSV,
+
+  /// One flat JSON object per line, e.g. {"radius": 2.5, "f0re": 0.1}
+  NDJSON
+};
+
+/// Set the parameter `name` ("radius", "f0re", "f0im", "d0", "lamPrimary"
+/// or "lambda", "normalization", "identical") of `eq` to `value`. Returns
+/// false if there is no such parameter.
+bool set_batch_parameter(LednickyEquation_s& eq, const std::string& name, double value);
+
+/**
+ * LednickyBatch
+ * \brief Evaluates one correlation function per input line, reusing a
+ *        single LednickyWorkspace for all of them.
+ *
+ * Every line starts from the base equation and overrides the parameters
+ * it names, so fields may be omitted. The k* axis (totalBins, maxKstar) is
+ * shared by all lines and taken from the base equation. Blank lines and
+ * lines starting with '#' are skipped.
+ *
+ * The format is detected from the first parameter line: a line starting
+ * with '{' selects NDJSON, anything else is taken as the CSV header.
+ * With a LednickyCurveCache set, curves are taken from the cache instead,
+ * so repeated parameter sets, e.g. from an external minimizer, cost a
+ * lookup.
+ *
+ * Results are written in the same format, each followed by the curve
+ * scaled with lamPrimary and normalization:
+ *
+ *   CSV:    "# kstar,..." once, the header
+ *           "radius,f0re,f0im,d0,lamPrimary,normalization,identical,cf_0,...",
+ *           then one row per parameter set, identical as 0 or 1.
+ *   NDJSON: {"kstar":[...]} once, then
+ *           {"radius":...,"normalization":...,"identical":false,"cf":[...]}
+ *           per parameter set.
+ */
+class LednickyBatch {
+public:
+  /// Receives each parameter set with its curve on kstar(),
+  /// scaled by lamPrimary and normalization
+  typedef std::function<void(const LednickyEquation_s& eq, const double *cf)> sink_t;
+
+  LednickyBatch(const LednickyEquation_s& base);
+
+  /// Evaluate every parameter set of `in`, writing the results to `out` as
+  /// they are computed. Returns the number of parameter sets. Throws
+  /// std::invalid_argument, naming the line, on malformed input.
+  std::size_t run(std::istream& in, std::ostream& out);
+
+  /// Same as run(in, out), but hands every curve to `sink` instead of
+  /// formatting it
+  std::size_t run(std::istream& in, const sink_t& sink);
+
+  /// Take the curves from `cache`, which must outlive the runs, instead of
+  /// evaluating every line; nullptr, the default, evaluates every line
+  void set_cache(LednickyCurveCache *cache) { _cache = cache; }
+
+  /// Number of values of every curve, and their k* (GeV/c)
+  std::size_t bins() const { return _kstar.size(); }
+  const double* kstar() const { return _kstar.data(); }
+
+  /// The workspace evaluating the curves without a cache
+  const LednickyWorkspace& workspace() const { return _workspace; }
+
+  BatchFormat format() const { return _format; }
+
+private:
+  /// Parameters of one input line, false if it holds none (CSV header)
+  bool parse_line(const std::string& line, LednickyEquation_s& eq);
+
+  void write_preamble(std::ostream& out);
+  void write_result(std::ostream& out, const LednickyEquation_s& eq, const double *cf);
+
+  LednickyEquation_s _base;
+  LednickyWorkspace _workspace;
+  BatchFormat _format;
+  LednickyCurveCache *_cache;
+
+  /// bin centres of the base equation
+  std::vector<double> _kstar;
+
+  /// CSV column names, in order
+  std::vector<std::string> _columns;
+
+  /// scratch of parse_line
+  std::vector<std::string> _fields;
+
+  /// scaled curve handed to the sink
+  std::vector<double> _scaled;
+};
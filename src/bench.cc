@@ -0,0 +1,563 @@
+///
+/// \file bench.cc
+/// \brief lednicky-bench: microbenchmarks of the Faddeeva and Lednicky kernels
+///
+/// Every benchmark evaluates its function over a fixed, seeded array of
+/// inputs. A pass over the array is repeated until it has run for at least
+/// --min-time seconds; this is sampled --samples times and the median is
+/// reported, in ns per evaluation and evaluations per second.
+///
+/// Usage: lednicky-bench [--filter <substring>] [--min-time <s>]
+///                       [--samples <n>] [--json <path>]
+///
+
+#include "adaptive.h"
+#include "binaverage.h"
+#include "curvecache.h"
+#include "faddeeva.h"
+#include "lednicky.h"
+#include "residuals.h"
+#include "scan.h"
+#include "smearing.h"
+#include "simd.h"
+#include "surrogate.h"
+
+#ifdef LEDNICKY_BENCH_ROOT
+#include "lednickygraph.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+typedef void (*faddeeva_batch_t)(const double*, double*, std::size_t);
+typedef void (*faddeeva_float_batch_t)(const float*, float*, std::size_t);
+
+/// Results are folded into this so no benchmark can be optimized away
+volatile double bench_sink;
+
+struct BenchResult {
+  std::string name;
+
+  /// Evaluations per pass
+  std::size_t evals;
+
+  double ns_per_eval;
+  double evals_per_s;
+};
+
+struct BenchOptions {
+  std::string filter;
+  std::string json;
+  double min_time {0.05};
+  int samples {5};
+};
+
+/// Values in [lo, hi), the same on every run
+static std::vector<double>
+bench_inputs(std::size_t count, double lo, double hi, std::uint64_t seed = 12345)
+{
+  std::vector<double> values(count);
+  for (auto& value : values) {
+    // 64 bit LCG (Knuth's MMIX constants)
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    value = lo + (hi - lo) * ((seed >> 11) * (1.0 / 9007199254740992.0));
+  }
+  return values;
+}
+
+/// A decay transformation smearing the parent k* axis `parent` onto
+/// `daughter`: each daughter bin averages the parent bins around
+/// k*/`shift` with a Gaussian of width `sigma` (GeV/c), cut at 3 sigma
+static BandedMatrix
+bench_transform(const std::vector<double>& daughter, const std::vector<double>& parent,
+                double shift, double sigma)
+{
+  const double step = parent[1] - parent[0];
+  const std::size_t width = static_cast<std::size_t>(6.0 * sigma / step) + 1;
+  BandedMatrix transform(daughter.size(), parent.size(), width);
+  std::vector<double> row;
+  for (std::size_t i = 0; i < daughter.size(); ++i) {
+    const double centre = daughter[i] / shift;
+    const std::size_t begin = static_cast<std::size_t>(std::max(0.0, (centre - 3.0 * sigma - parent[0]) / step)),
+                      end = std::min(parent.size(), begin + width);
+    row.clear();
+    for (std::size_t j = begin; j < end; ++j) {
+      const double x = (parent[j] - centre) / sigma;
+      row.push_back(std::exp(-0.5 * x * x));
+    }
+    transform.set_row(i, begin, row.data(), row.size());
+  }
+  transform.normalize_rows();
+  return transform;
+}
+
+/// Median time of one pass, in seconds
+static double
+time_pass(const std::function<void()>& pass, const BenchOptions& opts)
+{
+  typedef std::chrono::steady_clock clock;
+
+  // warm up, and find how many passes fill min_time
+  std::size_t reps = 1;
+  for (;;) {
+    const clock::time_point start = clock::now();
+    for (std::size_t r = 0; r < reps; ++r) {
+      pass();
+    }
+    const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    if (elapsed >= opts.min_time) {
+      break;
+    }
+    reps *= 2;
+  }
+
+  std::vector<double> samples;
+  for (int s = 0; s < opts.samples; ++s) {
+    const clock::time_point start = clock::now();
+    for (std::size_t r = 0; r < reps; ++r) {
+      pass();
+    }
+    samples.push_back(std::chrono::duration<double>(clock::now() - start).count() / reps);
+  }
+
+  std::sort(samples.begin(), samples.end());
+  return samples[samples.size() / 2];
+}
+
+class BenchSuite {
+public:
+  explicit BenchSuite(const BenchOptions& opts): _opts(opts) {}
+
+  /// Run `pass` (which performs `evals` evaluations) unless filtered out
+  void run(const std::string& name, std::size_t evals, const std::function<void()>& pass)
+  {
+    if (name.find(_opts.filter) == std::string::npos) {
+      return;
+    }
+
+    const double seconds = time_pass(pass, _opts);
+
+    BenchResult result;
+    result.name = name;
+    result.evals = evals;
+    result.ns_per_eval = seconds * 1e9 / evals;
+    result.evals_per_s = evals / seconds;
+    _results.push_back(result);
+
+    std::printf("%-44s %10.2f ns/eval %14.4g evals/s\n",
+                name.c_str(), result.ns_per_eval, result.evals_per_s);
+    std::fflush(stdout);
+  }
+
+  /// Evaluate the scalar `f` at every value of `x`
+  void run_scalar(const std::string& name, const std::vector<double>& x, double (*f)(double))
+  {
+    run(name, x.size(), [&x, f] () {
+      double sum = 0.0;
+      for (double v : x) {
+        sum += f(v);
+      }
+      bench_sink = sum;
+    });
+  }
+
+  /// Evaluate the batch `f` on all of `x` at once
+  void run_batch(const std::string& name, const std::vector<double>& x,
+                 void (*f)(const double*, double*, std::size_t))
+  {
+    std::vector<double> out(x.size());
+    run(name, x.size(), [&x, &out, f] () {
+      f(x.data(), out.data(), x.size());
+      bench_sink = out[0];
+    });
+  }
+
+  /// Evaluate the single precision batch `f` on all of `x` at once
+  void run_batch(const std::string& name, const std::vector<double>& x,
+                 void (*f)(const float*, float*, std::size_t))
+  {
+    const std::vector<float> xf(x.begin(), x.end());
+    std::vector<float> out(x.size());
+    run(name, x.size(), [&xf, &out, f] () {
+      f(xf.data(), out.data(), xf.size());
+      bench_sink = out[0];
+    });
+  }
+
+  bool write_json(const std::string& path) const;
+
+private:
+  const BenchOptions &_opts;
+  std::vector<BenchResult> _results;
+};
+
+bool
+BenchSuite::write_json(const std::string& path) const
+{
+  std::ofstream out(path.c_str());
+  if (!out) {
+    return false;
+  }
+
+  out << "{\n"
+      << "  \"simd\": \"" << simd::level_name(simd::detect()) << "\",\n"
+      << "  \"min_time\": " << _opts.min_time << ",\n"
+      << "  \"samples\": " << _opts.samples << ",\n"
+      << "  \"benchmarks\": [\n";
+  for (std::size_t i = 0; i < _results.size(); ++i) {
+    const BenchResult &r = _results[i];
+    out << "    {\"name\": \"" << r.name << "\", \"evals\": " << r.evals
+        << ", \"ns_per_eval\": " << r.ns_per_eval
+        << ", \"evals_per_s\": " << r.evals_per_s << "}"
+        << (i + 1 < _results.size() ? ",\n" : "\n");
+  }
+  out << "  ]\n}\n";
+  return static_cast<bool>(out);
+}
+
+static double
+dawson(double x)
+{
+  return Faddeeva::Dawson(x);
+}
+
+static double
+w_im(double x)
+{
+  return Faddeeva::w_im(x);
+}
+
+static double
+erfcx(double x)
+{
+  return Faddeeva::erfcx(x);
+}
+
+static BenchOptions
+parse_bench_args(int argc, char **argv)
+{
+  BenchOptions opts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      std::cerr << "Missing value of '" << arg << "'.\n";
+      exit(EXIT_FAILURE);
+    }
+    if (arg == "--filter") {
+      opts.filter = argv[++i];
+    } else if (arg == "--json") {
+      opts.json = argv[++i];
+    } else if (arg == "--min-time") {
+      opts.min_time = std::atof(argv[++i]);
+    } else if (arg == "--samples") {
+      opts.samples = std::max(1, std::atoi(argv[++i]));
+    } else {
+      std::cerr << "Unknown option '" << arg << "'.\n";
+      exit(EXIT_FAILURE);
+    }
+  }
+  return opts;
+}
+
+int
+main(int argc, char **argv)
+{
+  const BenchOptions opts = parse_bench_args(argc, argv);
+  BenchSuite suite(opts);
+
+  std::printf("# simd level: %s\n", simd::level_name(simd::detect()));
+
+  const std::size_t N = 4096;
+
+  // the regions of w_im: Taylor series, the Chebyshev fits of w_im_y100
+  // (split at the coarse and fine ends of the table), continued fraction
+  // and the 1/x asymptote
+  struct Region {
+    const char *name;
+    double lo, hi;
+  };
+  const Region regions[] = {
+    {"taylor",     0.0,    0.0309},
+    {"cheb_small", 0.0309, 1.0},
+    {"cheb_mid",   1.0,    10.0},
+    {"cheb_large", 10.0,   45.0},
+    {"cfrac",      45.0,   5e7},
+    {"asymptotic", 5e7,    1e9},
+  };
+
+  const std::vector<double> dawson_x = bench_inputs(N, -10.0, 10.0);
+  suite.run_scalar("Faddeeva::Dawson", dawson_x, &dawson);
+  suite.run_batch("Faddeeva::Dawson[batch]", dawson_x,
+                  static_cast<faddeeva_batch_t>(&Faddeeva::Dawson));
+  suite.run_batch("Faddeeva::Dawson[batch,float]", dawson_x,
+                  static_cast<faddeeva_float_batch_t>(&Faddeeva::Dawson));
+
+  for (const Region &region : regions) {
+    const std::vector<double> x = bench_inputs(N, region.lo, region.hi);
+    suite.run_scalar(std::string("Faddeeva::w_im/") + region.name, x, &w_im);
+    suite.run_batch(std::string("Faddeeva::w_im[batch]/") + region.name, x,
+                    static_cast<faddeeva_batch_t>(&Faddeeva::w_im));
+    suite.run_batch(std::string("Faddeeva::w_im[batch,float]/") + region.name, x,
+                    static_cast<faddeeva_float_batch_t>(&Faddeeva::w_im));
+  }
+
+  {
+    const std::vector<double> re = bench_inputs(N, -6.0, 6.0, 1),
+                              im = bench_inputs(N, -6.0, 6.0, 2);
+    std::vector<std::complex<double>> z(N);
+    for (std::size_t i = 0; i < N; ++i) {
+      z[i] = std::complex<double>(re[i], im[i]);
+    }
+    suite.run("Faddeeva::w", N, [&z] () {
+      std::complex<double> sum;
+      for (const auto& v : z) {
+        sum += Faddeeva::w(v);
+      }
+      bench_sink = sum.real() + sum.imag();
+    });
+  }
+
+  suite.run_scalar("Faddeeva::erfcx", bench_inputs(N, -5.0, 30.0), &erfcx);
+  suite.run_scalar("GetLednickyF1", bench_inputs(N, 1e-3, 50.0), &GetLednickyF1<double>);
+
+  {
+    const std::vector<double> kstar = bench_inputs(N, 0.0, 1.5);
+    const std::complex<double> f0(-0.071, 0.05);
+    const double d0 = 1.5;
+    suite.run("scattering_amplitude_numerator", N, [&] () {
+      std::complex<double> sum;
+      for (double k : kstar) {
+        sum += scattering_amplitude_numerator(k, f0, d0);
+      }
+      bench_sink = sum.real();
+    });
+    suite.run("scattering_amplitude_denominator", N, [&] () {
+      double sum = 0.0;
+      for (double k : kstar) {
+        sum += scattering_amplitude_denominator(k, f0, d0);
+      }
+      bench_sink = sum;
+    });
+  }
+
+  const unsigned short bin_counts[] = {100, 1000, 10000};
+  for (unsigned short bins : bin_counts) {
+    LednickyEquation_s eq;
+    eq.totalBins = bins;
+    eq.d0 = 1.5;
+    eq.f0im = 0.05;
+
+    const std::string suffix = "/" + std::to_string(bins);
+    std::vector<double> kstar(bins), cf(bins);
+
+    suite.run("generate_lednicky_equation" + suffix, bins, [&] () {
+      generate_lednicky_equation(eq, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+
+    LednickyEquation_s eq_spline = eq;
+    eq_spline.spline_basis = true;
+    suite.run("generate_lednicky_equation[spline]" + suffix, bins, [&] () {
+      generate_lednicky_equation(eq_spline, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+
+    // the femtoscopic region only, where the asymptotic forms never apply
+    LednickyEquation_s eq_low = eq;
+    eq_low.maxKstar = 0.15;
+    suite.run("generate_lednicky_equation[k*<0.15]" + suffix, bins, [&] () {
+      generate_lednicky_equation(eq_low, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+    eq_low.spline_basis = true;
+    suite.run("generate_lednicky_equation[k*<0.15,spline]" + suffix, bins, [&] () {
+      generate_lednicky_equation(eq_low, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+
+    generate_lednicky_equation(eq, kstar.data(), cf.data());
+    std::vector<double> jacobian(JACOBIAN_COLUMNS * bins);
+    suite.run("evaluate_lednicky_jacobian" + suffix, bins, [&] () {
+      evaluate_lednicky_jacobian(eq, kstar.data(), cf.data(), jacobian.data(), bins);
+      bench_sink = jacobian[0];
+    });
+    suite.run("evaluate_lednicky_jacobian[spline]" + suffix, bins, [&] () {
+      evaluate_lednicky_jacobian(eq_spline, kstar.data(), cf.data(), jacobian.data(), bins);
+      bench_sink = jacobian[0];
+    });
+
+    std::vector<float> kstar_float(kstar.begin(), kstar.end()), cf_float(bins);
+    suite.run("evaluate_lednicky_equation[float]" + suffix, bins, [&] () {
+      evaluate_lednicky_equation(eq, kstar_float.data(), cf_float.data(), bins);
+      bench_sink = cf_float[0];
+    });
+
+    // pp: a_c = 57.6 fm
+    suite.run("evaluate_lednicky_coulomb" + suffix, bins, [&] () {
+      evaluate_lednicky_coulomb(eq, 57.64, kstar.data(), cf.data(), bins);
+      bench_sink = cf[0];
+    });
+
+    // chi^2 against pseudo data: through a stored curve and fused
+    const std::vector<double> data = bench_inputs(bins, 0.9, 1.1, 3),
+                              error(bins, 0.01),
+                              reference = bench_inputs(bins, 100.0, 200.0, 4);
+    suite.run("chi2[curve+loop]" + suffix, bins, [&] () {
+      evaluate_lednicky_equation(eq, kstar.data(), cf.data(), bins);
+      double chi2 = 0.0;
+      for (std::size_t i = 0; i < bins; ++i) {
+        const double r = (data[i] - (1.0 + (cf[i] - 1.0) * eq.lamPrimary) / eq.normalization) / error[i];
+        chi2 += r * r;
+      }
+      bench_sink = chi2;
+    });
+    suite.run("lednicky_chi2" + suffix, bins, [&] () {
+      bench_sink = lednicky_chi2(eq, kstar.data(), data.data(), error.data(), bins);
+    });
+    suite.run("lednicky_poisson_deviance" + suffix, bins, [&] () {
+      bench_sink = lednicky_poisson_deviance(eq, kstar.data(), reference.data(), reference.data(), bins);
+    });
+
+    LednickyBasis basis;
+    suite.run("LednickyBasis::chi2[cached]" + suffix, bins, [&] () {
+      eq.d0 = (eq.d0 == 1.5) ? 1.25 : 1.5;
+      bench_sink = basis.chi2(eq, kstar.data(), data.data(), error.data(), bins);
+    });
+
+    // a fit changing f0 and d0 at fixed radius hits the cached basis
+    LednickyWorkspace workspace;
+    suite.run("LednickyWorkspace::evaluate[cached]" + suffix, bins, [&] () {
+      eq.d0 = (eq.d0 == 1.5) ? 1.25 : 1.5;
+      bench_sink = workspace.evaluate(eq)[0];
+    });
+
+    // the common baryon-baryon fit: real f0, no effective range
+    LednickyEquation_s eq_real = eq;
+    eq_real.d0 = 0.0;
+    eq_real.f0im = 0.0;
+    suite.run("LednickyWorkspace::evaluate[cached,d0=0,f0im=0]" + suffix, bins, [&] () {
+      eq_real.f0re = (eq_real.f0re == -0.071) ? -0.08 : -0.071;
+      bench_sink = workspace.evaluate(eq_real)[0];
+    });
+
+    // feed-down from three parents on a 20% longer k* axis, smeared over
+    // 3, 6 and 9 parent bins
+    LednickyResiduals residuals;
+    for (int j = 0; j < 3; ++j) {
+      ResidualParent parent;
+      parent.eq.radius = 2.5 + 0.5 * j;
+      parent.eq.lamPrimary = 0.1;
+      parent.kstar.resize(bins);
+      for (std::size_t k = 0; k < bins; ++k) {
+        parent.kstar[k] = (k + 0.5) * 1.8 / bins;
+      }
+      parent.transform = bench_transform(kstar, parent.kstar, 0.9, 3.0 * (j + 1) * 1.8 / bins);
+      residuals.add_parent(parent);
+    }
+    suite.run("LednickyResiduals::evaluate[3 parents]" + suffix, bins, [&] () {
+      eq.d0 = (eq.d0 == 1.5) ? 1.25 : 1.5;
+      residuals.evaluate(eq, kstar.data(), cf.data(), bins);
+      bench_sink = cf[0];
+    });
+
+    // bin means; the usual workaround is 10x oversampling and rebinning
+    LednickyBinAverage average(1e-6);
+    suite.run("LednickyBinAverage::evaluate[1e-6]" + suffix, bins, [&] () {
+      average.evaluate(eq, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+
+    // a hundred or two points where the curve bends, cubics in between
+    LednickyAdaptive adaptive(1e-6);
+    suite.run("LednickyAdaptive::evaluate[1e-6]" + suffix, bins, [&] () {
+      eq.d0 = (eq.d0 == 1.5) ? 1.25 : 1.5;
+      adaptive.evaluate(eq, kstar.data(), cf.data());
+      bench_sink = cf[0];
+    });
+
+    // a minimizer revisiting a point: hash, lookup and copy of the curve
+    LednickyCurveCache cache;
+    LednickyEquation_s eq_cached = eq;
+    eq_cached.totalBins = bins;
+    cache.evaluate(eq_cached, cf.data());
+    suite.run("LednickyCurveCache::evaluate[hit]" + suffix, bins, [&] () {
+      cache.evaluate(eq_cached, cf.data());
+      bench_sink = cf[0];
+    });
+
+    // a sampler stepping inside a float grid of 11 x 5 x 3 x 3 curves
+    {
+      std::string grid_path = "/tmp/lednicky-bench-XXXXXX";
+      const int fd = ::mkstemp(&grid_path[0]);
+      if (fd >= 0) {
+        ::close(fd);
+        ScanGrid grid;
+        grid.radius = parse_scan_axis("1:6:11");
+        grid.f0re = parse_scan_axis("-1:1:5");
+        grid.f0im = parse_scan_axis("0:0.5:3");
+        grid.d0 = parse_scan_axis("0:3:3");
+        LednickyEquation_s base;
+        base.totalBins = bins;
+        const LednickyScan scan(base, grid);
+        CurveFileWriter writer(grid_path, scan.kstar().data(), bins, sizeof(float));
+        scan.run([&] (std::size_t first, std::size_t count, const double *curves) {
+          for (std::size_t i = 0; i < count; ++i) {
+            writer.append(scan.point(first + i), curves + i * bins);
+          }
+        });
+        writer.finish();
+
+        const LednickySurrogate surrogate(grid_path);
+        ::unlink(grid_path.c_str());
+        LednickyEquation_s eq_grid = eq;
+        eq_grid.radius = 2.2;
+        suite.run("LednickySurrogate::evaluate" + suffix, bins, [&] () {
+          eq_grid.d0 = (eq_grid.d0 == 1.5) ? 1.25 : 1.5;
+          bench_sink = surrogate.evaluate(eq_grid, cf.data());
+        });
+      }
+    }
+
+    // momentum resolution of 4 bins on an axis of twice the bins
+    {
+      std::vector<double> true_kstar(2 * bins);
+      for (std::size_t k = 0; k < true_kstar.size(); ++k) {
+        true_kstar[k] = (k + 0.5) * 1.5 / true_kstar.size();
+      }
+      const MomentumResponse response(true_kstar, kstar,
+                                      bench_transform(kstar, true_kstar, 1.0, 4.0 * 1.5 / true_kstar.size()));
+      std::vector<double> true_cf(true_kstar.size());
+      evaluate_lednicky_equation(eq, true_kstar.data(), true_cf.data(), true_cf.size());
+      suite.run("MomentumResponse::smear" + suffix, bins, [&] () {
+        response.smear(true_cf.data(), cf.data());
+        bench_sink = cf[0];
+      });
+    }
+
+#ifdef LEDNICKY_BENCH_ROOT
+    suite.run("GetLednickyEqn" + suffix, bins, [&] () {
+      TGraph *graph = GetLednickyEqn(eq);
+      bench_sink = graph->GetY()[0];
+      delete graph;
+    });
+#endif
+  }
+
+  if (!opts.json.empty() && !suite.write_json(opts.json)) {
+    std::cerr << "Unable to write benchmark results to '" << opts.json << "'.\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,184 @@
+///
+/// \file binaverage.cxx
+/// \brief Implementation of LednickyBinAverage
+///
+
+#include "binaverage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+const unsigned LednickyBinAverage::MAX_NODES;
+
+namespace {
+
+/// Gauss-Legendre nodes on [-1, 1] and weights summing to one, for 2, 4,
+/// 8 and 16 nodes; the rule of n nodes starts at index n - 2
+struct GaussLegendreRules {
+  double nodes[30];
+  double weights[30];
+
+  GaussLegendreRules();
+
+  static unsigned offset(unsigned n) { return n - 2; }
+};
+
+GaussLegendreRules::GaussLegendreRules()
+{
+  for (unsigned n = 2; n <= LednickyBinAverage::MAX_NODES; n *= 2) {
+    double *x = nodes + offset(n),
+           *w = weights + offset(n);
+    for (unsigned i = 0; i < n; ++i) {
+      // Newton's method on P_n from the usual asymptotic guess
+      double t = std::cos(M_PI * (i + 0.75) / (n + 0.5)),
+             dp = 1.0;
+      for (int iteration = 0; iteration < 100; ++iteration) {
+        double p0 = 1.0, p1 = t;
+        for (unsigned k = 2; k <= n; ++k) {
+          const double p2 = ((2 * k - 1) * t * p1 - (k - 1) * p0) / k;
+          p0 = p1;
+          p1 = p2;
+        }
+        dp = n * (t * p1 - p0) / (t * t - 1.0);
+        const double step = p1 / dp;
+        t -= step;
+        if (std::fabs(step) < 1e-16) {
+          break;
+        }
+      }
+      x[i] = t;
+      // 2 / ((1 - t^2) P_n'(t)^2), halved for weights summing to one
+      w[i] = 1.0 / ((1.0 - t * t) * dp * dp);
+    }
+  }
+}
+
+const GaussLegendreRules&
+gauss_legendre_rules()
+{
+  static const GaussLegendreRules rules;
+  return rules;
+}
+
+} // anonymous namespace
+
+LednickyBinAverage::LednickyBinAverage(double tolerance):
+  _tolerance(tolerance),
+  _evaluations(0),
+  _error(0.0)
+{
+}
+
+void
+LednickyBinAverage::evaluate(const LednickyEquation_s& eq, double *kstar, double *cf)
+{
+  const int bins = eq.totalBins;
+  const double width = eq.maxKstar / bins;
+  _edges.resize(bins + 1);
+  for (int xBin = 0; xBin <= bins; xBin++) {
+    _edges[xBin] = xBin * width;
+  }
+  for (int xBin = 0; xBin < bins; xBin++) {
+    kstar[xBin] = (xBin + 0.5) * width;
+  }
+  // _edges is read before any other buffer is touched
+  evaluate(eq, _edges.data(), cf, bins);
+}
+
+void
+LednickyBinAverage::evaluate(const LednickyEquation_s& eq,
+                             const double *edges,
+                             double *cf,
+                             std::size_t bins)
+{
+  const GaussLegendreRules& rules = gauss_legendre_rules();
+
+  _evaluations = 0;
+  _error = 0.0;
+  _nodes.assign(bins, 1);
+  if (bins == 0) {
+    return;
+  }
+
+  // the 1-node rule at every bin centre
+  _centres.resize(bins);
+  _centre_cf.resize(bins);
+  for (std::size_t i = 0; i < bins; ++i) {
+    _centres[i] = 0.5 * (edges[i] + edges[i + 1]);
+  }
+  evaluate_lednicky_equation(eq, _centres.data(), _centre_cf.data(), bins);
+  _evaluations += bins;
+
+  // midpoint error h^2 |C''| / 24, with C'' from the divided difference
+  // of the three centres around the bin (shifted inwards at the ends)
+  const double *x = _centres.data(),
+               *y = _centre_cf.data(),
+               tolerance = _tolerance;
+  double error = 0.0;
+  _pending.clear();
+  _previous.clear();
+  for (std::size_t i = 0; i < bins; ++i) {
+    cf[i] = y[i];
+
+    double estimate = std::numeric_limits<double>::infinity();
+    if (bins >= 3) {
+      const std::size_t m = std::min(std::max<std::size_t>(i, 1), bins - 2);
+      const double dx_minus = x[m] - x[m - 1],
+                   dx_plus = x[m + 1] - x[m],
+                   h = edges[i + 1] - edges[i];
+      estimate = h * h * std::fabs((y[m + 1] - y[m]) * dx_minus - (y[m] - y[m - 1]) * dx_plus)
+                 / (12.0 * (dx_plus + dx_minus) * dx_minus * dx_plus);
+    }
+
+    if (estimate <= tolerance) {
+      error = std::max(error, estimate);
+    } else {
+      _pending.push_back(i);
+      _previous.push_back(y[i]);
+    }
+  }
+  _error = error;
+
+  for (unsigned n = 2; n <= MAX_NODES && !_pending.empty(); n *= 2) {
+    const double *x = rules.nodes + GaussLegendreRules::offset(n),
+                 *w = rules.weights + GaussLegendreRules::offset(n);
+
+    // the nodes of every refining bin, evaluated together
+    const std::size_t count = _pending.size() * n;
+    _kstar.resize(count);
+    _values.resize(count);
+    for (std::size_t p = 0; p < _pending.size(); ++p) {
+      const std::size_t i = _pending[p];
+      const double centre = 0.5 * (edges[i] + edges[i + 1]),
+                   half = 0.5 * (edges[i + 1] - edges[i]);
+      for (unsigned j = 0; j < n; ++j) {
+        _kstar[p * n + j] = centre + half * x[j];
+      }
+    }
+    evaluate_lednicky_equation(eq, _kstar.data(), _values.data(), count);
+    _evaluations += count;
+
+    std::size_t kept = 0;
+    for (std::size_t p = 0; p < _pending.size(); ++p) {
+      const std::size_t i = _pending[p];
+      double average = 0.0;
+      for (unsigned j = 0; j < n; ++j) {
+        average += w[j] * _values[p * n + j];
+      }
+      const double estimate = std::fabs(average - _previous[p]);
+
+      cf[i] = average;
+      _nodes[i] = n;
+      if (estimate <= _tolerance || n == MAX_NODES) {
+        _error = std::max(_error, estimate);
+      } else {
+        _pending[kept] = i;
+        _previous[kept] = average;
+        ++kept;
+      }
+    }
+    _pending.resize(kept);
+    _previous.resize(kept);
+  }
+}
@@ -0,0 +1,87 @@
+///
+/// \file binaverage.h
+/// \brief Correlation functions averaged over k* bins by Gauss-Legendre
+///        quadrature
+///
+
+#pragma once
+
+#include "lednicky.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * LednickyBinAverage
+ * \brief The mean of the correlation function over every bin, as measured
+ *        in a histogram, instead of its value at the bin centre.
+ *
+ * Each bin is integrated with a Gauss-Legendre rule of 1, 2, 4, 8 or 16
+ * nodes (the 1-node rule is the bin centre), chosen per bin:
+ *
+ *  - every bin centre is evaluated, and the error of the centre value,
+ *    h^2 |C''| / 24 for a bin of width h, is estimated from the second
+ *    divided difference of neighbouring centres. Bins below the tolerance
+ *    keep their centre value, which is most of the flat tail.
+ *  - the remaining bins are integrated with twice the nodes of their last
+ *    rule until two successive rules agree within the tolerance; the
+ *    finer of the two is kept.
+ *
+ * Each of these rounds evaluates the nodes of all bins still refining in
+ * one call of the vectorized evaluate_lednicky_equation(); there are at
+ * most five. A feature much narrower than a bin that the bin centres do
+ * not resolve can escape the first estimate.
+ *
+ * Like evaluate_lednicky_equation(), lambda and normalization are left to
+ * the caller; being linear, they commute with the average. Buffers are
+ * kept between calls. Not thread-safe; give each thread its own instance.
+ */
+class LednickyBinAverage {
+public:
+  /// Largest node count of the refinement
+  static const unsigned MAX_NODES = 16;
+
+  /// Accept bins whose estimated absolute error in C is below `tolerance`
+  explicit LednickyBinAverage(double tolerance = 1e-6);
+
+  void set_tolerance(double tolerance) { _tolerance = tolerance; }
+  double tolerance() const { return _tolerance; }
+
+  /// Average `eq` over the `bins` bins between the bins + 1 ascending
+  /// `edges` (GeV/c) into `cf`
+  void evaluate(const LednickyEquation_s& eq,
+                const double *edges,
+                double *cf,
+                std::size_t bins);
+
+  /// Average over the bins of `eq` (`eq.totalBins` bins up to
+  /// `eq.maxKstar`), filling `kstar` with the bin centres like
+  /// generate_lednicky_equation()
+  void evaluate(const LednickyEquation_s& eq, double *kstar, double *cf);
+
+  /// Points evaluated by the last evaluate(), bin centres included
+  std::size_t evaluations() const { return _evaluations; }
+
+  /// Largest error estimate of a bin in the last evaluate(); bins that hit
+  /// MAX_NODES may exceed the tolerance
+  double error() const { return _error; }
+
+  /// Gauss-Legendre rule used for `bin` by the last evaluate()
+  unsigned nodes(std::size_t bin) const { return _nodes[bin]; }
+
+private:
+  double _tolerance;
+  std::size_t _evaluations;
+  double _error;
+
+  std::vector<double> _edges;
+  std::vector<double> _centres;
+  std::vector<double> _centre_cf;
+  std::vector<unsigned> _nodes;
+
+  /// bins still refining, their last estimate, and the nodes of a round
+  std::vector<std::size_t> _pending;
+  std::vector<double> _previous;
+  std::vector<double> _kstar;
+  std::vector<double> _values;
+};
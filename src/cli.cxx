@@ -0,0 +1,792 @@
+///
+/// \file cli.cxx
+/// \brief Command line handling shared by the lednicky executables
+///
+
+#include "cli.h"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#include <cstdlib>
+#include <algorithm>
+
+using namespace std;
+
+void
+usage(const std::string& exe_name)
+{
+  char indent[] = "    ";
+  cout << "This will generate and draw a correlation function calculated from Lednicky eqn.\n";
+  cout << "Usage:\n\n";
+  cout << "  " << exe_name << " <OPTIONS>\n\n";
+  cout << "Options:\n";
+  cout << indent << "-h, --help "  << '\t'<< '\t' << '\t' << " Display this help" << '\n';
+  cout << indent << "--nogui "   << '\t'<< '\t'<< '\t' << " Do not display the GUI." << '\n';
+  cout << indent << "--headless "   << '\t'<< '\t'<< '\t' << " Write the curve as 'kstar,cf' CSV to <OUTPUT> or stdout, without ROOT." << '\n';
+  cout << indent << "--radius <radius (fm)> " << '\t' << " Use as source radius." << '\n';
+  cout << indent << "--f0re <f0re (fm)> " << '\t' << " Real part of the scattering length." << '\n';
+  cout << indent << "--f0im <f0im (fm)> " << '\t' << " Imaginary part of the scattering length." << '\n';
+  cout << indent << "--d0 <d0 (fm)> " << '\t'<< '\t' << " Effective range." << '\n';
+  cout << indent << "--lambda <lambda> " << '\t' << " Correlation strength, the curve is 1 + (C - 1) lambda." << '\n';
+  cout << indent << "--normalization <N> " << '\t' << " Divide the curve by N." << '\n';
+  cout << indent << "--bin_count <integer> " << '\t' << " Number of bins in the correlation function plot." << '\n';
+  cout << indent << "--max_kstar <k* (GeV/C)> " << '\t' << " Upper limit of the correlation function's domain." << '\n';
+  cout << indent << "--bin-average[=<tol>] " << '\t' << " Write the mean of the curve over each bin, to an absolute" << '\n';
+  cout << indent << "                      " << '\t' << " tolerance (default 1e-6), instead of bin centre values." << '\n';
+  cout << indent << "--adaptive[=<tol>] " << '\t' << " Interpolate the curve from points placed where it bends, to an" << '\n';
+  cout << indent << "                   " << '\t' << " absolute tolerance (default 1e-6); pays off for many bins." << '\n';
+  cout << indent << "--asymptotic-tolerance <tol> " << '\t' << " Relative error allowed in F1 and F2 at large k* R, where a short" << '\n';
+  cout << indent << "                             " << '\t' << " series replaces them (default 1e-15, 0 to turn it off)." << '\n';
+  cout << indent << "--spline-basis " << '\t'<< '\t' << " Interpolate F1 and F2 from a precomputed table, to a relative" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " error of 1e-10, instead of evaluating the Dawson function." << '\n';
+  cout << '\n';
+  cout << "Scan mode (writes one CSV row per grid point to <OUTPUT> or stdout):\n";
+  cout << indent << "--scan-<axis> <values> " << '\t' << " Scan an axis: radius, f0re, f0im, d0 or lambda." << '\n';
+  cout << indent << "                       " << '\t' << " Values are a list 'a,b,c' or a range 'start:stop:count'." << '\n';
+  cout << indent << "--scan-file <path> " << '\t' << " Read '<axis> <values>' lines from a file." << '\n';
+  cout << indent << "--threads <integer> " << '\t' << " Worker threads for the scan (default: all cores)." << '\n';
+  cout << '\n';
+  cout << "Batch mode (one curve per input line, written to <OUTPUT> or stdout):\n";
+  cout << indent << "--batch <path> " << '\t'<< '\t' << " Read parameter sets from a file, '-' for stdin." << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " Either CSV with a header line (radius,f0re,f0im,d0,lambda,...)" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " or one JSON object per line ({\"radius\": 2.5, ...})." << '\n';
+  cout << indent << "--cache[=<MB>] " << '\t'<< '\t' << " Keep the most recently used curves, up to 64 MB or the size" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " given, so that repeated parameter sets are looked up; hits" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " and misses go to stderr." << '\n';
+  cout << '\n';
+  cout << "Fit mode (chi^2 fit with analytic gradients, result to <OUTPUT> or stdout):\n";
+  cout << indent << "--fit <path> " << '\t'<< '\t' << " Fit to 'kstar cf error' lines of a file, '-' for stdin." << '\n';
+  cout << indent << "             " << '\t'<< '\t' << " Starts from --radius, --f0re, --f0im, --d0, --lambda" << '\n';
+  cout << indent << "             " << '\t'<< '\t' << " and --normalization." << '\n';
+  cout << indent << "--fix <names> " << '\t'<< '\t' << " Keep parameters fixed: radius, f0re, f0im, d0, lambda" << '\n';
+  cout << indent << "              " << '\t'<< '\t' << " and/or normalization, comma separated." << '\n';
+  cout << indent << "--fit-varpro " << '\t'<< '\t' << " Solve lambda and normalization in closed form at every" << '\n';
+  cout << indent << "             " << '\t'<< '\t' << " step and search only radius, f0 and d0." << '\n';
+  cout << indent << "--smear <path> " << '\t'<< '\t' << " Smear the curve and the fit model with a momentum response" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " matrix: a line 'true <k*>...' of true bin centres, then" << '\n';
+  cout << indent << "               " << '\t'<< '\t' << " '<reco k*> <counts>...' per reconstructed bin." << '\n';
+  cout << '\n';
+  cout << indent << "--binary[=float|double] " << '\t' << " Write scan or batch results to <OUTPUT> as a memory-mappable" << '\n';
+  cout << indent << "                        " << '\t' << " curve file (see curvefile.h) instead of CSV." << '\n';
+  cout << indent << "--surrogate <path> " << '\t' << " Interpolate the curve from the binary output of a scan over" << '\n';
+  cout << indent << "                   " << '\t' << " radius, f0re, f0im and d0, on its k*; the estimated" << '\n';
+  cout << indent << "                   " << '\t' << " interpolation error goes to stderr." << '\n';
+  cout << indent << "--surrogate-validate " << '\t' << " Also measure the error against the model at the grid cell" << '\n';
+  cout << indent << "                     " << '\t' << " centres." << '\n';
+  cout << std::endl;
+}
+
+/// Open `opts.output` into `file` if an output file was given. Returns
+/// false (after reporting) if it could not be opened.
+static bool
+open_output(const ProgramOptions& opts, std::ofstream& file)
+{
+  if (opts.output.empty()) {
+    return true;
+  }
+  file.open(opts.output.c_str());
+  if (!file) {
+    cerr << "Unable to open output file '" << opts.output << "'.\n";
+    return false;
+  }
+  return true;
+}
+
+/// The binary output of scan and batch mode needs a seekable output file
+static bool
+check_binary_output(const ProgramOptions& opts)
+{
+  if (opts.output.empty()) {
+    cerr << "Binary output needs an output file.\n";
+    return false;
+  }
+  return true;
+}
+
+/// Write every point of `scan` into the curve file `opts.output`
+static int
+write_scan_binary(const ProgramOptions& opts, const LednickyScan& scan)
+{
+  if (!check_binary_output(opts)) {
+    return EXIT_FAILURE;
+  }
+
+  try {
+    CurveFileWriter writer(opts.output, scan.kstar().data(), scan.bins(), opts.binary_value_size);
+    scan.run([&] (std::size_t first, std::size_t count, const double *curves) {
+      for (std::size_t i = 0; i < count; ++i) {
+        writer.append(scan.point(first + i), curves + i * scan.bins());
+      }
+    }, opts.threads);
+    writer.finish();
+  } catch (const std::runtime_error& err) {
+    cerr << err.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int
+run_scan(const ProgramOptions& opts)
+{
+  std::unique_ptr<LednickyScan> scan_ptr;
+  try {
+    scan_ptr.reset(new LednickyScan(opts.eq, opts.scan));
+  } catch (const std::invalid_argument& err_ia) {
+    cerr << "Unable to scan: " << err_ia.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  const LednickyScan &scan = *scan_ptr;
+
+  if (opts.binary_value_size != 0) {
+    return write_scan_binary(opts, scan);
+  }
+
+  std::ofstream file;
+  if (!open_output(opts, file)) {
+    return EXIT_FAILURE;
+  }
+  std::ostream &out = opts.output.empty() ? cout : file;
+
+  out << std::setprecision(10);
+  out << "# kstar";
+  for (double k : scan.kstar()) {
+    out << ',' << k;
+  }
+  out << "\nradius,f0re,f0im,d0,lamPrimary";
+  for (std::size_t b = 0; b < scan.bins(); ++b) {
+    out << ",cf_" << b;
+  }
+  out << '\n';
+
+  scan.run([&] (std::size_t first, std::size_t count, const double *curves) {
+    for (std::size_t i = 0; i < count; ++i) {
+      const LednickyEquation_s eq = scan.point(first + i);
+      out << eq.radius << ',' << eq.f0re << ',' << eq.f0im << ',' << eq.d0 << ',' << eq.lamPrimary;
+      for (std::size_t b = 0; b < scan.bins(); ++b) {
+        out << ',' << curves[i * scan.bins() + b];
+      }
+      out << '\n';
+    }
+  }, opts.threads);
+
+  out.flush();
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Read the response matrix of `opts.smear_input` into `response`.
+/// Returns false (after reporting) if it could not be read.
+static bool
+load_response(const ProgramOptions& opts, MomentumResponse& response)
+{
+  std::ifstream in(opts.smear_input.c_str());
+  if (!in) {
+    cerr << "Unable to open response matrix file '" << opts.smear_input << "'.\n";
+    return false;
+  }
+  try {
+    response = read_momentum_response(in);
+  } catch (const std::invalid_argument& err_ia) {
+    cerr << "Unable to read response matrix '" << opts.smear_input << "': " << err_ia.what() << "\n";
+    return false;
+  }
+  return true;
+}
+
+/// Write the curve of `eq` smeared with the response of `opts.smear_input`
+static int
+run_headless_smeared(const ProgramOptions& opts)
+{
+  const LednickyEquation_s &eq = opts.eq;
+
+  MomentumResponse response;
+  if (!load_response(opts, response)) {
+    return EXIT_FAILURE;
+  }
+
+  std::vector<double> cf(response.true_bins()), smeared(response.reco_bins());
+  if (opts.adaptive > 0.0) {
+    LednickyAdaptive(opts.adaptive).evaluate(eq, response.true_kstar().data(), cf.data(), cf.size());
+  } else {
+    evaluate_lednicky_equation(eq, response.true_kstar().data(), cf.data(), cf.size());
+  }
+  response.smear(cf.data(), smeared.data());
+
+  std::ofstream file;
+  if (!open_output(opts, file)) {
+    return EXIT_FAILURE;
+  }
+  std::ostream &out = opts.output.empty() ? cout : file;
+
+  out << std::setprecision(10);
+  out << "kstar,cf\n";
+  for (std::size_t xBin = 0; xBin < smeared.size(); xBin++) {
+    // smearing keeps a flat curve flat, so lambda and normalization apply
+    // to the smeared curve as to the true one
+    out << response.reco_kstar()[xBin] << ','
+        << (1.0 + (smeared[xBin] - 1.0) * eq.lamPrimary) / eq.normalization << '\n';
+  }
+
+  out.flush();
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Write the curve of `eq` interpolated from `opts.surrogate_input`
+static int
+run_headless_surrogate(const ProgramOptions& opts)
+{
+  const LednickyEquation_s &eq = opts.eq;
+
+  std::vector<double> cf;
+  const double *kstar;
+  try {
+    LednickySurrogate surrogate(opts.surrogate_input);
+    cf.resize(surrogate.bins());
+    const double estimate = surrogate.evaluate(eq, cf.data());
+    cerr << "[Lednicky] Surrogate interpolation error estimate " << estimate << "\n";
+    if (opts.surrogate_validate) {
+      cerr << "[Lednicky] Surrogate interpolation error " << surrogate.validate()
+           << " at the grid cell centres\n";
+    }
+
+    std::ofstream file;
+    if (!open_output(opts, file)) {
+      return EXIT_FAILURE;
+    }
+    std::ostream &out = opts.output.empty() ? cout : file;
+
+    kstar = surrogate.kstar();
+    out << std::setprecision(10);
+    out << "kstar,cf\n";
+    for (std::size_t xBin = 0; xBin < cf.size(); xBin++) {
+      out << kstar[xBin] << ','
+          << (1.0 + (cf[xBin] - 1.0) * eq.lamPrimary) / eq.normalization << '\n';
+    }
+    out.flush();
+    return out ? EXIT_SUCCESS : EXIT_FAILURE;
+  } catch (const std::runtime_error& err) {
+    cerr << err.what() << "\n";
+  } catch (const std::invalid_argument& err_ia) {
+    cerr << "Unable to interpolate '" << opts.surrogate_input << "': " << err_ia.what() << "\n";
+  }
+  return EXIT_FAILURE;
+}
+
+int
+run_headless(const ProgramOptions& opts)
+{
+  if (!opts.surrogate_input.empty()) {
+    return run_headless_surrogate(opts);
+  }
+  if (!opts.smear_input.empty()) {
+    return run_headless_smeared(opts);
+  }
+
+  const LednickyEquation_s &eq = opts.eq;
+
+  LednickyWorkspace workspace;
+  const double *kstar, *cf;
+  const std::size_t bins = eq.totalBins;
+
+  std::vector<double> kstar_buffer, cf_buffer;
+  if (opts.bin_average > 0.0) {
+    kstar_buffer.resize(bins);
+    cf_buffer.resize(bins);
+    LednickyBinAverage(opts.bin_average).evaluate(eq, kstar_buffer.data(), cf_buffer.data());
+    kstar = kstar_buffer.data();
+    cf = cf_buffer.data();
+  } else if (opts.adaptive > 0.0) {
+    kstar_buffer.resize(bins);
+    cf_buffer.resize(bins);
+    LednickyAdaptive(opts.adaptive).evaluate(eq, kstar_buffer.data(), cf_buffer.data());
+    kstar = kstar_buffer.data();
+    cf = cf_buffer.data();
+  } else {
+    cf = workspace.evaluate(eq);
+    kstar = workspace.kstar();
+  }
+
+  std::ofstream file;
+  if (!open_output(opts, file)) {
+    return EXIT_FAILURE;
+  }
+  std::ostream &out = opts.output.empty() ? cout : file;
+
+  out << std::setprecision(10);
+  out << "kstar,cf\n";
+  for (std::size_t xBin = 0; xBin < bins; xBin++) {
+    // scaled by lambda and normalization like the drawn curve
+    out << kstar[xBin] << ','
+        << (1.0 + (cf[xBin] - 1.0) * eq.lamPrimary) / eq.normalization << '\n';
+  }
+
+  out.flush();
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Hits and misses of the batch mode's curve cache, if any, to stderr
+static void
+report_cache(const LednickyCurveCache *cache)
+{
+  if (cache == nullptr) {
+    return;
+  }
+  const LednickyCurveCache::Statistics statistics = cache->statistics();
+  cerr << "[Lednicky] Curve cache: " << statistics.hits << " hits, " << statistics.misses << " misses, "
+       << statistics.evictions << " evictions, " << statistics.entries << " curves in "
+       << statistics.bytes / 1024 << " kB\n";
+}
+
+int
+run_batch(const ProgramOptions& opts)
+{
+  std::ifstream input_file;
+  if (opts.batch_input != "-") {
+    input_file.open(opts.batch_input.c_str());
+    if (!input_file) {
+      cerr << "Unable to open batch input file '" << opts.batch_input << "'.\n";
+      return EXIT_FAILURE;
+    }
+  }
+  std::istream &in = (opts.batch_input == "-") ? cin : input_file;
+
+  LednickyBatch batch(opts.eq);
+  std::unique_ptr<LednickyCurveCache> cache;
+  if (opts.cache_bytes != 0) {
+    cache.reset(new LednickyCurveCache(opts.cache_bytes));
+    batch.set_cache(cache.get());
+  }
+
+  if (opts.binary_value_size != 0) {
+    if (!check_binary_output(opts)) {
+      return EXIT_FAILURE;
+    }
+    try {
+      // an empty input leaves an empty file
+      std::unique_ptr<CurveFileWriter> writer;
+      batch.run(in, [&] (const LednickyEquation_s& eq, const double *cf) {
+        if (!writer) {
+          writer.reset(new CurveFileWriter(opts.output, batch.kstar(),
+                                           batch.bins(), opts.binary_value_size));
+        }
+        writer->append(eq, cf);
+      });
+      if (!writer) {
+        writer.reset(new CurveFileWriter(opts.output, nullptr, 0, opts.binary_value_size));
+      }
+      writer->finish();
+    } catch (const std::invalid_argument& err_ia) {
+      cerr << "Unable to read batch input '" << opts.batch_input << "': " << err_ia.what() << "\n";
+      return EXIT_FAILURE;
+    } catch (const std::runtime_error& err) {
+      cerr << err.what() << "\n";
+      return EXIT_FAILURE;
+    }
+    report_cache(cache.get());
+    return EXIT_SUCCESS;
+  }
+
+  std::ofstream file;
+  if (!open_output(opts, file)) {
+    return EXIT_FAILURE;
+  }
+  std::ostream &out = opts.output.empty() ? cout : file;
+
+  try {
+    batch.run(in, out);
+  } catch (const std::invalid_argument& err_ia) {
+    out.flush();
+    cerr << "Unable to read batch input '" << opts.batch_input << "': " << err_ia.what() << "\n";
+    return EXIT_FAILURE;
+  }
+
+  report_cache(cache.get());
+  out.flush();
+  return out ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int
+run_fit(const ProgramOptions& opts)
+{
+  std::ifstream input_file;
+  if (opts.fit_input != "-") {
+    input_file.open(opts.fit_input.c_str());
+    if (!input_file) {
+      cerr << "Unable to open fit input file '" << opts.fit_input << "'.\n";
+      return EXIT_FAILURE;
+    }
+  }
+  std::istream &in = (opts.fit_input == "-") ? cin : input_file;
+
+  FitData data;
+  try {
+    data = read_fit_data(in);
+  } catch (const std::invalid_argument& err_ia) {
+    cerr << "Unable to read fit input '" << opts.fit_input << "': " << err_ia.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  if (data.size() == 0) {
+    cerr << "Fit input '" << opts.fit_input << "' holds no data points.\n";
+    return EXIT_FAILURE;
+  }
+
+  LednickyFitter fitter(data);
+  for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+    fitter.fix(static_cast<FitParameter>(p), opts.fit_fixed[p]);
+  }
+  fitter.set_variable_projection(opts.fit_varpro);
+
+  if (!opts.smear_input.empty()) {
+    MomentumResponse response;
+    if (!load_response(opts, response)) {
+      return EXIT_FAILURE;
+    }
+    try {
+      fitter.chi2().set_response(response);
+    } catch (const std::invalid_argument& err_ia) {
+      cerr << "Unable to smear the fit model: " << err_ia.what() << "\n";
+      return EXIT_FAILURE;
+    }
+  }
+
+  const FitResult result = fitter.fit(opts.eq);
+
+  std::ofstream file;
+  if (!open_output(opts, file)) {
+    return EXIT_FAILURE;
+  }
+  std::ostream &out = opts.output.empty() ? cout : file;
+
+  out << std::setprecision(10);
+  out << "# chi2 " << result.chi2 << ", ndf " << result.ndf
+      << ", iterations " << result.iterations << ", evaluations " << result.evaluations
+      << (result.converged ? "" : ", NOT CONVERGED") << '\n';
+  out << "parameter,value,error\n";
+  for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+    const FitParameter param = static_cast<FitParameter>(p);
+    out << fit_parameter_name(param) << ','
+        << get_fit_parameter(result.eq, param) << ','
+        << result.error[p] << '\n';
+  }
+
+  out.flush();
+  if (!result.converged) {
+    cerr << "The fit did not converge.\n";
+  }
+  return (out && result.converged) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+ProgramOptions
+parse_args(const std::vector<std::string>& args)
+{
+  ProgramOptions opts;
+  auto arg_it = args.cbegin();
+  opts.exe_name = *arg_it;
+
+  auto show_help_and_exit = [&opts] (int status) {
+    usage(opts.exe_name);
+    exit(status);
+  };
+
+  auto set_show_gui = [&opts] (bool yes_or_no) {
+    opts.show_gui = yes_or_no;
+  };
+
+  // the value of `option`: `val` if given as --option=val, else the next
+  // argument, which must exist
+  auto option_value = [&] (const std::string& option, const std::string& val) {
+    if (val != "") {
+      return val;
+    }
+    if (std::next(arg_it) == args.end()) {
+      cerr << "Missing value of '" << option << "'.\n";
+      show_help_and_exit(EXIT_FAILURE);
+    }
+    return *(++arg_it);
+  };
+
+  for (arg_it++; arg_it != args.end(); arg_it++) {
+    auto arg = *arg_it;
+
+    // skip empty arguments
+    if (arg.size() == 0) {
+      continue;
+    }
+
+    auto key_start = std::find_if_not(arg.begin(), arg.end(), [](char c){ return c == '-';}),
+           key_end = std::find(key_start, arg.end(), '=');
+
+    auto value_start = (key_end != arg.end()) ? key_end + 1 : arg.end(),
+           value_end = arg.end();
+
+    int dash_count = std::distance(arg.begin(), key_start);
+
+
+    std::string key(key_start, key_end),
+                val(value_start, value_end);
+
+    // treat each char in key as a single key
+    if (dash_count == 1) {
+      for (auto subkey : key) {
+        switch (subkey){
+        case 'h':
+          show_help_and_exit(EXIT_SUCCESS);
+        default:
+          std::cerr << "Unknown option '" << subkey << "'. Aborting." << std::endl;
+          exit(EXIT_FAILURE);
+        }
+      }
+    } else if (dash_count == 2) {
+
+      if (key == "help") {
+          show_help_and_exit(EXIT_SUCCESS);
+      }
+
+      else if (key == "nogui" || key == "no-gui") {
+        cout << "[Lednicky] Running No-Gui\n";
+        set_show_gui(false);
+      }
+
+      else if (key == "headless") {
+        opts.headless = true;
+      }
+
+      else if (key.compare(0, 5, "scan-") == 0 && opts.scan.axis(key.substr(5)) != nullptr) {
+        std::string axis_param = option_value("--" + key, val);
+        try {
+          *opts.scan.axis(key.substr(5)) = parse_scan_axis(axis_param);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to read " << key << " argument '" << axis_param << "': " << err_ia.what() << "\n";
+          exit(EXIT_FAILURE);
+        }
+        opts.scan_mode = true;
+      }
+
+      else if (key == "scan-file") {
+        std::string scan_file = option_value("--" + key, val);
+        std::ifstream in(scan_file);
+        if (!in) {
+          cerr << "Unable to open scan file '" << scan_file << "'.\n";
+          exit(EXIT_FAILURE);
+        }
+        try {
+          read_scan_grid(in, opts.scan);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to read scan file '" << scan_file << "': " << err_ia.what() << "\n";
+          exit(EXIT_FAILURE);
+        }
+        opts.scan_mode = true;
+      }
+
+      else if (key == "batch") {
+        opts.batch_input = option_value("--" + key, val);
+        opts.batch_mode = true;
+      }
+
+      else if (key == "fit") {
+        opts.fit_input = option_value("--" + key, val);
+        opts.fit_mode = true;
+      }
+
+      else if (key == "fit-varpro") {
+        opts.fit_varpro = true;
+      }
+
+      else if (key == "bin-average") {
+        try {
+          opts.bin_average = (val == "") ? 1e-6 : std::stod(val);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to transform bin-average tolerance '" << val << "' into a floating point number.\n";
+          exit(EXIT_FAILURE);
+        }
+        if (!(opts.bin_average > 0.0)) {
+          cerr << "The bin-average tolerance must be positive.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      else if (key == "adaptive") {
+        try {
+          opts.adaptive = (val == "") ? 1e-6 : std::stod(val);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to transform adaptive tolerance '" << val << "' into a floating point number.\n";
+          exit(EXIT_FAILURE);
+        }
+        if (!(opts.adaptive > 0.0)) {
+          cerr << "The adaptive tolerance must be positive.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      else if (key == "asymptotic-tolerance") {
+        std::string tolerance_param = option_value("--" + key, val);
+        try {
+          opts.eq.asymptotic_tolerance = std::stod(tolerance_param);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to transform asymptotic tolerance '" << tolerance_param << "' into a floating point number.\n";
+          exit(EXIT_FAILURE);
+        }
+        if (!(opts.eq.asymptotic_tolerance >= 0.0)) {
+          cerr << "The asymptotic tolerance must not be negative.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      else if (key == "spline-basis") {
+        opts.eq.spline_basis = true;
+      }
+
+      else if (key == "surrogate") {
+        opts.surrogate_input = option_value("--" + key, val);
+      }
+
+      else if (key == "surrogate-validate") {
+        opts.surrogate_validate = true;
+      }
+
+      else if (key == "smear") {
+        opts.smear_input = option_value("--" + key, val);
+      }
+
+      else if (key == "fix") {
+        std::stringstream names(option_value("--" + key, val));
+        for (std::string name; std::getline(names, name, ','); ) {
+          FitParameter p;
+          if (!parse_fit_parameter(name, p)) {
+            cerr << "Unknown fit parameter '" << name << "'.\n";
+            exit(EXIT_FAILURE);
+          }
+          opts.fit_fixed[p] = true;
+        }
+      }
+
+      else if (key == "binary") {
+        if (val == "" || val == "double") {
+          opts.binary_value_size = sizeof(double);
+        } else if (val == "float") {
+          opts.binary_value_size = sizeof(float);
+        } else {
+          cerr << "Unknown binary value type '" << val << "', expected 'float' or 'double'.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      else if (key == "cache") {
+        double megabytes = 64.0;
+        if (val != "") {
+          try {
+            megabytes = std::stod(val);
+          } catch (const std::logic_error& err_le) {
+            cerr << "Unable to transform cache size '" << val << "' into a floating point number.\n";
+            exit(EXIT_FAILURE);
+          }
+        }
+        if (!(megabytes > 0.0)) {
+          cerr << "The cache size must be positive.\n";
+          exit(EXIT_FAILURE);
+        }
+        if (!(megabytes < std::numeric_limits<std::size_t>::max() / double(1 << 20))) {
+          cerr << "The cache size '" << val << "' is too large.\n";
+          exit(EXIT_FAILURE);
+        }
+        opts.cache_bytes = static_cast<std::size_t>(megabytes * (1 << 20));
+      }
+
+      else if (key == "threads") {
+        std::string threads_param = option_value("--" + key, val);
+        int threads = 0;
+        try {
+          threads = std::stoi(threads_param);
+        } catch (const std::logic_error& err) {
+          cerr << "Unable to transform threads argument '" << threads_param << "' into an integer.\n";
+          exit(EXIT_FAILURE);
+        }
+        if (threads < 1) {
+          cerr << "The number of threads must be positive.\n";
+          exit(EXIT_FAILURE);
+        }
+        opts.threads = threads;
+      }
+
+      else if (key == "f0re" || key == "f0im" || key == "lambda" || key == "normalization") {
+        std::string param = option_value("--" + key, val);
+        FitParameter p = FIT_F0RE;
+        parse_fit_parameter(key, p);
+        try {
+          set_fit_parameter(opts.eq, p, std::stod(param));
+        } catch (const std::logic_error& err) {
+          cerr << "Unable to transform " << key << " argument '" << param << "' into a floating point number.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      else if (key == "radius") {
+        std::string radius_param = option_value("--" + key, val);
+        try {
+          opts.eq.radius = std::stof(radius_param);
+        } catch (const std::invalid_argument& err_ia) {
+          cerr << "Unable to transform radius argument '" << radius_param << "' into a floating point number.\n";
+          exit(EXIT_FAILURE);
+        }
+      }
+
+    // cout << "dash_count "<<dash_count << "\n";
+    // std::cout << "Found key '" << key << "'\n";
+    // std::cout << "Found value '" << val << "'\n";
+
+    else if (arg == "--nonidentical") {
+      opts.eq.identical = false;
+    }
+    else if (arg == "--identical") {
+      opts.eq.identical = true;
+    }
+    else if (arg == "--bin_count") {
+      std::string bin_param(option_value(arg, ""));
+      try {
+        opts.eq.totalBins = std::stoi(bin_param);
+      } catch (const std::logic_error& err) {
+        cerr << "Unable to transform bin_count argument '" << bin_param << "' into an integer.\n";
+        exit(EXIT_FAILURE);
+      }
+      if (opts.eq.totalBins < 1) {
+        cerr << "The bin count must be positive.\n";
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (arg == "--max_kstar") {
+      std::string kstar_param(option_value(arg, ""));
+      try {
+        opts.eq.maxKstar = std::stof(kstar_param);
+      } catch (const std::invalid_argument& err_ia) {
+        cerr << "Unable to transform max_kstar argument '" << kstar_param << "' into a floating point number.\n";
+        exit(EXIT_FAILURE);
+      }
+    }
+    else if (arg == "--range" || arg == "--d0") {
+      opts.eq.d0 = std::stod(option_value(arg, ""));
+    }
+    else if (arg == "--title") {
+      opts.title = option_value(arg, "");
+    }
+    else if (arg[0] == '-') {
+      cerr << "Unknown option '" << arg << "'\n";
+      usage(opts.exe_name);
+      exit(EXIT_FAILURE);
+    }
+    else {
+      opts.output = arg;
+    }
+  } else {
+    // positional argument: the output file
+    opts.output = arg;
+  }
+}
+  return opts;
+}
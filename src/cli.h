@@ -0,0 +1,110 @@
+///
+/// \file cli.h
+/// \brief Command line handling shared by the lednicky executables
+///
+/// Nothing in here depends on ROOT, so the headless executable can be
+/// linked against liblednicky alone.
+///
+
+#pragma once
+
+#include "lednicky.h"
+#include "adaptive.h"
+#include "batch.h"
+#include "binaverage.h"
+#include "curvefile.h"
+#include "fit.h"
+#include "scan.h"
+#include "smearing.h"
+#include "surrogate.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct ProgramOptions {
+  bool show_gui {true};
+  std::string exe_name;
+  std::string output;
+  std::string title;
+
+  /// Parameters of the correlation function
+  LednickyEquation_s eq;
+
+  /// Write the curve as text instead of drawing it; never touches ROOT
+  bool headless {false};
+
+  /// Evaluate a parameter grid instead of drawing a single curve
+  bool scan_mode {false};
+
+  /// Parameter grid of the scan mode
+  ScanGrid scan;
+
+  /// Worker threads of the scan mode (0 uses every core)
+  unsigned threads {0};
+
+  /// Evaluate one parameter set per line of `batch_input`
+  bool batch_mode {false};
+
+  /// Input of the batch mode, "-" for stdin
+  std::string batch_input;
+
+  /// Bytes of curves the batch mode keeps for repeated parameter sets (see
+  /// LednickyCurveCache), 0 for no cache
+  std::size_t cache_bytes {0};
+
+  /// Bytes per value of binary scan/batch output, 0 writes CSV
+  std::size_t binary_value_size {0};
+  /// Fit the model to the measured correlation function in `fit_input`
+  bool fit_mode {false};
+
+  /// Input of the fit mode, "-" for stdin
+  std::string fit_input;
+
+  /// Parameters the fit keeps at their command line values
+  bool fit_fixed[FIT_PARAMETER_COUNT] {};
+
+  /// Solve lambda and normalization in closed form (variable projection)
+  bool fit_varpro {false};
+
+  /// Write bin averages of the curve, to this absolute tolerance, instead
+  /// of its bin centre values; 0 turns it off
+  double bin_average {0.0};
+
+  /// Sample the curve adaptively and interpolate it onto the bins, to this
+  /// absolute tolerance; 0 evaluates every bin
+  double adaptive {0.0};
+
+  /// Momentum response matrix the curve and fit model are smeared with
+  /// (see read_momentum_response()), empty for none
+  std::string smear_input;
+
+  /// Curve file of a scan grid the curve is interpolated from (see
+  /// LednickySurrogate), empty to evaluate it
+  std::string surrogate_input;
+
+  /// Measure the surrogate's error against the model (see
+  /// LednickySurrogate::validate())
+  bool surrogate_validate {false};
+};
+
+void usage(const std::string& exe_name);
+
+/// Parse the command line; prints usage and exits on invalid input
+ProgramOptions parse_args(const std::vector<std::string>& args);
+
+/// Write the curve of `opts.eq` as 'kstar,cf' CSV to the output file or
+/// stdout; with `opts.smear_input` on the reconstructed k* bins of the
+/// response, with `opts.surrogate_input` on the k* of the grid file
+int run_headless(const ProgramOptions& opts);
+
+/// Write one CSV row per point of `opts.scan` to the output file or stdout
+int run_scan(const ProgramOptions& opts);
+
+/// Stream the parameter sets of `opts.batch_input` through a LednickyBatch
+/// into the output file or stdout
+int run_batch(const ProgramOptions& opts);
+
+/// Fit `opts.eq` to the data of `opts.fit_input` and write the result as
+/// 'parameter,value,error' CSV to the output file or stdout
+int run_fit(const ProgramOptions& opts);
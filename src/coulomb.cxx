@@ -0,0 +1,527 @@
+///
+/// \file coulomb.cxx
+/// \brief Implementation of the Coulomb special functions and their table
+///
+
+#include "coulomb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+
+typedef std::complex<double> complex_t;
+
+static const double hbarc = 0.19732697;
+
+/// Fine structure constant
+static const double ALPHA = 1.0 / 137.035999084;
+
+static const double EULER_GAMMA = 0.57721566490153286061;
+
+/// zeta(3), zeta(5), ..., zeta(15): h(eta) = -gamma - ln eta
+/// + sum_m (-1)^(m+1) zeta(2m+1) eta^(2m) for |eta| < 1
+static const double ZETA_ODD[7] = {
+  1.2020569031595942854, 1.0369277551433699263, 1.0083492773819228268,
+  1.0020083928260822144, 1.0004941886041194646, 1.0001227133475784891,
+  1.0000305882363070205
+};
+
+/// B_2n / 2n for n = 1..7, the asymptotic series of digamma
+static const double DIGAMMA_ASYMPTOTIC[7] = {
+  1.0 / 12, -1.0 / 120, 1.0 / 252, -1.0 / 240, 1.0 / 132, -691.0 / 32760, 1.0 / 12
+};
+
+/// B_2n for n = 1..7, the asymptotic series of trigamma
+static const double TRIGAMMA_ASYMPTOTIC[7] = {
+  1.0 / 6, -1.0 / 30, 1.0 / 42, -1.0 / 30, 5.0 / 66, -691.0 / 2730, 7.0 / 6
+};
+
+/// psi(z) for Re z > 0: shifted up by the recurrence until Re z >= 10,
+/// then the asymptotic series
+static complex_t
+digamma(complex_t z)
+{
+  complex_t result = 0.0;
+  for (; z.real() < 10.0; z += 1.0) {
+    result -= 1.0 / z;
+  }
+
+  const complex_t inv_z2 = 1.0 / (z * z);
+  complex_t series = 0.0;
+  for (int n = 6; n >= 0; --n) {
+    series = (series + DIGAMMA_ASYMPTOTIC[n]) * inv_z2;
+  }
+  return result + std::log(z) - 0.5 / z - series;
+}
+
+/// psi'(z) for Re z > 0, as digamma()
+static complex_t
+trigamma(complex_t z)
+{
+  complex_t result = 0.0;
+  for (; z.real() < 10.0; z += 1.0) {
+    result += 1.0 / (z * z);
+  }
+
+  const complex_t inv_z = 1.0 / z,
+                  inv_z2 = inv_z * inv_z;
+  complex_t series = 0.0;
+  for (int n = 6; n >= 0; --n) {
+    series = (series + TRIGAMMA_ASYMPTOTIC[n]) * inv_z2;
+  }
+  return result + inv_z + 0.5 * inv_z2 + series * inv_z;
+}
+
+double
+coulomb_bohr_radius(double reduced_mass, double charge_product)
+{
+  return hbarc / (reduced_mass * charge_product * ALPHA);
+}
+
+double
+gamow_factor(double eta)
+{
+  const double w = 2.0 * M_PI * eta;
+  if (std::fabs(w) < 1e-8) {
+    return 1.0 - 0.5 * w;
+  }
+  return w / std::expm1(w);
+}
+
+double
+coulomb_h(double eta)
+{
+  const double a = std::fabs(eta);
+  if (a == 0.0) {
+    return std::numeric_limits<double>::infinity();
+  }
+
+  // the cancellation in Re psi - ln eta is avoided on both ends
+  if (a > 10.0) {
+    const double inv_a2 = 1.0 / (a * a);
+    double series = 0.0;
+    for (int n = 6; n >= 0; --n) {
+      series = (series + std::fabs(DIGAMMA_ASYMPTOTIC[n])) * inv_a2;
+    }
+    return series;
+  }
+  if (a < 0.1) {
+    const double a2 = a * a;
+    double series = 0.0;
+    for (int m = 6; m >= 0; --m) {
+      series = ((m % 2 == 0) ? ZETA_ODD[m] : -ZETA_ODD[m]) + series * a2;
+    }
+    return series * a2 - EULER_GAMMA - std::log(a);
+  }
+
+  return digamma(complex_t(1.0, a)).real() - std::log(a);
+}
+
+double
+coulomb_h_dlogx(double eta)
+{
+  // h = Re psi(1 + i eta) - ln eta and d/d(ln x) = -eta d/d(eta)
+  const double a = std::fabs(eta);
+  return a * trigamma(complex_t(1.0, a)).imag() + 1.0;
+}
+
+namespace {
+
+struct CoulombHTable {
+  double coeffs[COULOMB_H_INTERVALS][4];
+  float coeffs_float[COULOMB_H_INTERVALS][4];
+  double error;
+
+  CoulombHTable();
+};
+
+CoulombHTable::CoulombHTable():
+  error(0.0)
+{
+  const double t_min = std::log(COULOMB_H_X_MIN),
+               step = (std::log(COULOMB_H_X_MAX) - t_min) / COULOMB_H_INTERVALS;
+
+  double h0 = coulomb_h(1.0 / COULOMB_H_X_MIN),
+         d0 = coulomb_h_dlogx(1.0 / COULOMB_H_X_MIN);
+
+  for (int j = 0; j < COULOMB_H_INTERVALS; ++j) {
+    const double eta1 = std::exp(-(t_min + (j + 1) * step)),
+                 h1 = coulomb_h(eta1),
+                 d1 = coulomb_h_dlogx(eta1);
+
+    // cubic Hermite interpolant in u = (ln x - t_j) / step
+    double *c = coeffs[j];
+    c[0] = h0;
+    c[1] = step * d0;
+    c[2] = 3.0 * (h1 - h0) - step * (2.0 * d0 + d1);
+    c[3] = 2.0 * (h0 - h1) + step * (d0 + d1);
+    std::copy(c, c + 4, coeffs_float[j]);
+
+    for (int s = 1; s < 16; ++s) {
+      const double u = s / 16.0,
+                   value = c[0] + u * (c[1] + u * (c[2] + u * c[3])),
+                   exact = coulomb_h(std::exp(-(t_min + (j + u) * step)));
+      error = std::max(error, std::fabs(value - exact));
+    }
+
+    h0 = h1;
+    d0 = d1;
+  }
+}
+
+const CoulombHTable&
+coulomb_h_table()
+{
+  static const CoulombHTable table;
+  return table;
+}
+
+} // anonymous namespace
+
+const double*
+coulomb_h_coeffs(double)
+{
+  return coulomb_h_table().coeffs[0];
+}
+
+const float*
+coulomb_h_coeffs(float)
+{
+  return coulomb_h_table().coeffs_float[0];
+}
+
+double
+coulomb_h_table_error()
+{
+  return coulomb_h_table().error;
+}
+
+namespace {
+
+/// Gauss-Legendre rule of order 16 on [0, 1]
+struct GaussLegendre {
+  static const int ORDER = 16;
+  double nodes[ORDER];
+  double weights[ORDER];
+
+  GaussLegendre();
+};
+
+GaussLegendre::GaussLegendre()
+{
+  // Newton iteration on the roots of P_16 from their asymptotic positions
+  for (int i = 0; i < ORDER; ++i) {
+    double z = std::cos(M_PI * (i + 0.75) / (ORDER + 0.5)),
+           derivative = 1.0;
+    for (int iteration = 0; iteration < 100; ++iteration) {
+      double p0 = 1.0, p1 = 0.0;
+      for (int j = 1; j <= ORDER; ++j) {
+        const double p2 = p1;
+        p1 = p0;
+        p0 = ((2 * j - 1) * z * p1 - (j - 1) * p2) / j;
+      }
+      derivative = ORDER * (z * p0 - p1) / (z * z - 1.0);
+      const double step = p0 / derivative;
+      z -= step;
+      if (std::fabs(step) < 1e-16) {
+        break;
+      }
+    }
+    nodes[i] = 0.5 * (1.0 - z);
+    weights[i] = 1.0 / ((1.0 - z * z) * derivative * derivative);
+  }
+}
+
+/// Terms of the power series of phi and y2 about u = 0
+const int SOURCE_SERIES_TERMS = 120;
+
+/// The source weight is below 1e-21 past u = 14
+const double SOURCE_U_MAX = 14.0;
+
+/// One Taylor step of u y'' = (2p - x^2 u) y from u0 to u0 + h, for y and
+/// y' at u0. The series of the coefficients of (u - u0)^m converges for
+/// |h| < u0.
+void
+source_taylor_step(double p, double x2, double u0, double h, double &y, double &dy)
+{
+  double c_prev = 0.0, c0 = y, c1 = dy,
+         h_power = h,
+         sum = y + dy * h,
+         dsum = dy,
+         scale = std::fabs(y) + std::fabs(sum);
+  for (int m = 0; m < 200; ++m) {
+    const double c2 = ((2.0 * p - x2 * u0) * c0 - x2 * c_prev - m * (m + 1.0) * c1)
+                    / (u0 * (m + 1.0) * (m + 2.0)),
+                 term = c2 * h_power * h;
+    sum += term;
+    dsum += (m + 2) * c2 * h_power;
+    scale = std::max(scale, std::fabs(term));
+    c_prev = c0;
+    c0 = c1;
+    c1 = c2;
+    h_power *= h;
+    if (m > 4 && std::fabs(term) < 1e-17 * scale && std::fabs(c1 * h_power * h) < 1e-17 * scale) {
+      break;
+    }
+  }
+  y = sum;
+  dy = dsum;
+}
+
+/// Advance y, y' from u to `target` > u in steps of at most half the
+/// distance to the singular point u = 0 and two local wavelengths
+void
+source_advance(double p, double x2, double u, double target, double &y, double &dy)
+{
+  while (u < target) {
+    const double k = std::sqrt(std::fabs(x2 - 2.0 * p / u)),
+                 h = std::min(target - u, std::min(0.5 * u, 2.0 / std::max(k, 1e-300)));
+    source_taylor_step(p, x2, u, h, y, dy);
+    u = (target - (u + h) < 1e-15 * target) ? target : u + h;
+  }
+}
+
+} // anonymous namespace
+
+void
+coulomb_source_integrals(double x, double p, double *integrals)
+{
+  static const GaussLegendre rule;
+  const double x2 = x * x;
+
+  // panels of at most a quarter of the shortest period of phi^2 at large x,
+  // and geometric ones towards the logarithm of y2 at u = 0
+  const double width = std::min(1.0, 4.0 / std::max(x, 1e-300));
+  std::vector<double> us, ws;
+  double lower = 0.0;
+  for (int e = -6; e <= 0; ++e) {
+    const double upper = width * std::pow(10.0, e);
+    for (int i = 0; i < GaussLegendre::ORDER; ++i) {
+      us.push_back(lower + (upper - lower) * rule.nodes[i]);
+      ws.push_back((upper - lower) * rule.weights[i]);
+    }
+    lower = upper;
+  }
+  for (; lower < SOURCE_U_MAX; lower += width) {
+    const double upper = std::min(SOURCE_U_MAX, lower + width);
+    for (int i = 0; i < GaussLegendre::ORDER; ++i) {
+      us.push_back(lower + (upper - lower) * rule.nodes[i]);
+      ws.push_back((upper - lower) * rule.weights[i]);
+    }
+  }
+
+  // phi = sum a_n u^n and y2 = 2p phi ln u + sum b_n u^n, summed up to
+  // x u = 1 where they do not cancel yet, then integrated as the ODE
+  double a[SOURCE_SERIES_TERMS], b[SOURCE_SERIES_TERMS];
+  a[0] = 0.0;
+  a[1] = 1.0;
+  b[0] = 1.0;
+  b[1] = 0.0;
+  for (int n = 2; n < SOURCE_SERIES_TERMS; ++n) {
+    a[n] = (2.0 * p * a[n - 1] - x2 * a[n - 2]) / (n * (n - 1.0));
+    b[n] = (2.0 * p * b[n - 1] - x2 * b[n - 2] - 2.0 * p * (2 * n - 1) * a[n])
+         / ((n - 1.0) * n);
+  }
+  const double series_u = std::min(1.0, 1.0 / std::max(x, 1e-300));
+
+  const std::size_t count = us.size();
+  std::vector<double> phi(count), dphi(count), y2(count);
+  double u_last = 0.0, y = 0.0, dy = 0.0, z = 0.0, dz = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double u = us[i];
+    if (u <= series_u) {
+      double s = 0.0, ds = 0.0, t = 0.0, dt = 0.0, u_power = 1.0;
+      for (int n = 0; n < SOURCE_SERIES_TERMS && u_power > 1e-300; ++n) {
+        s += a[n] * u_power;
+        t += b[n] * u_power;
+        if (n > 0) {
+          ds += n * a[n] * u_power / u;
+          dt += n * b[n] * u_power / u;
+        }
+        u_power *= u;
+      }
+      const double log_u = std::log(u);
+      y = s;
+      dy = ds;
+      z = 2.0 * p * s * log_u + t;
+      dz = 2.0 * p * (ds * log_u + s / u) + dt;
+    } else {
+      source_advance(p, x2, u_last, u, y, dy);
+      source_advance(p, x2, u_last, u, z, dz);
+    }
+    u_last = u;
+    phi[i] = y;
+    dphi[i] = dy;
+    y2[i] = z;
+  }
+
+  const double norm = 0.5 / std::sqrt(M_PI);
+  double t0 = 0.0, q = 0.0, phi_phi = 0.0, y2_phi = 0.0, y2_y2 = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double u = us[i],
+                 w = ws[i] * std::exp(-0.25 * u * u) * norm;
+    phi_phi += w * phi[i] * phi[i];
+    y2_phi += w * y2[i] * phi[i];
+    y2_y2 += w * y2[i] * y2[i];
+
+    if (p == 0.0) {
+      continue;
+    }
+
+    // u^2 |psi_c|^2 averaged over directions is sum_l (2l + 1) y_l^2 with
+    // y_l = F_l/(C_0 x), and the exchange term takes (-1)^l; y_l by Miller's
+    // downward recurrence, normalized to y_0 = phi and y_1 from phi'
+    const int top = static_cast<int>(x * u + 3.0 * std::sqrt(x * u) + 40.0);
+    double upper = 0.0, current = 1.0, even = 0.0, odd = 0.0;
+    for (int l = top; l >= 1; --l) {
+      const double lower = ((2 * l + 1) * (p + l * (l + 1.0) / u) * current
+                            - l * std::sqrt(x2 * (l + 1.0) * (l + 1.0) + p * p) * upper)
+                         / ((l + 1) * std::sqrt(x2 * l * l + p * p));
+      (l % 2 ? odd : even) += (2 * l + 1) * current * current;
+      upper = current;
+      current = lower;
+      if (std::fabs(current) > 1e100) {
+        upper *= 1e-100;
+        current *= 1e-100;
+        even *= 1e-200;
+        odd *= 1e-200;
+      }
+    }
+    even += current * current;
+
+    const double y0 = phi[i],
+                 y1 = ((1.0 / u + p) * phi[i] - dphi[i]) / std::sqrt(x2 + p * p),
+                 scale = (y0 * current + y1 * upper) / (current * current + upper * upper);
+    t0 += w * (even + odd) * scale * scale;
+    q += w * (even - odd) * scale * scale;
+  }
+
+  if (p == 0.0) {
+    t0 = 1.0;
+    q = std::exp(-4.0 * x2);
+  }
+
+  integrals[COULOMB_SOURCE_T0] = t0;
+  integrals[COULOMB_SOURCE_Q] = q;
+  integrals[COULOMB_SOURCE_PHI_PHI] = phi_phi;
+  integrals[COULOMB_SOURCE_Y2_PHI] = y2_phi;
+  integrals[COULOMB_SOURCE_Y2_Y2] = y2_y2;
+}
+
+namespace {
+
+// SOURCE_TABLE_ERROR and SOURCE_COEFFS, written by `make coulomb-table`
+#include "coulomb_source_coeffs.inc"
+
+struct CoulombSourceTable {
+  float coeffs_float[COULOMB_SOURCE_PANELS][COULOMB_SOURCE_P_NODES][COULOMB_SOURCE_STRIDE];
+  double panels[COULOMB_SOURCE_PANELS][2];
+  float panels_float[COULOMB_SOURCE_PANELS][2];
+
+  /// Chebyshev nodes in p/COULOMB_SOURCE_P_MAX and their barycentric
+  /// weights (-1)^j sin(theta_j)
+  double nodes[COULOMB_SOURCE_P_NODES];
+  double node_weights[COULOMB_SOURCE_P_NODES];
+
+  CoulombSourceTable();
+};
+
+/// Lower edge of panel n, COULOMB_SOURCE_X_MAX at n = COULOMB_SOURCE_PANELS
+double
+source_panel_edge(int n)
+{
+  return (n < 2) ? 0.25 * n : 0.5 * std::pow(2.0, 0.5 * (n - 2));
+}
+
+CoulombSourceTable::CoulombSourceTable()
+{
+  const double *c = SOURCE_COEFFS[0][0];
+  std::copy(c, c + COULOMB_SOURCE_PANELS * COULOMB_SOURCE_P_NODES * COULOMB_SOURCE_STRIDE,
+            coeffs_float[0][0]);
+
+  for (int n = 0; n < COULOMB_SOURCE_PANELS; ++n) {
+    const double lower = source_panel_edge(n),
+                 upper = source_panel_edge(n + 1);
+    panels[n][0] = 0.5 * (lower + upper);
+    panels[n][1] = 2.0 / (upper - lower);
+    std::copy(panels[n], panels[n] + 2, panels_float[n]);
+  }
+
+  for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+    const double theta = M_PI * (j + 0.5) / COULOMB_SOURCE_P_NODES;
+    nodes[j] = std::cos(theta);
+    node_weights[j] = (j % 2 ? -1.0 : 1.0) * std::sin(theta);
+  }
+}
+
+const CoulombSourceTable&
+coulomb_source_table()
+{
+  static const CoulombSourceTable table;
+  return table;
+}
+
+} // anonymous namespace
+
+int
+coulomb_source_panel(double x)
+{
+  if (!(x >= 0.5)) {
+    return (x < 0.25) ? 0 : 1;
+  }
+  const int n = 2 + static_cast<int>(2.0 * std::log2(2.0 * x));
+  return std::min(n, COULOMB_SOURCE_PANELS - 1);
+}
+
+const double*
+coulomb_source_coeffs(double)
+{
+  return SOURCE_COEFFS[0][0];
+}
+
+const float*
+coulomb_source_coeffs(float)
+{
+  return coulomb_source_table().coeffs_float[0][0];
+}
+
+const double*
+coulomb_source_panels(double)
+{
+  return coulomb_source_table().panels[0];
+}
+
+const float*
+coulomb_source_panels(float)
+{
+  return coulomb_source_table().panels_float[0];
+}
+
+void
+coulomb_source_weights(double p, double *weights)
+{
+  const CoulombSourceTable &table = coulomb_source_table();
+  const double t = p / COULOMB_SOURCE_P_MAX;
+
+  double sum = 0.0;
+  for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+    if (t == table.nodes[j]) {
+      std::fill(weights, weights + COULOMB_SOURCE_P_NODES, 0.0);
+      weights[j] = 1.0;
+      return;
+    }
+    weights[j] = table.node_weights[j] / (t - table.nodes[j]);
+    sum += weights[j];
+  }
+  for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+    weights[j] /= sum;
+  }
+}
+
+double
+coulomb_source_table_error()
+{
+  return SOURCE_TABLE_ERROR;
+}
@@ -0,0 +1,145 @@
+///
+/// \file coulomb.h
+/// \brief Special functions of the Lednicky-Lyuboshits model of a pair of
+///        charged particles
+///
+/// A pair of charged particles with Bohr radius a_c and relative momentum
+/// k* has the Coulomb parameter eta = 1/(k* a_c), with k* in fm^-1. The
+/// strong amplitude is then modified by the Gamow factor
+///
+///   A_c(eta) = 2 pi eta / (exp(2 pi eta) - 1)
+///
+/// and by h(eta) = Re psi(1 + i eta) - ln|eta|, where psi is the digamma
+/// function:
+///
+///   1/f_c = 1/f0 + d0 k*^2/2 - 2 h(eta)/a_c - i k* A_c(eta).
+///
+/// The functions here are exact to about 1e-15. The batch kernels instead
+/// interpolate h(1/x) from a table, with x = k* |a_c| (see
+/// coulomb_h_coeffs()).
+///
+/// Over a Gaussian source of radius R the Coulomb wave functions enter
+/// through five integrals of x = k* R and p = R/a_c, tabulated further
+/// down (see coulomb_source_integrals()).
+///
+
+#pragma once
+
+/// Bohr radius a_c = hbar c / (mu z1 z2 alpha) in fm of a pair with
+/// reduced mass `reduced_mass` (GeV/c^2) and charge product z1 z2 (units
+/// of e). Positive for repulsion, negative for attraction.
+double coulomb_bohr_radius(double reduced_mass, double charge_product);
+
+/// Gamow factor 2 pi eta / (exp(2 pi eta) - 1), 1 at eta = 0
+double gamow_factor(double eta);
+
+/// h(eta) = Re psi(1 + i eta) - ln|eta|, an even function of eta that
+/// diverges like -ln|eta| at eta = 0
+double coulomb_h(double eta);
+
+/// Derivative of h(1/x) with respect to ln x, at x = 1/eta
+double coulomb_h_dlogx(double eta);
+
+/*
+ * h(1/x) is tabulated for COULOMB_H_X_MIN <= x <= COULOMB_H_X_MAX on
+ * COULOMB_H_INTERVALS intervals of equal width in ln x. Each interval holds
+ * the cubic Hermite interpolant of h and dh/d(ln x) at its ends, as four
+ * polynomial coefficients in the position u in [0, 1) within the interval.
+ * Outside the table the series of h in x^2 (x < COULOMB_H_X_MIN) and in
+ * 1/x^2 (x > COULOMB_H_X_MAX) converge to double precision within a few
+ * terms.
+ */
+const double COULOMB_H_X_MIN = 0.1;
+const double COULOMB_H_X_MAX = 10.0;
+const int COULOMB_H_INTERVALS = 512;
+
+/// Interpolation coefficients of h(1/x), 4 per interval, lowest order
+/// first. Built on first use; see coulomb_h_table_error().
+const double* coulomb_h_coeffs(double);
+
+/// The same table rounded to float, for the single precision kernels
+const float* coulomb_h_coeffs(float);
+
+/// Largest absolute error of the double table against coulomb_h(),
+/// sampled at 16 points per interval when the table is built: 3.0e-11,
+/// largest around x = 1.5. In 1/f_c it is scaled by 2/|a_c|, which is
+/// 0.035 fm^-1 for pp.
+double coulomb_h_table_error();
+
+/*
+ * Finite-size Coulomb integrals. With u = r/R, the radial density
+ * u^2 exp(-u^2/4)/(2 sqrt(pi)) of the source and the regular and
+ * irregular s-wave solutions phi and y2 of u y'' = (2p - x^2 u) y,
+ *
+ *   phi = u + p u^2 + ...,  y2 = 1 + 2p phi ln u + O(u^2),
+ *
+ * the integrals are, in this order,
+ *
+ *   T0 = <|psi_c(r)|^2>/A_c,  Q = <psi_c(r) psi_c*(-r)>/A_c,
+ *   Y_phiphi = <phi^2/u^2>,  Y_2phi = <y2 phi/u^2>,  Y_22 = <y2^2/u^2>,
+ *
+ * with psi_c the Coulomb scattering wave of the pair and <> the average
+ * over the source and the directions of r. phi and y2 are entire
+ * functions of p and x^2, and so are the integrals; at p = 0 they are 1,
+ * exp(-4x^2), (1 - exp(-4x^2))/(4x^2), D(2x)/(2 sqrt(pi) x) and
+ * (1 + exp(-4x^2))/4, with D the Dawson function.
+ *
+ * The table covers |p| <= COULOMB_SOURCE_P_MAX and x <= COULOMB_SOURCE_X_MAX.
+ * Each integral is interpolated in p through its values at
+ * COULOMB_SOURCE_P_NODES Chebyshev nodes (coulomb_source_weights()) and
+ * held, for every node, as a polynomial of degree COULOMB_SOURCE_DEGREE in
+ * t in [-1, 1] across each of COULOMB_SOURCE_PANELS panels of x: [0, 1/4],
+ * [1/4, 1/2], then panels growing by sqrt(2) up to COULOMB_SOURCE_X_MAX
+ * (coulomb_source_panels()). Past the table the kernels take the leading
+ * terms of the large-x expansions.
+ */
+const double COULOMB_SOURCE_P_MAX = 0.5;
+const double COULOMB_SOURCE_X_MAX = 64.0;
+const int COULOMB_SOURCE_P_NODES = 16;
+const int COULOMB_SOURCE_PANELS = 16;
+const int COULOMB_SOURCE_DEGREE = 7;
+const int COULOMB_SOURCE_INTEGRALS = 5;
+
+/// Coefficients per panel and p node: COULOMB_SOURCE_DEGREE + 1 per
+/// integral, lowest order first
+const int COULOMB_SOURCE_STRIDE = COULOMB_SOURCE_INTEGRALS * (COULOMB_SOURCE_DEGREE + 1);
+
+/// Order of the integrals in the table and in coulomb_source_integrals()
+enum CoulombSourceIntegral {
+  COULOMB_SOURCE_T0,
+  COULOMB_SOURCE_Q,
+  COULOMB_SOURCE_PHI_PHI,
+  COULOMB_SOURCE_Y2_PHI,
+  COULOMB_SOURCE_Y2_Y2
+};
+
+/// The five integrals at x = k* R >= 0 and p = R/a_c, by quadrature of
+/// phi, y2 and of the partial wave series of F. Accurate to about 1e-13
+/// and slow (milliseconds); it builds and checks the table.
+void coulomb_source_integrals(double x, double p, double *integrals);
+
+/// Panel of the table holding x, clamped to the last one past the table
+int coulomb_source_panel(double x);
+
+/// Table coefficients, [panel][p node][COULOMB_SOURCE_STRIDE]. Generated by
+/// `make coulomb-table` into coulomb_source_coeffs.inc.
+const double* coulomb_source_coeffs(double);
+
+/// The same table rounded to float, for the single precision kernels
+const float* coulomb_source_coeffs(float);
+
+/// Centre and inverse half width of every panel,
+/// t = (x - centre) * inverse half width
+const double* coulomb_source_panels(double);
+const float* coulomb_source_panels(float);
+
+/// Barycentric weights of the p nodes at `p`, summing to 1: an integral at
+/// p is sum_j weights[j] times its value at node j, which lies at
+/// p_j = COULOMB_SOURCE_P_MAX cos(pi (j + 1/2) / COULOMB_SOURCE_P_NODES)
+void coulomb_source_weights(double p, double *weights);
+
+/// Largest error of the table against coulomb_source_integrals(), relative
+/// to T0, measured when it is generated at 4 points of x in each panel and
+/// 9 values of p: 2.3e-8, in Q around x = 1.6. Past the table the large-x
+/// forms change C by less than 1e-7.
+double coulomb_source_table_error();
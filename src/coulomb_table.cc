@@ -0,0 +1,155 @@
+///
+/// \file coulomb_table.cc
+/// \brief coulomb-table: generator of coulomb_source_coeffs.inc
+///
+/// Evaluates the finite-size Coulomb integrals of coulomb.h with
+/// coulomb_source_integrals() at the Chebyshev nodes of every panel of x
+/// and every node of p, and writes the polynomial of each panel and node
+/// to standard output. The error of the result is then measured against
+/// coulomb_source_integrals() between the nodes, and written along.
+/// Takes a few seconds; `make coulomb-table` runs it.
+///
+/// Usage: coulomb-table > src/coulomb_source_coeffs.inc
+///
+
+#include "coulomb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+const int ORDER = COULOMB_SOURCE_DEGREE + 1;
+
+const char *const INTEGRAL_NAMES[COULOMB_SOURCE_INTEGRALS] = {
+  "T0", "Q", "Y_phiphi", "Y_2phi", "Y_22"
+};
+
+double
+p_node(int j)
+{
+  return COULOMB_SOURCE_P_MAX * std::cos(M_PI * (j + 0.5) / COULOMB_SOURCE_P_NODES);
+}
+
+/// Monomial coefficients in t of the polynomial through `values` at the
+/// Chebyshev nodes t_i = cos(pi (i + 1/2) / ORDER)
+void
+interpolate(const double *values, double *coeffs)
+{
+  // Chebyshev coefficients, then sum_k c_k T_k(t) with T_k expanded by
+  // T_k+1 = 2t T_k - T_k-1
+  double cheb[ORDER];
+  for (int k = 0; k < ORDER; ++k) {
+    double sum = 0.0;
+    for (int i = 0; i < ORDER; ++i) {
+      sum += values[i] * std::cos(M_PI * k * (i + 0.5) / ORDER);
+    }
+    cheb[k] = (k == 0 ? 1.0 : 2.0) * sum / ORDER;
+  }
+
+  double previous[ORDER] = {1.0}, current[ORDER] = {0.0, 1.0};
+  std::fill(coeffs, coeffs + ORDER, 0.0);
+  coeffs[0] = cheb[0];
+  for (int k = 1; k < ORDER; ++k) {
+    for (int n = 0; n < ORDER; ++n) {
+      coeffs[n] += cheb[k] * current[n];
+    }
+    double next[ORDER];
+    for (int n = 0; n < ORDER; ++n) {
+      next[n] = (n > 0 ? 2.0 * current[n - 1] : 0.0) - previous[n];
+    }
+    std::copy(current, current + ORDER, previous);
+    std::copy(next, next + ORDER, current);
+  }
+}
+
+} // anonymous namespace
+
+int
+main()
+{
+  static double coeffs[COULOMB_SOURCE_PANELS][COULOMB_SOURCE_P_NODES][COULOMB_SOURCE_STRIDE];
+  const double *panels = coulomb_source_panels(0.0);
+
+  for (int n = 0; n < COULOMB_SOURCE_PANELS; ++n) {
+    const double centre = panels[2 * n],
+                 half_width = 1.0 / panels[2 * n + 1];
+    for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+      double values[COULOMB_SOURCE_INTEGRALS][ORDER];
+      for (int i = 0; i < ORDER; ++i) {
+        double integrals[COULOMB_SOURCE_INTEGRALS];
+        coulomb_source_integrals(centre + half_width * std::cos(M_PI * (i + 0.5) / ORDER),
+                                 p_node(j), integrals);
+        for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+          values[f][i] = integrals[f];
+        }
+      }
+      for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+        interpolate(values[f], coeffs[n][j] + f * ORDER);
+      }
+    }
+    std::fprintf(stderr, "panel %d of %d\n", n + 1, COULOMB_SOURCE_PANELS);
+  }
+
+  // between the nodes in both directions: 4 points per panel, 9 values of p
+  const double samples[4] = {-0.91, -0.37, 0.29, 0.83};
+  double error = 0.0, error_x = 0.0, error_p = 0.0;
+  int error_integral = 0;
+  for (int n = 0; n < COULOMB_SOURCE_PANELS; ++n) {
+    for (double t : samples) {
+      const double x = panels[2 * n] + t / panels[2 * n + 1];
+      for (int s = 0; s < 9; ++s) {
+        const double p = COULOMB_SOURCE_P_MAX * (-0.97 + 1.94 * s / 8.0);
+        double weights[COULOMB_SOURCE_P_NODES], exact[COULOMB_SOURCE_INTEGRALS];
+        coulomb_source_weights(p, weights);
+        coulomb_source_integrals(x, p, exact);
+        for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+          double value = 0.0;
+          for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+            const double *c = coeffs[n][j] + f * ORDER;
+            double poly = 0.0;
+            for (int k = ORDER - 1; k >= 0; --k) {
+              poly = poly * t + c[k];
+            }
+            value += weights[j] * poly;
+          }
+          const double e = std::fabs(value - exact[f]) / exact[COULOMB_SOURCE_T0];
+          if (e > error) {
+            error = e;
+            error_x = x;
+            error_p = p;
+            error_integral = f;
+          }
+        }
+      }
+    }
+  }
+
+  std::printf("/* Finite-size Coulomb integrals of coulomb.h, [panel][p node][integral]\n"
+              "   [power of t], written by `make coulomb-table` (coulomb_table.cc); do\n"
+              "   not edit. Largest error against coulomb_source_integrals(), relative\n"
+              "   to T0: %.1e in %s at x = %.3g, p = %.3g. */\n",
+              error, INTEGRAL_NAMES[error_integral], error_x, error_p);
+  std::printf("static const double SOURCE_TABLE_ERROR = %.1e;\n\n", error);
+  std::printf("static const double SOURCE_COEFFS[COULOMB_SOURCE_PANELS][COULOMB_SOURCE_P_NODES]"
+              "[COULOMB_SOURCE_STRIDE] = {\n");
+  for (int n = 0; n < COULOMB_SOURCE_PANELS; ++n) {
+    std::printf("  { /* panel %d, centre %.17g */\n", n, panels[2 * n]);
+    for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+      std::printf("    { /* p = %.17g */\n", p_node(j));
+      for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+        const double *c = coeffs[n][j] + f * ORDER;
+        std::printf("      ");
+        for (int k = 0; k < ORDER; ++k) {
+          std::printf("%.17g,%s", c[k], (k == ORDER - 1) ? "\n" : (k % 4 == 3) ? "\n      " : " ");
+        }
+      }
+      std::printf("    },\n");
+    }
+    std::printf("  },\n");
+  }
+  std::printf("};\n");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,143 @@
+///
+/// \file curvecache.cxx
+/// \brief Implementation of LednickyCurveCache
+///
+
+#include "curvecache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+// NaN never compares equal, so a key holding one could neither be found
+// nor erased from the index on eviction
+LednickyCurveCache::Key::Key(const LednickyEquation_s& eq):
+  identical(eq.identical),
+  spline_basis(eq.spline_basis),
+  bins(eq.totalBins),
+  radius(eq.radius),
+  f0re(eq.f0re),
+  f0im(eq.f0im),
+  d0(eq.d0),
+  maxKstar(eq.maxKstar),
+  asymptotic_tolerance(eq.asymptotic_tolerance)
+{
+  for (double value : {radius, f0re, f0im, d0, maxKstar, asymptotic_tolerance}) {
+    if (!std::isfinite(value)) {
+      throw std::invalid_argument("LednickyCurveCache: curve parameters must be finite");
+    }
+  }
+}
+
+bool
+LednickyCurveCache::Key::operator==(const Key& other) const
+{
+  return identical == other.identical
+      && spline_basis == other.spline_basis
+      && bins == other.bins
+      && radius == other.radius
+      && f0re == other.f0re
+      && f0im == other.f0im
+      && d0 == other.d0
+      && maxKstar == other.maxKstar
+      && asymptotic_tolerance == other.asymptotic_tolerance;
+}
+
+std::size_t
+LednickyCurveCache::KeyHash::operator()(const Key& key) const
+{
+  const std::hash<double> hash;
+  std::size_t h = key.bins * 2 + key.identical;
+  h = h * 2 + key.spline_basis;
+  for (double value : {key.radius, key.f0re, key.f0im, key.d0, key.maxKstar, key.asymptotic_tolerance}) {
+    // the combination of boost::hash_combine
+    h ^= hash(value) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  }
+  return h;
+}
+
+std::size_t
+LednickyCurveCache::entry_bytes(std::size_t bins)
+{
+  // the curve, its list and index nodes and the shared pointer's control
+  // block, roughly
+  return bins * sizeof(double) + sizeof(Entry) + sizeof(std::vector<double>) + 96;
+}
+
+LednickyCurveCache::LednickyCurveCache(std::size_t max_bytes):
+  _max_bytes(max_bytes),
+  _statistics()
+{
+}
+
+LednickyCurveCache::curve_t
+LednickyCurveCache::evaluate(const LednickyEquation_s& eq)
+{
+  const Key key(eq);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    const auto found = _index.find(key);
+    if (found != _index.end()) {
+      _entries.splice(_entries.begin(), _entries, found->second);
+      ++_statistics.hits;
+      return found->second->curve;
+    }
+    ++_statistics.misses;
+  }
+
+  std::vector<double> kstar(eq.totalBins);
+  std::shared_ptr<std::vector<double>> cf = std::make_shared<std::vector<double>>(eq.totalBins);
+  generate_lednicky_equation(eq, kstar.data(), cf->data());
+
+  const std::size_t bytes = entry_bytes(eq.totalBins);
+  if (bytes > _max_bytes) {
+    return cf;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  const auto found = _index.find(key);
+  if (found != _index.end()) {
+    // another thread evaluated it meanwhile
+    _entries.splice(_entries.begin(), _entries, found->second);
+    return found->second->curve;
+  }
+
+  while (_statistics.bytes + bytes > _max_bytes) {
+    const Entry &oldest = _entries.back();
+    _statistics.bytes -= entry_bytes(oldest.curve->size());
+    _index.erase(oldest.key);
+    _entries.pop_back();
+    ++_statistics.evictions;
+  }
+
+  _entries.push_front(Entry{key, cf});
+  _index.emplace(key, _entries.begin());
+  _statistics.bytes += bytes;
+  return cf;
+}
+
+void
+LednickyCurveCache::evaluate(const LednickyEquation_s& eq, double *cf)
+{
+  const curve_t curve = evaluate(eq);
+  std::copy(curve->begin(), curve->end(), cf);
+}
+
+LednickyCurveCache::Statistics
+LednickyCurveCache::statistics() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  Statistics statistics = _statistics;
+  statistics.entries = _entries.size();
+  return statistics;
+}
+
+void
+LednickyCurveCache::clear()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _entries.clear();
+  _index.clear();
+  _statistics = Statistics();
+}
@@ -0,0 +1,109 @@
+///
+/// \file curvecache.h
+/// \brief Memoization of correlation functions by their parameters
+///
+
+#pragma once
+
+#include "lednicky.h"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * LednickyCurveCache
+ * \brief Keeps the most recently used curves of generate_lednicky_equation()
+ *        so that revisited parameter sets cost a lookup.
+ *
+ * Curves are keyed on everything that changes C on the bin centres:
+ * `identical`, `radius`, `f0re`, `f0im`, `d0`, `maxKstar`, `totalBins`,
+ * `asymptotic_tolerance` and `spline_basis`, compared exactly. Lambda and
+ * normalization are left to the caller, so a fit varying only those hits
+ * the cache.
+ *
+ * The cache holds at most `max_bytes` of curves and bookkeeping; the least
+ * recently used curves are dropped first, and a curve larger than the
+ * whole budget is returned without being kept. Curves are handed out as
+ * shared pointers and stay valid after eviction.
+ *
+ * All members are thread-safe. A miss is evaluated outside the lock, so
+ * threads missing different curves evaluate them concurrently; two threads
+ * missing the same curve both evaluate it and both count a miss.
+ */
+class LednickyCurveCache {
+public:
+  typedef std::shared_ptr<const std::vector<double>> curve_t;
+
+  /// Counters since construction or the last clear()
+  struct Statistics {
+    std::size_t hits;
+    std::size_t misses;
+    std::size_t evictions;
+
+    /// Curves held and the bytes they are charged for
+    std::size_t entries;
+    std::size_t bytes;
+  };
+
+  explicit LednickyCurveCache(std::size_t max_bytes = 64 << 20);
+
+  LednickyCurveCache(const LednickyCurveCache&) = delete;
+  LednickyCurveCache& operator=(const LednickyCurveCache&) = delete;
+
+  /// C of `eq` on its `eq.totalBins` bin centres, from the cache or
+  /// evaluated and added to it. Throws std::invalid_argument if a keyed
+  /// parameter is not finite.
+  curve_t evaluate(const LednickyEquation_s& eq);
+
+  /// Same, copied into `cf` (`eq.totalBins` values)
+  void evaluate(const LednickyEquation_s& eq, double *cf);
+
+  Statistics statistics() const;
+
+  std::size_t max_bytes() const { return _max_bytes; }
+
+  /// Drop every curve and reset the counters
+  void clear();
+
+private:
+  struct Key {
+    bool identical;
+    bool spline_basis;
+    int bins;
+    double radius;
+    double f0re;
+    double f0im;
+    double d0;
+    double maxKstar;
+    double asymptotic_tolerance;
+
+    explicit Key(const LednickyEquation_s& eq);
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  struct Entry {
+    Key key;
+    curve_t curve;
+  };
+
+  /// Bytes charged for a curve of `bins` values
+  static std::size_t entry_bytes(std::size_t bins);
+
+  std::size_t _max_bytes;
+
+  mutable std::mutex _mutex;
+
+  /// most recently used first
+  std::list<Entry> _entries;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> _index;
+
+  Statistics _statistics;
+};
@@ -0,0 +1,289 @@
+///
+/// \file curvefile.cxx
+/// \brief Implementation of CurveFileWriter and CurveFile
+///
+
+#include "curvefile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char CURVE_FILE_MAGIC[8] = {'L', 'E', 'D', 'C', 'U', 'R', 'V', 'E'};
+static const std::uint16_t CURVE_FILE_VERSION = 1;
+static const std::uint32_t CURVE_FILE_BYTE_ORDER = 0x01020304;
+
+/// Alignment of every block in the file
+static const std::uint64_t CURVE_FILE_ALIGN = 64;
+
+static std::uint64_t
+align_up(std::uint64_t offset)
+{
+  return (offset + CURVE_FILE_ALIGN - 1) / CURVE_FILE_ALIGN * CURVE_FILE_ALIGN;
+}
+
+/// True when `rows` x `columns` values of `value_size` bytes starting at
+/// `offset` end within `size` bytes; the product is never formed, so
+/// corrupt counts cannot overflow into a small size
+static bool
+block_fits(std::uint64_t offset, std::uint64_t rows, std::uint64_t columns,
+           std::uint64_t value_size, std::uint64_t size)
+{
+  if (offset > size) {
+    return false;
+  }
+  if (rows == 0 || columns == 0) {
+    return true;
+  }
+  return columns <= (size - offset) / value_size / rows;
+}
+
+CurveFileWriter::CurveFileWriter(const std::string& path,
+                                 const double *kstar,
+                                 std::size_t bins,
+                                 std::size_t value_size):
+  _out(path.c_str(), std::ios::binary | std::ios::trunc),
+  _path(path),
+  _bins(bins),
+  _value_size(value_size),
+  _curves(0),
+  _cf_offset(0),
+  _finished(false),
+  _asymptotic_tolerance(LEDNICKY_ASYMPTOTIC_TOLERANCE),
+  _spline_basis(false)
+{
+  if (value_size != sizeof(float) && value_size != sizeof(double)) {
+    throw std::invalid_argument("curve values must be 4 or 8 bytes");
+  }
+  if (!_out) {
+    throw std::runtime_error("unable to create curve file '" + path + "'");
+  }
+
+  // placeholder, rewritten by finish()
+  const CurveFileHeader header = CurveFileHeader();
+  write(&header, sizeof(header));
+  pad();
+
+  write(kstar, bins * sizeof(double));
+  pad();
+
+  _cf_offset = _out.tellp();
+}
+
+CurveFileWriter::~CurveFileWriter()
+{
+  if (!_finished) {
+    try {
+      finish();
+    } catch (const std::exception&) {
+    }
+  }
+}
+
+void
+CurveFileWriter::write(const void *data, std::size_t size)
+{
+  _out.write(static_cast<const char*>(data), size);
+  if (!_out) {
+    throw std::runtime_error("error writing curve file '" + _path + "'");
+  }
+}
+
+void
+CurveFileWriter::pad()
+{
+  static const char zeros[CURVE_FILE_ALIGN] = {};
+  const std::uint64_t offset = _out.tellp();
+  write(zeros, align_up(offset) - offset);
+}
+
+void
+CurveFileWriter::append(const LednickyEquation_s& eq, const double *cf)
+{
+  if (_curves == 0) {
+    _asymptotic_tolerance = eq.asymptotic_tolerance;
+    _spline_basis = eq.spline_basis;
+  } else if (eq.asymptotic_tolerance != _asymptotic_tolerance || eq.spline_basis != _spline_basis) {
+    throw std::invalid_argument("curves of one file must share asymptotic_tolerance and spline_basis");
+  }
+
+  if (_value_size == sizeof(double)) {
+    write(cf, _bins * sizeof(double));
+  } else {
+    _values.assign(cf, cf + _bins);
+    write(_values.data(), _bins * sizeof(float));
+  }
+
+  _params[CURVE_RADIUS].push_back(eq.radius);
+  _params[CURVE_F0RE].push_back(eq.f0re);
+  _params[CURVE_F0IM].push_back(eq.f0im);
+  _params[CURVE_D0].push_back(eq.d0);
+  _params[CURVE_LAMBDA].push_back(eq.lamPrimary);
+  _params[CURVE_NORMALIZATION].push_back(eq.normalization);
+  _params[CURVE_IDENTICAL].push_back(eq.identical ? 1.0 : 0.0);
+  ++_curves;
+}
+
+void
+CurveFileWriter::finish()
+{
+  _finished = true;
+
+  pad();
+  const std::uint64_t params_offset = _out.tellp();
+  for (const auto& column : _params) {
+    write(column.data(), column.size() * sizeof(double));
+  }
+  pad();
+
+  CurveFileHeader header = CurveFileHeader();
+  std::memcpy(header.magic, CURVE_FILE_MAGIC, sizeof(header.magic));
+  header.version = CURVE_FILE_VERSION;
+  header.value_size = _value_size;
+  header.byte_order = CURVE_FILE_BYTE_ORDER;
+  header.bins = _bins;
+  header.curves = _curves;
+  header.parameters = CURVE_PARAMETER_COUNT;
+  header.kstar_offset = align_up(sizeof(CurveFileHeader));
+  header.cf_offset = _cf_offset;
+  header.params_offset = params_offset;
+  header.file_size = _out.tellp();
+  header.asymptotic_tolerance = _asymptotic_tolerance;
+  header.spline_basis = _spline_basis ? 1 : 0;
+
+  _out.seekp(0);
+  write(&header, sizeof(header));
+  _out.close();
+  if (!_out) {
+    throw std::runtime_error("error closing curve file '" + _path + "'");
+  }
+}
+
+CurveFile::CurveFile(const std::string& path):
+  _data(nullptr),
+  _size(0),
+  _header(nullptr)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("unable to open curve file '" + path + "'");
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(CurveFileHeader))) {
+    ::close(fd);
+    throw std::runtime_error("'" + path + "' is too small to be a curve file");
+  }
+
+  _size = st.st_size;
+  void *map = ::mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    throw std::runtime_error("unable to map curve file '" + path + "'");
+  }
+  _data = static_cast<const char*>(map);
+  _header = reinterpret_cast<const CurveFileHeader*>(_data);
+
+  const CurveFileHeader &h = *_header;
+  const char *error = nullptr;
+  if (std::memcmp(h.magic, CURVE_FILE_MAGIC, sizeof(h.magic)) != 0) {
+    error = "is not a curve file";
+  } else if (h.byte_order != CURVE_FILE_BYTE_ORDER) {
+    error = "was written with a different byte order";
+  } else if (h.version != CURVE_FILE_VERSION) {
+    error = "has an unsupported version";
+  } else if (h.value_size != sizeof(float) && h.value_size != sizeof(double)) {
+    error = "has an invalid value size";
+  } else if (h.parameters < CURVE_PARAMETER_COUNT) {
+    error = "has too few parameter columns";
+  } else if (!(h.asymptotic_tolerance >= 0.0) || h.spline_basis > 1) {
+    error = "has invalid evaluation settings";
+  } else if (h.kstar_offset % CURVE_FILE_ALIGN != 0
+             || h.cf_offset % CURVE_FILE_ALIGN != 0
+             || h.params_offset % CURVE_FILE_ALIGN != 0) {
+    error = "has misaligned blocks";
+  } else if (h.file_size != _size
+             || !block_fits(h.kstar_offset, 1, h.bins, sizeof(double), _size)
+             || !block_fits(h.cf_offset, h.curves, h.bins, h.value_size, _size)
+             || !block_fits(h.params_offset, h.parameters, h.curves, sizeof(double), _size)) {
+    error = "is truncated";
+  }
+
+  if (error != nullptr) {
+    ::munmap(const_cast<char*>(_data), _size);
+    throw std::runtime_error("'" + path + "' " + error);
+  }
+}
+
+CurveFile::~CurveFile()
+{
+  ::munmap(const_cast<char*>(_data), _size);
+}
+
+void
+CurveFile::kernel_settings(LednickyEquation_s& eq) const
+{
+  eq.asymptotic_tolerance = _header->asymptotic_tolerance;
+  eq.spline_basis = _header->spline_basis != 0;
+}
+
+const double*
+CurveFile::kstar() const
+{
+  return reinterpret_cast<const double*>(_data + _header->kstar_offset);
+}
+
+const double*
+CurveFile::parameter(CurveParameter p) const
+{
+  return reinterpret_cast<const double*>(_data + _header->params_offset) + p * _header->curves;
+}
+
+const float*
+CurveFile::curve_float(std::size_t index) const
+{
+  if (_header->value_size != sizeof(float)) {
+    return nullptr;
+  }
+  return reinterpret_cast<const float*>(_data + _header->cf_offset) + index * _header->bins;
+}
+
+const double*
+CurveFile::curve_double(std::size_t index) const
+{
+  if (_header->value_size != sizeof(double)) {
+    return nullptr;
+  }
+  return reinterpret_cast<const double*>(_data + _header->cf_offset) + index * _header->bins;
+}
+
+void
+CurveFile::curve(std::size_t index, double *out) const
+{
+  if (const double *values = curve_double(index)) {
+    std::copy(values, values + bins(), out);
+  } else {
+    const float *fvalues = curve_float(index);
+    std::copy(fvalues, fvalues + bins(), out);
+  }
+}
+
+LednickyEquation_s
+CurveFile::point(std::size_t index) const
+{
+  LednickyEquation_s eq;
+  eq.totalBins = bins();
+  eq.radius = parameter(CURVE_RADIUS)[index];
+  eq.f0re = parameter(CURVE_F0RE)[index];
+  eq.f0im = parameter(CURVE_F0IM)[index];
+  eq.d0 = parameter(CURVE_D0)[index];
+  eq.lamPrimary = parameter(CURVE_LAMBDA)[index];
+  eq.normalization = parameter(CURVE_NORMALIZATION)[index];
+  eq.identical = parameter(CURVE_IDENTICAL)[index] != 0.0;
+  return eq;
+}
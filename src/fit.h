@@ -0,0 +1,225 @@
+///
+/// \file fit.h
+/// \brief Chi^2 fits of the Lednicky model to a measured correlation function
+///
+
+#pragma once
+
+#include "lednicky.h"
+#include "smearing.h"
+
+#include <cstddef>
+#include <istream>
+#include <string>
+#include <vector>
+
+/// Free parameters of the fit model, in the order of gradients and
+/// covariance matrices
+enum FitParameter {
+  FIT_RADIUS,
+  FIT_F0RE,
+  FIT_F0IM,
+  FIT_D0,
+  FIT_LAMBDA,
+  FIT_NORMALIZATION,
+  FIT_PARAMETER_COUNT
+};
+
+/// Name of `p` as used on the command line ("radius", ..., "normalization")
+const char* fit_parameter_name(FitParameter p);
+
+/// The FitParameter called `name` (batch names such as "lamPrimary" are
+/// accepted too). Returns false if there is no such parameter.
+bool parse_fit_parameter(const std::string& name, FitParameter& p);
+
+double get_fit_parameter(const LednickyEquation_s& eq, FitParameter p);
+
+/// Set parameter `p` of `eq`
+void set_fit_parameter(LednickyEquation_s& eq, FitParameter p, double value);
+
+/// A measured correlation function with its uncertainties
+struct FitData {
+  std::vector<double> kstar;
+  std::vector<double> cf;
+  std::vector<double> error;
+
+  std::size_t size() const { return kstar.size(); }
+};
+
+/// Read "kstar cf error" lines, separated by whitespace or commas. Blank
+/// lines, lines starting with '#' and a leading header line are skipped.
+/// Throws std::invalid_argument, naming the line, on malformed input or
+/// non-positive errors.
+FitData read_fit_data(std::istream& in);
+
+/**
+ * LednickyChi2
+ * \brief chi^2 of the Lednicky model against a FitData, with analytic
+ *        derivatives in every FitParameter.
+ *
+ * The model is the curve as drawn by the frontend,
+ *
+ *   M(k*) = (1 + (C(k*) - 1) * lamPrimary) / normalization,
+ *
+ * and chi^2 = sum_i ((cf_i - M(k*_i)) / error_i)^2. The derivatives are
+ * exact: F1 = Dawson(z)/z is differentiated through D'(x) = 1 - 2x D(x),
+ * and one pass of LednickyBasis::evaluate_jacobian() yields the curve
+ * and its Jacobian together, instead of the 2N+1 curves of central finite
+ * differences. The radius-only terms stay cached between evaluations at
+ * the same radius.
+ *
+ * With a momentum response (set_response()) the curve and its Jacobian
+ * are evaluated on the true k* axis of the response and smeared onto the
+ * data points at every evaluation; the smearing is linear and keeps flat
+ * curves flat, so lambda and normalization apply unchanged afterwards.
+ *
+ * Usable as the objective of an external minimizer; LednickyFitter
+ * minimizes it directly. Not thread-safe.
+ */
+class LednickyChi2 {
+public:
+  explicit LednickyChi2(const FitData& data);
+
+  /// chi^2 of `eq`; when `gradient` is given it receives d chi^2 / d p for
+  /// every FitParameter
+  double operator()(const LednickyEquation_s& eq, double *gradient = nullptr);
+
+  /// chi^2 of `eq` with the weighted residuals (cf_i - M_i) / error_i and
+  /// the weighted model derivatives, row i holding d M_i / d p / error_i
+  /// for every FitParameter (size() * FIT_PARAMETER_COUNT values)
+  double residuals(const LednickyEquation_s& eq, double *residual, double *jacobian);
+
+  /**
+   * Variable projection: the model is linear in 1/normalization and
+   * lamPrimary/normalization, so for the radius, f0 and d0 of `eq` both are
+   * solved by weighted linear least squares and stored in `eq`, keeping
+   * lambda_min <= lamPrimary <= lambda_max and normalization > 0. Returns
+   * the minimal chi^2 over the two.
+   *
+   * `residual` and `jacobian` are filled as by residuals(). The radius,
+   * f0re, f0im and d0 columns are projected off the span of the linear
+   * parameters (Kaufman's approximation), so J^T r is the exact gradient of
+   * the projected chi^2 and J^T J its Gauss-Newton matrix; the lambda and
+   * normalization columns are zero.
+   */
+  double project(LednickyEquation_s& eq, double *residual, double *jacobian,
+                 double lambda_min = 0.0, double lambda_max = 1.0);
+
+  /// Fold the model with `response`, whose reconstructed bins are the data
+  /// points in order. Throws std::invalid_argument if their number differs.
+  void set_response(const MomentumResponse& response);
+
+  /// Whether the model is folded with a momentum response
+  bool smeared() const { return _smeared; }
+
+  const FitData& data() const { return _data; }
+  std::size_t size() const { return _data.size(); }
+
+private:
+  /// Fill _cf, and _dcf if `derivatives`, on the data points
+  void evaluate_curve(const LednickyEquation_s& eq, bool derivatives);
+
+  FitData _data;
+  LednickyBasis _basis;
+
+  MomentumResponse _response;
+  bool _smeared;
+
+  /// curve and Jacobian on the true k* axis, before smearing
+  std::vector<double> _true_cf;
+  std::vector<double> _true_dcf;
+
+  /// unscaled curve and its Jacobian, see evaluate_lednicky_jacobian()
+  std::vector<double> _cf;
+  std::vector<double> _dcf;
+
+  /// weighted model columns the Jacobian is projected off, see project()
+  std::vector<double> _linear;
+
+  /// scratch of operator()
+  std::vector<double> _residual;
+  std::vector<double> _jacobian;
+};
+
+/// Outcome of LednickyFitter::fit()
+struct FitResult {
+  /// Best fit parameters; fixed ones keep their starting values
+  LednickyEquation_s eq;
+
+  double chi2 {0.0};
+
+  /// Data points minus free parameters
+  long ndf {0};
+
+  /// Parabolic uncertainties, zero for fixed parameters
+  double error[FIT_PARAMETER_COUNT] {};
+
+  /// Covariance of the free parameters, zero rows for fixed ones
+  double covariance[FIT_PARAMETER_COUNT][FIT_PARAMETER_COUNT] {};
+
+  unsigned iterations {0};
+
+  /// Number of model evaluations, each with or without derivatives
+  unsigned evaluations {0};
+
+  bool converged {false};
+};
+
+/**
+ * LednickyFitter
+ * \brief Levenberg-Marquardt minimization of LednickyChi2.
+ *
+ * Every iteration takes one evaluation with derivatives; the normal
+ * equations are damped by mu * diag(J^T J) and mu adapts to how well the
+ * linearized model predicted the change of chi^2 (Nielsen's rule).
+ * Parameters are kept inside their limits by clamping each step; those on
+ * a limit that the gradient pushes against are held there for the
+ * iteration. The defaults free every parameter within its physical range:
+ * radius > 0, d0 >= 0, f0im >= 0, 0 <= lambda <= 1 and normalization > 0.
+ *
+ * With variable projection the minimizer only searches radius, f0 and d0;
+ * lambda and normalization are solved in closed form at every trial point
+ * (LednickyChi2::project()). Their fix flags and starting values are then
+ * ignored, and the reported covariance is that of all six parameters at
+ * the minimum. Should lambda end outside its limits, the better of two full
+ * fits, from that point and from the start, is returned instead.
+ */
+class LednickyFitter {
+public:
+  explicit LednickyFitter(const FitData& data);
+
+  /// Keep `p` at its starting value
+  void fix(FitParameter p, bool fixed = true) { _fixed[p] = fixed; }
+  bool fixed(FitParameter p) const { return _fixed[p]; }
+
+  void set_limits(FitParameter p, double lower, double upper);
+
+  /// Stop once an accepted step lowers chi^2 by less than `tolerance`
+  /// relative to it or moves the parameters by less than `tolerance`
+  /// relative to their norm, or once the cosine between the residuals and
+  /// every column of J not held on a limit is below `tolerance` (default
+  /// 1e-8)
+  void set_tolerance(double tolerance) { _tolerance = tolerance; }
+  void set_max_iterations(unsigned iterations) { _max_iterations = iterations; }
+
+  /// Solve lambda and normalization in closed form at every step
+  void set_variable_projection(bool enabled) { _variable_projection = enabled; }
+
+  /// Fit from the parameters of `start`; the k* axis comes from the data
+  FitResult fit(const LednickyEquation_s& start);
+
+  LednickyChi2& chi2() { return _chi2; }
+
+private:
+  /// Levenberg-Marquardt from `start`, over radius, f0 and d0 only when
+  /// `projected`
+  FitResult minimize(const LednickyEquation_s& start, bool projected);
+
+  LednickyChi2 _chi2;
+  bool _fixed[FIT_PARAMETER_COUNT];
+  double _lower[FIT_PARAMETER_COUNT];
+  double _upper[FIT_PARAMETER_COUNT];
+  double _tolerance;
+  unsigned _max_iterations;
+  bool _variable_projection;
+};
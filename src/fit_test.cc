@@ -0,0 +1,237 @@
+///
+/// \file fit_test.cc
+/// \brief lednicky-test: regression test of LednickyFitter
+///
+/// Fits curves generated from known parameters, with and without variable
+/// projection, and checks that every fit converges and recovers them. Also
+/// checks the charged-pair curve against its neutral limit and against the
+/// finite-size Coulomb integrals by quadrature. Exits non-zero and names
+/// the failing check otherwise.
+///
+/// Usage: lednicky-test
+///
+
+#include "fit.h"
+#include "lednicky.h"
+#include "coulomb.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+/// `bins` points up to k* = 0.4 GeV/c of the scaled model of `truth`,
+/// with Gaussian noise of standard deviation `error`
+FitData
+generate_data(const LednickyEquation_s& truth, std::size_t bins, double error, std::mt19937& rng)
+{
+  FitData data;
+  for (std::size_t i = 0; i < bins; ++i) {
+    data.kstar.push_back((i + 0.5) * 0.4 / bins);
+  }
+
+  std::vector<double> cf(bins);
+  evaluate_lednicky_equation(truth, data.kstar.data(), cf.data(), bins);
+
+  std::normal_distribution<double> noise(0.0, error);
+  for (std::size_t i = 0; i < bins; ++i) {
+    const double model = (1.0 + (cf[i] - 1.0) * truth.lamPrimary) / truth.normalization;
+    data.cf.push_back(model + (error > 0.0 ? noise(rng) : 0.0));
+    data.error.push_back(error > 0.0 ? error : 1e-3);
+  }
+  return data;
+}
+
+LednickyEquation_s
+make_equation(double radius, double f0re, double f0im, double d0, double lambda, double normalization)
+{
+  LednickyEquation_s eq;
+  set_fit_parameter(eq, FIT_RADIUS, radius);
+  set_fit_parameter(eq, FIT_F0RE, f0re);
+  set_fit_parameter(eq, FIT_F0IM, f0im);
+  set_fit_parameter(eq, FIT_D0, d0);
+  set_fit_parameter(eq, FIT_LAMBDA, lambda);
+  set_fit_parameter(eq, FIT_NORMALIZATION, normalization);
+  return eq;
+}
+
+/// Fit `data` from `start` and compare with `truth`; parameters must agree
+/// to `tolerance` absolute. Returns false after reporting on failure.
+bool
+check_fit(const char *name, const FitData& data, const LednickyEquation_s& start,
+          const LednickyEquation_s& truth, bool varpro, double tolerance)
+{
+  LednickyFitter fitter(data);
+  fitter.set_variable_projection(varpro);
+  const FitResult result = fitter.fit(start);
+
+  bool ok = result.converged;
+  for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+    const FitParameter param = static_cast<FitParameter>(p);
+    ok = ok && std::fabs(get_fit_parameter(result.eq, param) - get_fit_parameter(truth, param)) <= tolerance;
+  }
+
+  std::printf("%-4s %-28s %-6s chi2 %10.4g, %3u evaluations%s\n", ok ? "ok" : "FAIL", name,
+              varpro ? "varpro" : "full", result.chi2, result.evaluations,
+              result.converged ? "" : ", not converged");
+  if (!ok) {
+    for (int p = 0; p < FIT_PARAMETER_COUNT; ++p) {
+      const FitParameter param = static_cast<FitParameter>(p);
+      std::printf("       %-14s %12.6g, expected %12.6g\n", fit_parameter_name(param),
+                  get_fit_parameter(result.eq, param), get_fit_parameter(truth, param));
+    }
+  }
+  return ok;
+}
+
+/// evaluate_lednicky_coulomb() at one k* (GeV/c), from
+/// coulomb_source_integrals() instead of the table
+double
+coulomb_reference(const LednickyEquation_s& eq, double bohr_radius, double kstar)
+{
+  const double k = kstar / 0.19732697, radius = eq.radius,
+               x = k * radius, p = radius / bohr_radius, eta = 1.0 / (k * bohr_radius),
+               gamow = gamow_factor(eta), h = coulomb_h(eta);
+  double s[COULOMB_SOURCE_INTEGRALS];
+  coulomb_source_integrals(x, p, s);
+
+  const std::complex<double> f0(eq.f0re, eq.f0im),
+                             f = 1.0 / (1.0 / f0 + 0.5 * eq.d0 * k * k - 2.0 * h / bohr_radius
+                                        - std::complex<double>(0.0, k * gamow));
+  const double beta = 2.0 * p * (std::log(2.0 * std::fabs(p)) + 2.0 * 0.57721566490153286 - 1.0 + h);
+  const std::complex<double> g = radius + std::complex<double>(beta, x * gamow) * f;
+  const double swave = (std::norm(f) * s[COULOMB_SOURCE_Y2_Y2]
+                        + 2.0 * std::real(g * std::conj(f)) * s[COULOMB_SOURCE_Y2_PHI]
+                        + std::norm(g) * s[COULOMB_SOURCE_PHI_PHI]) / (radius * radius)
+                     - s[COULOMB_SOURCE_PHI_PHI]
+                     - std::norm(f) * eq.d0 / (4.0 * std::sqrt(M_PI) * radius * radius * radius);
+  return eq.identical ? gamow * (s[COULOMB_SOURCE_T0] + 0.5 * (swave - s[COULOMB_SOURCE_Q]))
+                      : gamow * (s[COULOMB_SOURCE_T0] + swave);
+}
+
+/// Largest |a - b| / |b| over `count` values
+double
+relative_error(const double *a, const double *b, std::size_t count)
+{
+  double error = 0.0;
+  for (std::size_t i = 0; i < count; ++i) {
+    error = std::max(error, std::fabs(a[i] - b[i]) / std::fabs(b[i]));
+  }
+  return error;
+}
+
+} // anonymous namespace
+
+int
+main()
+{
+  std::mt19937 rng(2718);
+  const LednickyEquation_s start = make_equation(2.5, 0.3, 0.1, 0.5, 0.4, 1.0);
+
+  struct TestCase {
+    const char *name;
+    LednickyEquation_s truth;
+  };
+  const TestCase cases[] = {
+    {"complex f0, effective range", make_equation(3.0, 0.5, 0.2, 1.0, 0.5, 1.02)},
+    {"real f0, no effective range", make_equation(1.8, -0.4, 0.0, 0.0, 0.6, 0.98)},
+    {"large radius", make_equation(4.5, 0.8, 0.3, 2.0, 0.3, 1.0)},
+  };
+
+  int failures = 0;
+  for (const TestCase& test : cases) {
+    // exact data must be fitted exactly, f0im and d0 also on their limits
+    const FitData exact = generate_data(test.truth, 80, 0.0, rng);
+    for (bool varpro : {false, true}) {
+      failures += !check_fit(test.name, exact, start, test.truth, varpro, 1e-4);
+    }
+  }
+
+  // noisy data converges to the same minimum either way
+  const LednickyEquation_s truth = cases[0].truth;
+  const FitData noisy = generate_data(truth, 80, 1e-4, rng);
+  LednickyFitter full(noisy), projected(noisy);
+  projected.set_variable_projection(true);
+  const FitResult a = full.fit(start),
+                  b = projected.fit(start);
+  const bool same = a.converged && b.converged && std::fabs(a.chi2 - b.chi2) <= 1e-6 * a.chi2
+                 && std::fabs(a.eq.radius - truth.radius) <= 5.0 * a.error[FIT_RADIUS];
+  std::printf("%-4s %-28s chi2 %.6g and %.6g, radius %.4f +- %.4f\n", same ? "ok" : "FAIL",
+              "noisy, full and varpro", a.chi2, b.chi2, a.eq.radius, a.error[FIT_RADIUS]);
+  failures += !same;
+
+  // f0 = 0 without quantum statistics gives C = 1, where the projection
+  // can only fit the normalization
+  LednickyEquation_s flat = make_equation(3.0, 0.0, 0.0, 0.0, 0.3, 0.97);
+  LednickyFitter normalization_only(generate_data(flat, 40, 1e-3, rng));
+  normalization_only.set_variable_projection(true);
+  for (FitParameter p : {FIT_RADIUS, FIT_F0RE, FIT_F0IM, FIT_D0}) {
+    normalization_only.fix(p);
+  }
+  const FitResult c = normalization_only.fit(flat);
+  const bool finite = c.converged && std::isfinite(c.chi2) && std::isfinite(c.eq.lamPrimary)
+                   && std::fabs(c.eq.normalization - flat.normalization) <= 1e-3;
+  std::printf("%-4s %-28s chi2 %.6g, normalization %.6f\n", finite ? "ok" : "FAIL",
+              "C = 1, varpro", c.chi2, c.eq.normalization);
+  failures += !finite;
+
+  // charged pairs: pp and an attractive pair on both sides of the table
+  // edge, k* R = 64, in double and float
+  std::vector<double> kstar;
+  for (double k = 0.002; k < 6.0; k *= 1.15) {
+    kstar.push_back(k);
+  }
+  const std::size_t count = kstar.size();
+  const std::vector<float> kstar_float(kstar.begin(), kstar.end());
+  std::vector<double> coulomb(count), strong(count), reference(count);
+  std::vector<float> coulomb_float(count);
+
+  struct ChargedPair {
+    LednickyEquation_s eq;
+    double bohr_radius;
+  };
+  ChargedPair pairs[] = {
+    {make_equation(1.2, 7.77, 0.0, 2.77, 1.0, 1.0), 57.64},
+    {make_equation(3.0, -0.5, 0.3, 1.0, 1.0, 1.0), -49.3},
+  };
+  pairs[0].eq.identical = true;
+
+  double quadrature_error = 0.0, float_error = 0.0;
+  for (const ChargedPair& pair : pairs) {
+    const LednickyEquation_s& eq = pair.eq;
+    const double bohr_radius = pair.bohr_radius;
+    evaluate_lednicky_coulomb(eq, bohr_radius, kstar.data(), coulomb.data(), count);
+    evaluate_lednicky_coulomb(eq, bohr_radius, kstar_float.data(), coulomb_float.data(), count);
+    for (std::size_t i = 0; i < count; ++i) {
+      reference[i] = coulomb_reference(eq, bohr_radius, kstar[i]);
+      float_error = std::max(float_error, std::fabs(coulomb_float[i] - coulomb[i]) / coulomb[i]);
+    }
+    quadrature_error = std::max(quadrature_error, relative_error(coulomb.data(), reference.data(), count));
+  }
+  const bool quadrature = quadrature_error <= 1e-7 && float_error <= 1e-5;
+  std::printf("%-4s %-28s %.2g, float %.2g\n", quadrature ? "ok" : "FAIL",
+              "Coulomb, against quadrature", quadrature_error, float_error);
+  failures += !quadrature;
+
+  // a_c -> infinity leaves the strong curve
+  double neutral_error = 0.0;
+  for (const ChargedPair& pair : pairs) {
+    evaluate_lednicky_coulomb(pair.eq, 1e12, kstar.data(), coulomb.data(), count);
+    evaluate_lednicky_equation(pair.eq, kstar.data(), strong.data(), count);
+    neutral_error = std::max(neutral_error, relative_error(coulomb.data(), strong.data(), count));
+  }
+  const bool neutral = neutral_error <= 1e-7;
+  std::printf("%-4s %-28s %.2g\n", neutral ? "ok" : "FAIL", "Coulomb, neutral limit", neutral_error);
+  failures += !neutral;
+
+  if (failures != 0) {
+    std::printf("%d of %d checks failed\n", failures, 2 * static_cast<int>(sizeof(cases) / sizeof(cases[0])) + 4);
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
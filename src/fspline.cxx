@@ -0,0 +1,107 @@
+///
+/// \file fspline.cxx
+/// \brief Construction of the interpolation table of F1 and F2
+///
+
+#include "fspline.h"
+#include "faddeeva.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// F1 and F2/z at z, each followed by its derivative
+void
+f_spline_values(double z, double *f)
+{
+  if (z == 0.0) {
+    f[0] = 1.0;
+    f[1] = 0.0;
+    f[2] = 1.0;
+    f[3] = 0.0;
+    return;
+  }
+
+  // F1' = (1 - (1 + 2z^2) F1)/z from D' = 1 - 2zD
+  const double f1 = Faddeeva::Dawson(z) / z,
+               gauss = std::exp(-z * z),
+               g2 = -std::expm1(-z * z) / (z * z);
+  f[0] = f1;
+  f[1] = (1.0 - (1.0 + 2.0 * z * z) * f1) / z;
+  f[2] = g2;
+  f[3] = 2.0 * (gauss - g2) / z;
+}
+
+struct FSplineTable {
+  // one cache line per interval
+  alignas(64) double coeffs[F_SPLINE_INTERVALS][F_SPLINE_STRIDE];
+  float coeffs_float[F_SPLINE_INTERVALS][F_SPLINE_STRIDE];
+  double error;
+
+  FSplineTable();
+};
+
+FSplineTable::FSplineTable():
+  error(0.0)
+{
+  const double step = F_SPLINE_Z_MAX / F_SPLINE_INTERVALS;
+
+  double lower[4], upper[4], exact[4];
+  f_spline_values(0.0, lower);
+
+  for (int j = 0; j < F_SPLINE_INTERVALS; ++j) {
+    f_spline_values((j + 1) * step, upper);
+
+    for (int f = 0; f < 2; ++f) {
+      // cubic Hermite interpolant in u = z / step - j
+      const double y0 = lower[2 * f], d0 = lower[2 * f + 1],
+                   y1 = upper[2 * f], d1 = upper[2 * f + 1];
+      double *c = coeffs[j] + 4 * f;
+      c[0] = y0;
+      c[1] = step * d0;
+      c[2] = 3.0 * (y1 - y0) - step * (2.0 * d0 + d1);
+      c[3] = 2.0 * (y0 - y1) + step * (d0 + d1);
+    }
+    std::copy(coeffs[j], coeffs[j] + F_SPLINE_STRIDE, coeffs_float[j]);
+
+    for (int s = 1; s < 16; ++s) {
+      const double u = s / 16.0;
+      f_spline_values((j + u) * step, exact);
+      for (int f = 0; f < 2; ++f) {
+        const double *c = coeffs[j] + 4 * f,
+                     value = c[0] + u * (c[1] + u * (c[2] + u * c[3]));
+        error = std::max(error, std::fabs(value / exact[2 * f] - 1.0));
+      }
+    }
+
+    std::copy(upper, upper + 4, lower);
+  }
+}
+
+const FSplineTable&
+f_spline_table()
+{
+  static const FSplineTable table;
+  return table;
+}
+
+} // anonymous namespace
+
+const double*
+f_spline_coeffs(double)
+{
+  return f_spline_table().coeffs[0];
+}
+
+const float*
+f_spline_coeffs(float)
+{
+  return f_spline_table().coeffs_float[0];
+}
+
+double
+f_spline_error()
+{
+  return f_spline_table().error;
+}
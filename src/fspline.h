@@ -0,0 +1,47 @@
+///
+/// \file fspline.h
+/// \brief Precomputed interpolation table of the radius functions of the
+///        Lednicky model
+///
+/// The correlation function depends on R only through F1(z) = D(z)/z,
+/// with D the Dawson function, F2(z) = (1 - exp(-z^2))/z and exp(-z^2),
+/// at z = 2k*R/(hbar c). With LednickyEquation::spline_basis set, the
+/// batch kernels interpolate F1 and F2 from the table below, and take
+/// exp(-z^2) = 1 - z F2, instead of evaluating the Dawson function and an
+/// exponential (see basis_lanes() in lednicky_kernel.h).
+///
+
+#pragma once
+
+/*
+ * F1 and F2/z, both even in z, are tabulated for 0 <= z < F_SPLINE_Z_MAX
+ * on F_SPLINE_INTERVALS intervals of equal width. Each interval holds the
+ * cubic Hermite interpolant of the two functions and their derivatives at
+ * its ends, as four polynomial coefficients in the position u in [0, 1)
+ * within the interval, lowest order first: F1, then F2/z, one cache line
+ * of F_SPLINE_STRIDE values per interval. Dividing F2 by z keeps its
+ * relative error bounded down to z = 0, and makes the absolute error of
+ * 1 - z F2 no larger. Past the table the asymptotic forms of the kernels
+ * take over from z of about 5.2.
+ */
+const double F_SPLINE_Z_MAX = 6.0;
+const int F_SPLINE_INTERVALS = 768;
+const int F_SPLINE_STRIDE = 8;
+
+/// Largest relative error in F1 and F2 of the table, and absolute error in
+/// exp(-z^2), that the kernels allow for when choosing their asymptotic
+/// forms
+const double F_SPLINE_TOLERANCE = 1e-10;
+
+/// Interpolation coefficients, F_SPLINE_STRIDE per interval. Built on
+/// first use; see f_spline_error().
+const double* f_spline_coeffs(double);
+
+/// The same table rounded to float, for the single precision kernels
+const float* f_spline_coeffs(float);
+
+/// Largest relative error of the double table in F1 and F2 against
+/// Faddeeva::Dawson() and std::expm1(), sampled at 16 points per interval
+/// when the table is built: 7.7e-11, in F1 around z = 1.2, and 4.0e-11 in
+/// F2. That of F2 bounds the absolute error of exp(-z^2).
+double f_spline_error();
@@ -0,0 +1,58 @@
+///
+/// \file kernels_avx2.cxx
+/// \brief AVX2/FMA instantiation of the batch kernels
+///
+/// Compiled with -mavx2 -mfma; only called after simd::detect() has
+/// confirmed the running CPU supports these instructions.
+///
+
+// GCC 12 warns about the deliberately undefined passthrough operand that
+// its own avx2intrin.h uses for unmasked intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "lednicky_kernel.h"
+#include "banded_kernel.h"
+#include "surrogate_kernel.h"
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+const LednickyKernels lednicky_kernels_avx2 = LEDNICKY_KERNEL_TABLE(simd::Vec4d);
+const LednickyKernelsFloat lednicky_kernels_float_avx2 = LEDNICKY_KERNEL_TABLE(simd::Vec8f);
+
+void
+faddeeva_w_im_avx2(const double *x, double *out, std::size_t n)
+{
+  w_im_batch<simd::Vec4d>(x, out, n);
+}
+
+void
+faddeeva_w_im_float_avx2(const float *x, float *out, std::size_t n)
+{
+  w_im_batch<simd::Vec8f>(x, out, n);
+}
+
+void
+banded_multiply_add_avx2(const double *values, const std::uint32_t *first, std::size_t width,
+                         const double *x, double scale, double *y, std::size_t rows)
+{
+  banded_multiply_add_rows<simd::Vec4d>(values, first, width, x, scale, y, rows);
+}
+
+void
+surrogate_sum_avx2(const double *const *curves, const double *w, int count, double bias,
+                   std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec4d>(curves, w, count, bias, bins, cf);
+}
+
+void
+surrogate_sum_float_avx2(const float *const *curves, const double *w, int count, double bias,
+                         std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec4d>(curves, w, count, bias, bins, cf);
+}
+
+#endif
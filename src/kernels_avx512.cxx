@@ -0,0 +1,58 @@
+///
+/// \file kernels_avx512.cxx
+/// \brief AVX-512F instantiation of the batch kernels
+///
+/// Compiled with -mavx512f; only called after simd::detect() has
+/// confirmed the running CPU supports these instructions.
+///
+
+// GCC 12 warns about the deliberately undefined passthrough operand that
+// its own avx512fintrin.h uses for unmasked intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "lednicky_kernel.h"
+#include "banded_kernel.h"
+#include "surrogate_kernel.h"
+
+#if defined(__AVX512F__)
+
+const LednickyKernels lednicky_kernels_avx512 = LEDNICKY_KERNEL_TABLE(simd::Vec8d);
+const LednickyKernelsFloat lednicky_kernels_float_avx512 = LEDNICKY_KERNEL_TABLE(simd::Vec16f);
+
+void
+faddeeva_w_im_avx512(const double *x, double *out, std::size_t n)
+{
+  w_im_batch<simd::Vec8d>(x, out, n);
+}
+
+void
+faddeeva_w_im_float_avx512(const float *x, float *out, std::size_t n)
+{
+  w_im_batch<simd::Vec16f>(x, out, n);
+}
+
+void
+banded_multiply_add_avx512(const double *values, const std::uint32_t *first, std::size_t width,
+                           const double *x, double scale, double *y, std::size_t rows)
+{
+  banded_multiply_add_rows<simd::Vec8d>(values, first, width, x, scale, y, rows);
+}
+
+void
+surrogate_sum_avx512(const double *const *curves, const double *w, int count, double bias,
+                     std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec8d>(curves, w, count, bias, bins, cf);
+}
+
+void
+surrogate_sum_float_avx512(const float *const *curves, const double *w, int count, double bias,
+                           std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec8d>(curves, w, count, bias, bins, cf);
+}
+
+#endif
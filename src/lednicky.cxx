@@ -7,193 +7,514 @@
 // 1. Currently, the quantum interference terms are only set up for
 // spin 1/2 fermions.  For other spins, would need to make the lednicky eqn more
 // generalized.  See Lednicky paper for the proper prefactors.
-// 2. This does not include any Coulomb interactions.
-// 3. This does not include any residual correlation effects.
+// 2. Coulomb interactions are only included by
+// evaluate_lednicky_coulomb(), in the Lednicky-Lyuboshits model with the
+// finite-size integrals of coulomb.h (see lednicky.h).
+// 3. Residual correlations are added on top of these curves by
+// LednickyResiduals (see residuals.h).
 
 #include "lednicky.h"
+#include "lednicky_kernel.h"
+#include "fspline.h"
 
 #include <algorithm>
 #include <complex>
 #include <cmath>
-#include <iostream>
-
-#include <TH1D.h>
-#include <TGraph.h>
-#include <TMath.h>
-#include <TF1.h>
-#include <TH2D.h>
-#include <TStyle.h>
-#include <TApplication.h>
-#include <TCanvas.h>
+#include <limits>
+#include <stdexcept>
+
 #include "faddeeva.h" //Fast numerical integration package which
 // includes the Dawson function
 
 typedef std::complex<double> complex_t;
 
-using std::cout;
-using std::endl;
 using std::pow;
 
 const double hbarc = 0.19732697;
 
-//Manually set the fit parameters here.
-double lamPrimary = 0.2; // lambda parameter for primary pairs
-double radius = 3.0; // R_inv
-double normalization = 1.0;  // Simple normalization factor
-double f0re = -0.071; //Scattering length.  Can be positive or negative
-double f0im = 0.0; //Should be zero for baryon-baryon. Nonzero for any baryon-antibaryon.  Not sure about baryon-meson.  For non-zero cases, is > 0 (I don't know of situations where this can be negative).
-double d0 = 0.0; //Effective range of interaction.  Should be >= 0
-bool identical = false;  //Are the two particles identical?  This turns on/off quantum interference
-double maxKstar = 1.5; //Highest k* value of histograms.  Minimum is 0
-int totalBins = 1000; //How many bins will the histograms have?  maxKstar/totalBins will be the bin width.
+template <typename T>
+T
+scattering_amplitude_denominator(T x, const std::complex<T>& f0, T d0)
+{
+  const T f0re = f0.real(),
+          f0im = f0.imag(),
+          hbarc_1 = hbarc,
+          hbarc_2 = hbarc_1*hbarc_1,
+          x_2 = x*x;
+
+  T denominatorScatterAmp =
+    pow((1+f0im*x/hbarc_1), 2)          // (1+\frac{\imag{f0}x}{\hbar c})^2
+    + pow(f0re*x/hbarc_1, 2)           // (\frac{\real{f0}x}{\hbar c})^2
+    + pow(x_2*d0/(T(2) * hbarc_2)*std::abs(f0), 2) // (|f0| * \frac{x^2*d0}{2(\hbar c)^2})^2
+    + x_2*f0re*d0/(hbarc_2); // \frac{x^2 \real{f0} d0}{(\hbar c)^2}
 
-double
-get_lednicky_f1 (double z)
+  return denominatorScatterAmp;
+}
+
+template <typename T>
+std::complex<T>
+scattering_amplitude_numerator(T x, const std::complex<T>& f0, T d0)
 {
-  return Faddeeva::Dawson(z) / z;
+  //numerator of real part of scattering amplitude
+  const T hbarc_1 = hbarc;
+
+  T real_part = f0.real() + x*x*d0*std::norm(f0)/(T(2)*hbarc_1*hbarc_1),
+    imag_part = f0.imag() + x * std::norm(f0) / hbarc_1;
+
+  // return pow(real_part, 2) + pow(imag_part, 2);
+  return std::complex<T>(real_part, imag_part);
 }
 
+template <>
 double
-scattering_amplitude_denominator(double x, const complex_t& f0, double d0)
+GetLednickyF1(double z)
 {
-  const double f0real = f0.real(),
-               f0im = f0.imag(),
-               hbarc_2 = hbarc*hbarc,
-               x_2 = x*x;
+  //
+  double result = (1./z)*Faddeeva::Dawson(z);
+  return result;
+}
 
-  double denominatorScatterAmp =
-    pow((1+f0im*x/hbarc), 2)          // (1+\frac{\imag{f0}x}{\hbar c})^2
-    + pow(f0re*x/hbarc, 2)           // (\frac{\real{f0}x}{\hbar c})^2
-    + pow(x_2*d0/(2.0 * hbarc_2)*std::abs(f0), 2) // (|f0| * \frac{x^2*d0}{2(\hbar c)^2})^2
-    + x_2*f0re*d0/(hbarc_2); // \frac{x^2 \real{f0} d0}{(\hbar c)^2}
+template <>
+float
+GetLednickyF1(float z)
+{
+  // single precision Dawson(z) = spi2 * w_im(z), from the float table
+  const float dawson = static_cast<float>(faddeeva_spi2) * w_im_lanes(simd::Vec1f(z)).v;
+  return dawson / z;
+}
 
-  return denominatorScatterAmp;
+template double scattering_amplitude_denominator(double, const std::complex<double>&, double);
+template float scattering_amplitude_denominator(float, const std::complex<float>&, float);
+template std::complex<double> scattering_amplitude_numerator(double, const std::complex<double>&, double);
+template std::complex<float> scattering_amplitude_numerator(float, const std::complex<float>&, float);
+
+void
+generate_lednicky_equation(const LednickyEquation_s& eq, double *kstar, double *cf)
+{
+  for (int xBin=0; xBin < eq.totalBins; xBin++) {
+    //Set the positions of the kstar bins
+    kstar[xBin] = (xBin+0.5); // This shifts the center of the bin
+    kstar[xBin] *= eq.maxKstar;
+    kstar[xBin] /= 1.0*eq.totalBins;
+  }
+
+  //Cf is the Lednicky and Lyuboshits parameterization of the correlation function, as seen in ALICE K0s-K0s pp paper from 2012.
+  evaluate_lednicky_equation(eq, kstar, cf, eq.totalBins);
 }
 
-complex_t
-scattering_amplitude_numerator(double x, const complex_t& f0, double d0)
+namespace {
+
+/**
+ * Where the kernels switch to the asymptotic forms, for every tolerance
+ * 2^e down to 2^MIN_EXPONENT.
+ *
+ * Truncated after K terms, the series of F1 is off by less than four times
+ * the first omitted term c_K/z^(2K) once z^2 >= K (checked against
+ * Faddeeva::Dawson for K up to 16), which fixes the smallest z for each K;
+ * the K of the lowest of these is taken. Dropping exp(-z^2) changes F2 by
+ * exp(-z^2)/z relative and R dF2/dR by 2z^2 exp(-z^2) relative to F2, which
+ * bounds z from below as well.
+ */
+struct AsymptoticThresholds {
+  static const int MIN_EXPONENT = -100;
+
+  double z[1 - MIN_EXPONENT];
+  unsigned terms[1 - MIN_EXPONENT];
+
+  AsymptoticThresholds();
+};
+
+AsymptoticThresholds::AsymptoticThresholds()
 {
-  //numerator of real part of scattering amplitude
+  for (int i = 0; i <= -MIN_EXPONENT; ++i) {
+    const double log_tolerance = -i * std::log(2.0);
 
-  double real_part = f0.real() + x*x*d0*std::norm(f0)/(2.*hbarc*hbarc),
-         imag_part = f0.imag() + x * std::norm(f0) / hbarc;
+    // 2 z^2 exp(-z^2) = tolerance, by fixed-point iteration
+    double gauss_z2 = std::max(1.0, -log_tolerance);
+    for (int iteration = 0; iteration < 8; ++iteration) {
+      gauss_z2 = std::log(2.0 * gauss_z2) - log_tolerance;
+    }
 
-  // return pow(real_part, 2) + pow(imag_part, 2);
-  return std::complex<double>(real_part, imag_part);
+    double c = 1.0,
+           best_z2 = HUGE_VAL;
+    terms[i] = asymptotic_max_terms;
+    for (unsigned K = 1; K <= asymptotic_max_terms; ++K) {
+      // c = c_K, the first omitted coefficient
+      c *= (2.0 * K - 1.0) / 2.0;
+      const double z2 = std::max(std::max<double>(K, gauss_z2),
+                                 std::exp((std::log(4.0 * c) - log_tolerance) / K));
+      if (z2 < best_z2) {
+        best_z2 = z2;
+        terms[i] = K;
+      }
+    }
+    z[i] = std::sqrt(best_z2);
+  }
+}
+
+const AsymptoticThresholds&
+asymptotic_thresholds()
+{
+  static const AsymptoticThresholds thresholds;
+  return thresholds;
+}
+
+} // anonymous namespace
+
+/// Precision of the single precision kernels, below which the asymptotic
+/// forms need not go
+static const double float_tolerance = std::numeric_limits<float>::epsilon();
+
+/// Kernel parameters of `eq`; the asymptotic forms are used to no better
+/// than `tolerance_floor`, the precision of the kernels
+static LednickyKernelParams
+make_kernel_params(const LednickyEquation_s& eq, double tolerance_floor = 0.0)
+{
+  const double SQRT_PI = sqrt(M_PI);
+
+  LednickyKernelParams p;
+  p.identical = eq.identical;
+  p.f0re = eq.f0re;
+  p.f0im = eq.f0im;
+  p.f0_norm = eq.f0re * eq.f0re + eq.f0im * eq.f0im;
+  p.d0 = eq.d0;
+  p.z_scale = 2.0 * eq.radius / hbarc;
+  if (eq.spline_basis) {
+    // no more accurate than the table where the two meet
+    tolerance_floor = std::max(tolerance_floor, F_SPLINE_TOLERANCE);
+    p.spline_z = F_SPLINE_Z_MAX;
+    p.spline_coeffs = f_spline_coeffs(double());
+    p.spline_coeffs_float = f_spline_coeffs(float());
+  } else {
+    p.spline_z = 0.0;
+    p.spline_coeffs = nullptr;
+    p.spline_coeffs_float = nullptr;
+  }
+  if (eq.asymptotic_tolerance > 0.0) {
+    // rounded down to a power of two, and so on the safe side
+    const AsymptoticThresholds& thresholds = asymptotic_thresholds();
+    const double tolerance = std::max(eq.asymptotic_tolerance, tolerance_floor);
+    const int i = std::min(std::max(-std::ilogb(tolerance), 0), -AsymptoticThresholds::MIN_EXPONENT);
+    p.asymptotic_z = thresholds.z[i];
+    p.asymptotic_terms = thresholds.terms[i];
+  } else {
+    p.asymptotic_z = HUGE_VAL;
+    p.asymptotic_terms = 1;
+  }
+  p.amp_factor = 0.5 / (eq.radius * eq.radius) * (1. - eq.d0 / (2.0 * SQRT_PI * eq.radius));
+  p.f1_factor = 2.0 / (SQRT_PI * eq.radius);
+  p.f2_factor = 1.0 / eq.radius;
+  p.amp_factor_dradius = -1.0 / (eq.radius * eq.radius * eq.radius)
+                        + 3.0 * eq.d0 / (4.0 * SQRT_PI * std::pow(eq.radius, 4));
+  p.amp_factor_dd0 = -1.0 / (4.0 * SQRT_PI * eq.radius * eq.radius * eq.radius);
+  p.model_offset = (1.0 - eq.lamPrimary) / eq.normalization;
+  p.model_scale = eq.lamPrimary / eq.normalization;
+
+  // f0 = 0 leaves only the Coulomb part; a huge 1/f0 keeps f_c finite
+  if (p.f0_norm > 0.0) {
+    p.inv_f0_re = eq.f0re / p.f0_norm;
+    p.inv_f0_im = -eq.f0im / p.f0_norm;
+  } else {
+    p.inv_f0_re = 1e30;
+    p.inv_f0_im = 0.0;
+  }
+  p.coulomb_x_scale = 0.0;
+  p.gamow_scale = 0.0;
+  p.coulomb_h_factor = 0.0;
+  p.coulomb_p = 0.0;
+  p.coulomb_beta0 = 0.0;
+  return p;
+}
+
+const LednickyKernels lednicky_kernels_scalar = LEDNICKY_KERNEL_TABLE(simd::Vec1d);
+const LednickyKernelsFloat lednicky_kernels_float_scalar = LEDNICKY_KERNEL_TABLE(simd::Vec1f);
+
+template <typename T>
+static const LednickyKernelTable<T>&
+select_lednicky_kernels(const LednickyKernelTable<T> &scalar,
+                        const LednickyKernelTable<T> &avx2,
+                        const LednickyKernelTable<T> &avx512)
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  switch (simd::detect()) {
+  case simd::Level::AVX512:
+    return avx512;
+  case simd::Level::AVX2:
+    return avx2;
+  default:
+    break;
+  }
+#else
+  (void)avx2;
+  (void)avx512;
+#endif
+  return scalar;
+}
+
+const LednickyKernels&
+lednicky_kernels()
+{
+  static const LednickyKernels &kernels =
+    select_lednicky_kernels(lednicky_kernels_scalar, lednicky_kernels_avx2, lednicky_kernels_avx512);
+  return kernels;
 }
 
+const LednickyKernelsFloat&
+lednicky_kernels_float()
+{
+  static const LednickyKernelsFloat &kernels =
+    select_lednicky_kernels(lednicky_kernels_float_scalar,
+                            lednicky_kernels_float_avx2,
+                            lednicky_kernels_float_avx512);
+  return kernels;
+}
 
 void
-generate_lednicky_equation(const LednickyEquation_s& eq)
+evaluate_lednicky_equation(const LednickyEquation_s& eq,
+                           const double *kstar,
+                           double *cf,
+                           std::size_t count)
 {
-  TF1 f2("function_f2", "(1-exp(-[0]*[0]*x*x))/([0]*x)");
-  f2.SetParameter(0, 2.0 * eq.radius / hbarc);
-  f2.SetRange(0, eq.maxKstar);
+  const LednickyKernelParams p = make_kernel_params(eq);
+  lednicky_kernels().cf[lednicky_kernel_variant(p)](p, kstar, cf, count);
+}
 
-  // Create a vector spaning bin the x axis
-  short x_index = 0;
-  std::vector<double> X(eq.totalBins);
-  std::for_each(X.begin(), X.end(),
-    [&x_index](double &n) {
-      n = (x_index++ + 0.5) * maxKstar / totalBins;
-    });
+void
+evaluate_lednicky_equation(const LednickyEquation_s& eq,
+                           const float *kstar,
+                           float *cf,
+                           std::size_t count)
+{
+  const LednickyKernelParams p = make_kernel_params(eq, float_tolerance);
+  lednicky_kernels_float().cf[lednicky_kernel_variant(p)](p, kstar, cf, count);
+}
 
-  // Create kstar and correlation function vectors (y-axis)
-  std::vector<double> kstar(eq.totalBins), Cf(eq.totalBins);
+static LednickyKernelParams
+make_coulomb_kernel_params(const LednickyEquation_s& eq, double bohr_radius,
+                           double tolerance_floor = 0.0)
+{
+  if (!std::isfinite(bohr_radius) || bohr_radius == 0.0) {
+    throw std::invalid_argument("the Bohr radius must be finite and non-zero");
+  }
+  const double ratio = eq.radius / bohr_radius;
+  if (!(std::fabs(ratio) <= COULOMB_SOURCE_P_MAX)) {
+    throw std::invalid_argument("radius / |Bohr radius| exceeds the finite-size Coulomb table");
+  }
 
-  const double radius_squared = pow(eq.radius, 2);
+  const double euler_gamma = 0.57721566490153286;
+  LednickyKernelParams p = make_kernel_params(eq, tolerance_floor);
+  p.coulomb_x_scale = std::fabs(bohr_radius) / hbarc;
+  p.gamow_scale = (bohr_radius < 0.0) ? -2.0 * M_PI : 2.0 * M_PI;
+  p.coulomb_h_factor = 2.0 / bohr_radius;
+  p.coulomb_p = ratio;
+  p.coulomb_beta0 = (ratio == 0.0) ? 0.0
+                  : 2.0 * ratio * (std::log(2.0 * std::fabs(ratio)) + 2.0 * euler_gamma - 1.0);
+  return p;
+}
 
-  // for (double x : X) {
-  for (unsigned int i = 0; i < X.size(); ++i) {
+void
+evaluate_lednicky_coulomb(const LednickyEquation_s& eq,
+                          double bohr_radius,
+                          const double *kstar,
+                          double *cf,
+                          std::size_t count)
+{
+  lednicky_kernels().coulomb(make_coulomb_kernel_params(eq, bohr_radius), kstar, cf, count);
+}
+
+void
+evaluate_lednicky_coulomb(const LednickyEquation_s& eq,
+                          double bohr_radius,
+                          const float *kstar,
+                          float *cf,
+                          std::size_t count)
+{
+  lednicky_kernels_float().coulomb(make_coulomb_kernel_params(eq, bohr_radius, float_tolerance),
+                                   kstar, cf, count);
+}
+
+void
+evaluate_lednicky_jacobian(const LednickyEquation_s& eq,
+                           const double *kstar,
+                           double *cf,
+                           double *jacobian,
+                           std::size_t count)
+{
+  lednicky_kernels().jacobian(make_kernel_params(eq), kstar, cf, jacobian, count);
+}
+
+double
+lednicky_chi2(const LednickyEquation_s& eq,
+              const double *kstar,
+              const double *cf,
+              const double *error,
+              std::size_t count)
+{
+  const LednickyKernelParams p = make_kernel_params(eq);
+  return lednicky_kernels().chi2[lednicky_kernel_variant(p)](p, kstar, cf, error, count);
+}
 
-    const double &x = X[i],
-          SQRT_PI = sqrt(M_PI);
+double
+lednicky_poisson_deviance(const LednickyEquation_s& eq,
+                          const double *kstar,
+                          const double *counts,
+                          const double *reference,
+                          std::size_t count)
+{
+  const LednickyKernelParams p = make_kernel_params(eq);
+  return lednicky_kernels().poisson[lednicky_kernel_variant(p)](p, kstar, counts, reference, count);
+}
 
-    double &cf = Cf[i];
+double
+lednicky_chi2(const LednickyEquation_s& eq,
+              const float *kstar,
+              const float *cf,
+              const float *error,
+              std::size_t count)
+{
+  const LednickyKernelParams p = make_kernel_params(eq, float_tolerance);
+  return lednicky_kernels_float().chi2[lednicky_kernel_variant(p)](p, kstar, cf, error, count);
+}
 
-    const double denom = scattering_amplitude_denominator(x, eq.f0, eq.d0);
-    const complex_t num = scattering_amplitude_numerator(x, eq.f0, eq.d0);
-    const double amplitude = std::norm(num) / (denom * denom);
+double
+lednicky_poisson_deviance(const LednickyEquation_s& eq,
+                          const float *kstar,
+                          const float *counts,
+                          const float *reference,
+                          std::size_t count)
+{
+  const LednickyKernelParams p = make_kernel_params(eq, float_tolerance);
+  return lednicky_kernels_float().poisson[lednicky_kernel_variant(p)](p, kstar, counts, reference, count);
+}
 
-    cf = 0.5 * (amplitude/radius_squared)*(1. - eq.d0 / (2.0 * SQRT_PI * eq.radius));
-    cf += 2*(num.real()/denom) / (SQRT_PI * eq.radius) * get_lednicky_f1(2.* x *radius/hbarc);
-    //if(finished) cout<<xBin<<"\t"<<kstar[xBin]<<"\t"<<Cf[xBin]<<"\t"<<2*(realScatterAmp/denominatorScatterAmp)/(TMath::Sqrt(TMath::Pi())*radius) <<endl;
-    cf -= (num.imag()/denom) * f2.Eval(x)/eq.radius;
+LednickyBasis::LednickyBasis():
+  _radius(0.0),
+  _asymptotic_tolerance(0.0),
+  _spline_basis(false)
+{
+}
 
-    if (eq.identical) {
-      cf *= 0.5; // identical spin 1/2 particles get suppressed by 1/2
-      cf -= 0.5 * exp(-4 * pow(x*radius/hbarc, 2));
-    }
-    cf += 1.0;
+bool
+LednickyBasis::prepare(double radius, const double *kstar, std::size_t count,
+                       double asymptotic_tolerance, bool spline_basis)
+{
+  if (radius == _radius
+      && asymptotic_tolerance == _asymptotic_tolerance
+      && spline_basis == _spline_basis
+      && count == _kstar.size()
+      && std::equal(kstar, kstar + count, _kstar.begin())) {
+    return false;
   }
+
+  _radius = radius;
+  _asymptotic_tolerance = asymptotic_tolerance;
+  _spline_basis = spline_basis;
+  _kstar.assign(kstar, kstar + count);
+  _f1.resize(count);
+  _f2.resize(count);
+  _gauss.resize(count);
+
+  LednickyEquation_s eq;
+  eq.radius = radius;
+  eq.asymptotic_tolerance = asymptotic_tolerance;
+  eq.spline_basis = spline_basis;
+  lednicky_kernels().basis(make_kernel_params(eq), kstar,
+                           _f1.data(), _f2.data(), _gauss.data(), count);
+  return true;
+}
+
+void
+LednickyBasis::evaluate(const LednickyEquation_s& eq,
+                        const double *kstar,
+                        double *cf,
+                        std::size_t count)
+{
+  prepare(eq.radius, kstar, count, eq.asymptotic_tolerance, eq.spline_basis);
+
+  const LednickyKernelParams p = make_kernel_params(eq);
+  lednicky_kernels().cf_basis[lednicky_kernel_variant(p)](p, _kstar.data(),
+                                                          _f1.data(), _f2.data(), _gauss.data(),
+                                                          cf, count);
+}
+
+void
+LednickyBasis::evaluate_jacobian(const LednickyEquation_s& eq,
+                                 const double *kstar,
+                                 double *cf,
+                                 double *jacobian,
+                                 std::size_t count)
+{
+  prepare(eq.radius, kstar, count, eq.asymptotic_tolerance, eq.spline_basis);
+  lednicky_kernels().jacobian_basis(make_kernel_params(eq), _kstar.data(),
+                                    _f1.data(), _f2.data(), _gauss.data(),
+                                    cf, jacobian, count);
 }
 
 double
-GetLednickyF1(double z)
+LednickyBasis::chi2(const LednickyEquation_s& eq,
+                    const double *kstar,
+                    const double *cf,
+                    const double *error,
+                    std::size_t count)
 {
-  //
-  double result = (1./z)*Faddeeva::Dawson(z);
-  return result;
+  prepare(eq.radius, kstar, count, eq.asymptotic_tolerance, eq.spline_basis);
+
+  const LednickyKernelParams p = make_kernel_params(eq);
+  return lednicky_kernels().chi2_basis[lednicky_kernel_variant(p)](p, _kstar.data(),
+                                                                   _f1.data(), _f2.data(), _gauss.data(),
+                                                                   cf, error, count);
 }
 
-TGraph*
-GetLednickyEqn(bool identicalParticles)
+double
+LednickyBasis::poisson_deviance(const LednickyEquation_s& eq,
+                                const double *kstar,
+                                const double *counts,
+                                const double *reference,
+                                std::size_t count)
 {
-  TF1 funf2("funf2", "(1-exp(-[0]*[0]*x*x))/([0]*x)");
-  funf2.SetParameter(0, 2.0 * radius / hbarc);
-  funf2.SetRange(0.0, 2.0); //why this range?
+  prepare(eq.radius, kstar, count, eq.asymptotic_tolerance, eq.spline_basis);
 
-  // Create a vector with number of bins - this is the x axis of our
-  // correlation functoin
-  std::vector<double> kstar_v(totalBins);
+  const LednickyKernelParams p = make_kernel_params(eq);
+  return lednicky_kernels().poisson_basis[lednicky_kernel_variant(p)](p, _kstar.data(),
+                                                                      _f1.data(), _f2.data(), _gauss.data(),
+                                                                      counts, reference, count);
+}
 
-  float x_index = 0;
-  std::for_each(kstar_v.begin(), kstar_v.end(), [&x_index] (double &n) {
-    n = (x_index++ + 0.5) * maxKstar / totalBins;
-  });
+LednickyWorkspace::LednickyWorkspace():
+  _bins(0),
+  _maxKstar(0.0)
+{
+}
 
-  // This is the y-axis of the correlation function
-  std::vector<double> Cf_v(totalBins);
-  std::for_each(kstar_v.begin(), kstar_v.end(), [&x_index] (double &x_val) {
-    x_val = (x_index++ + 0.5) * maxKstar / totalBins;
-  });
+void
+LednickyWorkspace::prepare(const LednickyEquation_s& eq)
+{
+  if (static_cast<std::size_t>(eq.totalBins) == _bins && eq.maxKstar == _maxKstar) {
+    return;
+  }
 
+  _bins = eq.totalBins;
+  _maxKstar = eq.maxKstar;
+  _kstar.resize(_bins);
+  _cf.resize(_bins);
 
-  double *kstar = new double[totalBins];
-  // double ykre[100];
-  // double ykim[100];
-  double *Cf = new double[totalBins];
-  // double rad = radius/hbarc;
-  double denominatorScatterAmp, realScatterAmp, imaginaryScatterAmp, magnitudeScatterAmp;
-  for (int xBin=0; xBin < totalBins; xBin++) {
-    //Set the positions of the kstar bins
-    kstar[xBin] = (xBin+0.5); // This shifts the center of the bin
-    kstar[xBin] *= maxKstar;
-    kstar[xBin] /= 1.0*totalBins;
-    //Now calculate the denominator of the scattering amplitude
-    denominatorScatterAmp = (1+f0im*kstar[xBin]/hbarc)*(1+f0im*kstar[xBin]/hbarc)
-      + f0re*f0re*kstar[xBin]*kstar[xBin]/(hbarc*hbarc)
-      + kstar[xBin]*kstar[xBin]*kstar[xBin]*kstar[xBin]*d0*d0*(f0re*f0re+f0im*f0im)/(4.*hbarc*hbarc*hbarc*hbarc)
-      + kstar[xBin]*kstar[xBin]*f0re*d0/(hbarc*hbarc);
-    //Calculate the real and imaginary parts of the scattering amplitude (just the numerators)
-    realScatterAmp = f0re + kstar[xBin]*kstar[xBin]*d0*(f0re*f0re+f0im*f0im)/(2.*hbarc*hbarc); //numerator of real part of scattering amplitude
-    imaginaryScatterAmp = f0im + kstar[xBin]*(f0re*f0re + f0im*f0im)/(hbarc);
-    //Take the magnitude of the scattering amplitude
-    magnitudeScatterAmp = (realScatterAmp*realScatterAmp + imaginaryScatterAmp*imaginaryScatterAmp)/(denominatorScatterAmp*denominatorScatterAmp);
-    //Cf is the Lednicky and Lyuboshits parameterization of the correlation function, as seen in ALICE K0s-K0s pp paper from 2012.
-    Cf[xBin] = 0.5 * (magnitudeScatterAmp/(radius*radius))*(1. - d0/(2.*TMath::Sqrt(TMath::Pi())*radius));
-    Cf[xBin] += 2*(realScatterAmp/denominatorScatterAmp)/(TMath::Sqrt(TMath::Pi())*radius)*GetLednickyF1(2.*kstar[xBin]*radius/hbarc);
-    //if(finished) cout<<xBin<<"\t"<<kstar[xBin]<<"\t"<<Cf[xBin]<<"\t"<<2*(realScatterAmp/denominatorScatterAmp)/(TMath::Sqrt(TMath::Pi())*radius) <<endl;
-    Cf[xBin] -= (imaginaryScatterAmp/denominatorScatterAmp)*funf2.Eval(kstar[xBin])/radius;
-    if(identicalParticles){
-      Cf[xBin] *= 0.5; // identical spin 1/2 particles get suppressed by 1/2
-      Cf[xBin] -= 0.5*exp(-4*pow(kstar[xBin]*radius/hbarc,2));
-    }
-    Cf[xBin] += 1.0;
+  for (std::size_t xBin = 0; xBin < _bins; xBin++) {
+    _kstar[xBin] = (xBin + 0.5) * eq.maxKstar / _bins;
   }
-  // Make a TGraph of the correlation function
-  TGraph *cfGraph = new TGraph(totalBins, kstar, Cf);
-  delete kstar;
-  delete Cf;
-  return cfGraph;
+}
+
+const double*
+LednickyWorkspace::evaluate(const LednickyEquation_s& eq)
+{
+  // prepare first: it may reallocate the cf buffer
+  prepare(eq);
+  _basis.evaluate(eq, _kstar.data(), _cf.data(), _bins);
+  return _cf.data();
+}
+
+void
+LednickyWorkspace::evaluate(const LednickyEquation_s& eq, double *cf)
+{
+  prepare(eq);
+  _basis.evaluate(eq, _kstar.data(), cf, _bins);
 }
@@ -5,60 +5,360 @@
 
 #pragma once
 
-#include <TGraph.h>
 #include <complex>
+#include <cstddef>
+#include <vector>
 
 typedef unsigned short ushort_t;
 typedef struct LednickyEquation LednickyEquation_s;
 
+/// Default LednickyEquation::asymptotic_tolerance, at which the asymptotic
+/// forms agree with the full functions to about double precision
+const double LEDNICKY_ASYMPTOTIC_TOLERANCE = 1e-15;
+
 /**
  * LednickyEquation
  * \brief Structure housing all parameters used by the Lednicky equations.
  *
  * This structure replaces the global vraiables used in the original code,
  * allowing multiple Lednicky equations to be analyzed at the same time.
+ * Every evaluation function reads its parameters only from here, so
+ * different threads may evaluate different equations concurrently.
  */
 struct LednickyEquation {
   /// Are the two particles identical?  This turns on/off quantum interference
-  bool identical;
+  bool identical {false};
 
   /// Number of bins to give created histograms
-  ushort_t totalBins;
+  int totalBins {1000};
 
   /// Normalization Factor
-  double normalization;
+  double normalization {1.0};
 
   /// Lambda Parameter for primary pairs
-  double lamPrimary;
+  double lamPrimary {0.2};
 
   /// Maximum k* on histograms
-  double maxKstar;
+  double maxKstar {1.5};
 
   /// Femtoscopic Radius
-  double radius;
+  double radius {3.0};
 
   /// Effective range of interaction (should be >= 0)
-  double d0;
+  double d0 {0.0};
+
+  /// Real part of f0 (scattering length, can be positive or negative)
+  double f0re {-0.071};
 
-  // The f0 parameter
-  std::complex<double> f0;
+  /// Imaginary part of f0. Zero for baryon-baryon, positive for
+  /// baryon-antibaryon pairs.
+  double f0im {0.0};
 
-  /// Real part of f0
-  double f0re;
+  /// Relative error allowed in F1 and F2 where the evaluation switches to
+  /// their large-z series (see evaluate_lednicky_equation()); 0 always
+  /// evaluates the Dawson function
+  double asymptotic_tolerance {LEDNICKY_ASYMPTOTIC_TOLERANCE};
 
-  /// Imaginary part of f0
-  double f0im;
+  /// Interpolate F1, F2 and exp(-z^2) from the precomputed table of
+  /// fspline.h, to a relative error of about 1e-10, instead of evaluating
+  /// the Dawson function and the exponential
+  bool spline_basis {false};
 };
 
-extern bool identical;  //
-extern int totalBins; //How many bins will the histograms have?  maxKstar/totalBins will be the bin width.
-extern double normalization;  //Simple normalization factor
-extern double lamPrimary; // lambda parameter for primary pairs
-extern double maxKstar;
-extern double radius;
-extern double d0; //
-extern double f0re;
-extern double f0im;
+/*
+ * The single-point functions below are instantiated for T = double and
+ * T = float. The float versions trade precision (about 1e-6 relative) for
+ * twice the SIMD width in the batch kernels.
+ */
+
+/// Denominator of the scattering amplitude f(k*) at k* = x (GeV/c)
+template <typename T>
+T scattering_amplitude_denominator(T x, const std::complex<T>& f0, T d0);
+
+/// Numerator of the scattering amplitude f(k*) at k* = x (GeV/c)
+template <typename T>
+std::complex<T> scattering_amplitude_numerator(T x, const std::complex<T>& f0, T d0);
+
+/// F1(z) = Dawson(z)/z
+template <typename T>
+T GetLednickyF1(T z);
+
+template <> double GetLednickyF1(double z);
+template <> float GetLednickyF1(float z);
+
+/**
+ * Fill `kstar` with the bin centres of `eq` and `cf` with the correlation
+ * function at those k*. Both arrays are caller-owned and must hold
+ * `eq.totalBins` values.
+ */
+void generate_lednicky_equation(const LednickyEquation_s& eq, double *kstar, double *cf);
 
+/**
+ * Evaluate the correlation function of `eq` at `count` values of k* (GeV/c).
+ *
+ * `kstar` and `cf` are caller-owned contiguous arrays of length `count`;
+ * `cf` may not overlap `kstar`. The bins are processed with the widest
+ * vector kernel (AVX-512, AVX2 or scalar) supported by the running CPU.
+ *
+ * Only `identical`, `radius`, `d0`, `f0re`, `f0im` and
+ * `asymptotic_tolerance` are read from `eq`; lambda and normalization are
+ * left to the caller.
+ *
+ * Past a z = 2k*R/(hbar c) computed from `asymptotic_tolerance`, F1 is
+ * summed from as many terms of its asymptotic series 1/(2z^2) (1 + 1/(2z^2)
+ * + 3/(4z^4) + ...) as the tolerance needs, F2 becomes 1/z and exp(-z^2),
+ * below the tolerance there, is dropped, so those bins cost a few
+ * multiplications instead of the Dawson function and an exponential. The
+ * threshold is about z = 7.5 at the default tolerance (k* = 0.25 GeV/c for
+ * R = 3 fm) and about 4 at 1e-6.
+ *
+ * With `spline_basis` set, registers of bins below the threshold, and
+ * below z = F_SPLINE_Z_MAX, interpolate the three functions from the
+ * cubic table of fspline.h instead, and the threshold is that of a
+ * tolerance of F_SPLINE_TOLERANCE at least. The same holds for every
+ * evaluation and reduction below.
+ */
+void evaluate_lednicky_equation(const LednickyEquation_s& eq,
+                                const double *kstar,
+                                double *cf,
+                                std::size_t count);
 
-TGraph* GetLednickyEqn(bool identicalParticles);
+/**
+ * Single precision evaluate_lednicky_equation(), for coarse scans and
+ * Monte Carlo weights. The vector kernels hold twice as many bins per
+ * register; the result differs from the double version by a few float
+ * ulps times the size of the terms that cancel (see Faddeeva::w_im(const
+ * float*, ...) for the error of the special function).
+ */
+void evaluate_lednicky_equation(const LednickyEquation_s& eq,
+                                const float *kstar,
+                                float *cf,
+                                std::size_t count);
+
+/**
+ * Evaluate the correlation function of a pair of charged particles with
+ * Bohr radius `bohr_radius` (fm, positive for repulsion, see
+ * coulomb_bohr_radius() in coulomb.h) at `count` values of k* (GeV/c), in
+ * the Lednicky-Lyuboshits model: the Coulomb scattering wave of the pair,
+ * with its s-wave modified by the strong interaction, averaged over the
+ * Gaussian source. The scattering amplitude becomes
+ *
+ *   1/f_c = 1/f0 + d0 k*^2/2 - 2 h(eta)/a_c - i k* A_c(eta),
+ *
+ * with eta = 1/(k* a_c) and the Gamow factor A_c(eta), and the source
+ * averages of the confluent hypergeometric functions are interpolated from
+ * the table of finite-size integrals in coulomb.h, to 2.3e-8 relative to
+ * the Coulomb term (coulomb_source_table_error()). Throws
+ * std::invalid_argument unless radius/|bohr_radius| <=
+ * COULOMB_SOURCE_P_MAX, 0.5, which holds up to R = 28 fm for pp and R = 24
+ * fm for p-Xi-.
+ *
+ * As |a_c| grows the curve tends to that of evaluate_lednicky_equation().
+ * h and the integrals are interpolated from tables and everything else is
+ * vectorized as in evaluate_lednicky_equation(); lambda and normalization
+ * are left to the caller.
+ */
+void evaluate_lednicky_coulomb(const LednickyEquation_s& eq,
+                               double bohr_radius,
+                               const double *kstar,
+                               double *cf,
+                               std::size_t count);
+
+/// Single precision evaluate_lednicky_coulomb(), on float copies of the
+/// tables
+void evaluate_lednicky_coulomb(const LednickyEquation_s& eq,
+                               double bohr_radius,
+                               const float *kstar,
+                               float *cf,
+                               std::size_t count);
+
+/// Columns of the Jacobian written by evaluate_lednicky_jacobian()
+enum LednickyJacobianColumn {
+  JACOBIAN_RADIUS,
+  JACOBIAN_F0RE,
+  JACOBIAN_F0IM,
+  JACOBIAN_D0,
+  JACOBIAN_COLUMNS
+};
+
+/**
+ * Evaluate the correlation function of `eq` and its derivatives with
+ * respect to radius, f0re, f0im and d0 at `count` values of k* (GeV/c).
+ *
+ * `cf` receives the same values as evaluate_lednicky_equation(). Column c
+ * of the Jacobian, dC/d(parameter c) at every k*, is written to
+ * `jacobian + c * count`, so `jacobian` holds JACOBIAN_COLUMNS * count
+ * values. The derivatives are exact (forward mode, see lednicky_kernel.h)
+ * and come out of the same pass as the values, sharing its Dawson and
+ * exponential evaluations, at roughly the cost of one curve.
+ *
+ * lamPrimary and normalization are not applied; for the scaled curve
+ * (1 + (C-1) lambda)/N the columns scale with lambda/N, and
+ * d/dlambda = (C-1)/N.
+ */
+void evaluate_lednicky_jacobian(const LednickyEquation_s& eq,
+                                const double *kstar,
+                                double *cf,
+                                double *jacobian,
+                                std::size_t count);
+
+/**
+ * chi^2 = sum_i ((cf_i - M(k*_i)) / error_i)^2 of the scaled model
+ * M = (1 + (C - 1) lamPrimary) / normalization against the measured
+ * correlation function `cf` with uncertainties `error`, at `count` values
+ * of k* (GeV/c).
+ *
+ * The model is evaluated and reduced register by register and never
+ * written to memory, so a fit that only needs chi^2 saves the store and
+ * reload of the curve and its buffer.
+ */
+double lednicky_chi2(const LednickyEquation_s& eq,
+                     const double *kstar,
+                     const double *cf,
+                     const double *error,
+                     std::size_t count);
+
+/**
+ * Poisson deviance -2 ln(L/L_saturated) = 2 sum_i (mu_i - n_i + n_i ln(n_i/mu_i))
+ * of the pair counts `counts` (n_i) with expectation mu_i = M(k*_i)
+ * reference_i, where M is the scaled model of lednicky_chi2() and
+ * `reference` holds e.g. the mixed-event counts normalized to the
+ * same-event yield.
+ *
+ * Unlike chi^2 it stays unbiased for bins with few counts; it approaches
+ * chi^2 for large counts. Evaluated like lednicky_chi2() without storing
+ * the curve. Every mu_i must be positive.
+ */
+double lednicky_poisson_deviance(const LednickyEquation_s& eq,
+                                 const double *kstar,
+                                 const double *counts,
+                                 const double *reference,
+                                 std::size_t count);
+
+/// Single precision lednicky_chi2(); the sum is accumulated in float lanes
+double lednicky_chi2(const LednickyEquation_s& eq,
+                     const float *kstar,
+                     const float *cf,
+                     const float *error,
+                     std::size_t count);
+
+/// Single precision lednicky_poisson_deviance()
+double lednicky_poisson_deviance(const LednickyEquation_s& eq,
+                                 const float *kstar,
+                                 const float *counts,
+                                 const float *reference,
+                                 std::size_t count);
+
+/**
+ * LednickyBasis
+ * \brief Cache of the terms of the correlation function that depend only
+ *        on the radius and k*.
+ *
+ * F1(z) = Dawson(z)/z, F2(z) = (1-exp(-z^2))/z and the identical-particle
+ * term exp(-z^2), with z = 2k*R/(hbar c), are kept for one radius and one
+ * k* grid. While only f0, d0 or `identical` change between evaluations,
+ * just the scattering amplitude is recomputed, which needs no special
+ * functions.
+ *
+ * Not thread-safe; give each thread its own basis.
+ */
+class LednickyBasis {
+public:
+  LednickyBasis();
+
+  /// Make the cache valid for `radius` on the k* grid, with the asymptotic
+  /// forms of LednickyEquation::asymptotic_tolerance and the table of
+  /// LednickyEquation::spline_basis. Returns true if the terms had to be
+  /// recomputed, false if they were already cached.
+  bool prepare(double radius, const double *kstar, std::size_t count,
+               double asymptotic_tolerance = LEDNICKY_ASYMPTOTIC_TOLERANCE,
+               bool spline_basis = false);
+
+  /// Same as evaluate_lednicky_equation(), reusing the cached terms when
+  /// `eq.radius`, `eq.asymptotic_tolerance`, `eq.spline_basis` and the k*
+  /// grid are unchanged since the last call
+  void evaluate(const LednickyEquation_s& eq,
+                const double *kstar,
+                double *cf,
+                std::size_t count);
+
+  /// Same as evaluate_lednicky_jacobian(), reusing the cached terms
+  void evaluate_jacobian(const LednickyEquation_s& eq,
+                         const double *kstar,
+                         double *cf,
+                         double *jacobian,
+                         std::size_t count);
+
+  /// Same as lednicky_chi2(), reusing the cached terms
+  double chi2(const LednickyEquation_s& eq,
+              const double *kstar,
+              const double *cf,
+              const double *error,
+              std::size_t count);
+
+  /// Same as lednicky_poisson_deviance(), reusing the cached terms
+  double poisson_deviance(const LednickyEquation_s& eq,
+                          const double *kstar,
+                          const double *counts,
+                          const double *reference,
+                          std::size_t count);
+
+  /// Radius the cached terms belong to
+  double radius() const { return _radius; }
+
+  const std::vector<double>& f1() const { return _f1; }
+  const std::vector<double>& f2() const { return _f2; }
+  const std::vector<double>& gauss() const { return _gauss; }
+
+private:
+  double _radius;
+  double _asymptotic_tolerance;
+  bool _spline_basis;
+  std::vector<double> _kstar;
+  std::vector<double> _f1;
+  std::vector<double> _f2;
+  std::vector<double> _gauss;
+};
+
+/**
+ * LednickyWorkspace
+ * \brief Owns every buffer needed to evaluate correlation functions on the
+ *        bin centres of a LednickyEquation.
+ *
+ * The k* axis is rebuilt only when `totalBins` or `maxKstar` change, the
+ * radius-only terms only when the radius changes (see LednickyBasis), and
+ * buffers never shrink, so repeated evaluations - e.g. inside a fit loop -
+ * make no heap allocations once the workspace has seen its largest curve.
+ *
+ * Not thread-safe; give each thread its own workspace.
+ */
+class LednickyWorkspace {
+public:
+  LednickyWorkspace();
+
+  /// Evaluate `eq` on its bin centres into the workspace, returns cf()
+  const double* evaluate(const LednickyEquation_s& eq);
+
+  /// Evaluate `eq` on its bin centres into caller-owned storage of
+  /// `eq.totalBins` values
+  void evaluate(const LednickyEquation_s& eq, double *cf);
+
+  /// Number of bins of the last evaluation
+  std::size_t bins() const { return _bins; }
+
+  /// Bin centres of the last evaluation
+  const double* kstar() const { return _kstar.data(); }
+
+  /// Correlation function of the last evaluate(eq)
+  const double* cf() const { return _cf.data(); }
+
+private:
+  /// Make the k* axis match `eq`
+  void prepare(const LednickyEquation_s& eq);
+
+  std::size_t _bins;
+  double _maxKstar;
+  std::vector<double> _kstar;
+  std::vector<double> _cf;
+  LednickyBasis _basis;
+};
@@ -0,0 +1,1047 @@
+///
+/// \file lednicky_kernel.h
+/// \brief Batch kernels of the Lednicky correlation function
+///
+/// Internal header. The kernels are written once, generically over the
+/// vector types of simd.h, and instantiated by lednicky.cxx (scalar
+/// fallback), kernels_avx2.cxx and kernels_avx512.cxx. lednicky_kernels()
+/// picks one of the instantiations at runtime.
+///
+
+#pragma once
+
+#include "simd.h"
+#include "faddeeva_kernel.h"
+#include "coulomb.h"
+#include "fspline.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+/**
+ * LednickyKernelParams
+ * \brief Per-curve constants of the correlation function, computed once
+ *        from a LednickyEquation before entering the per-bin loop.
+ */
+struct LednickyKernelParams {
+  bool identical;
+
+  double f0re;
+  double f0im;
+
+  /// |f0|^2
+  double f0_norm;
+
+  double d0;
+
+  /// z = z_scale * k*, with z_scale = 2R/(hbar c)
+  double z_scale;
+
+  /// Registers whose lanes all have z >= asymptotic_z take the first
+  /// asymptotic_terms terms of the large-z series of F1, F2 = 1/z and
+  /// exp(-z^2) = 0 (see basis_lanes()); infinity keeps the full functions
+  double asymptotic_z;
+  unsigned asymptotic_terms;
+
+  /// Registers whose lanes all have z < spline_z, and that are not
+  /// asymptotic, interpolate F1 and F2 from the table of fspline.h, given
+  /// in both precisions; zero evaluates them
+  double spline_z;
+  const double *spline_coeffs;
+  const float *spline_coeffs_float;
+
+  /// Prefactor of |f|^2 : (1 - d0/(2 sqrt(pi) R)) / (2 R^2)
+  double amp_factor;
+
+  /// Prefactor of Re(f) F1(z) : 2/(sqrt(pi) R)
+  double f1_factor;
+
+  /// Prefactor of Im(f) F2(z) : 1/R
+  double f2_factor;
+
+  /// d amp_factor / dR : -1/R^3 + 3 d0/(4 sqrt(pi) R^4)
+  double amp_factor_dradius;
+
+  /// d amp_factor / d d0 : -1/(4 sqrt(pi) R^3)
+  double amp_factor_dd0;
+
+  /// The scaled model (1 + (C - 1) lambda)/N = model_offset + model_scale C,
+  /// read only by the statistic kernels: (1 - lambda)/N
+  double model_offset;
+
+  /// lambda/N
+  double model_scale;
+
+  /// 1/f0, read by the Coulomb kernel
+  double inv_f0_re;
+  double inv_f0_im;
+
+  /// x = coulomb_x_scale * k* = k* |a_c| / (hbar c), the argument of the
+  /// table of h(1/x); zero without Coulomb interaction
+  double coulomb_x_scale;
+
+  /// 2 pi sign(a_c): 2 pi eta = gamow_scale / x
+  double gamow_scale;
+
+  /// 2/a_c, the prefactor of h in 1/f_c
+  double coulomb_h_factor;
+
+  /// p = R/a_c, the second argument of the finite-size Coulomb integrals
+  double coulomb_p;
+
+  /// 2p (ln 2|p| + 2 gamma - 1): beta = coulomb_beta0 + 2p h
+  double coulomb_beta0;
+};
+
+/// Terms of the correlation function a kernel variant evaluates; a
+/// variant without a flag has the corresponding term compiled out
+enum LednickyKernelFlags {
+  /// Quantum statistics of identical spin 1/2 particles
+  KERNEL_IDENTICAL = 1,
+
+  /// Effective range d0 != 0
+  KERNEL_D0 = 2,
+
+  /// Imaginary scattering length f0im != 0
+  KERNEL_F0IM = 4,
+
+  KERNEL_VARIANTS = 8
+};
+
+/// The variant of the kernels needed for `p`, a set of LednickyKernelFlags
+inline unsigned
+lednicky_kernel_variant(const LednickyKernelParams &p)
+{
+  return (p.identical ? KERNEL_IDENTICAL : 0)
+       | (p.d0 != 0.0 ? KERNEL_D0 : 0)
+       | (p.f0im != 0.0 ? KERNEL_F0IM : 0);
+}
+
+/**
+ * LednickyKernelTable
+ * \brief The batch kernels compiled for one instruction set, on arrays of
+ *        the floating point type T
+ *
+ * The kernels depending on the scattering amplitude come in one variant
+ * per combination of LednickyKernelFlags, indexed by
+ * lednicky_kernel_variant(), so the per-bin loop carries neither the tests
+ * nor the arithmetic of the inactive terms.
+ */
+template <typename T>
+struct LednickyKernelTable {
+  typedef void (*cf_t)(const LednickyKernelParams&, const T *kstar, T *cf, std::size_t count);
+  typedef void (*cf_basis_t)(const LednickyKernelParams&, const T *kstar,
+                             const T *f1, const T *f2, const T *gauss,
+                             T *cf, std::size_t count);
+
+  /// cf[i] = C(kstar[i])
+  cf_t cf[KERNEL_VARIANTS];
+
+  /// The radius-only terms F1(z), F2(z) and exp(-z^2) at every k*
+  void (*basis)(const LednickyKernelParams&, const T *kstar,
+                T *f1, T *f2, T *gauss, std::size_t count);
+
+  /// cf[i] = C(kstar[i]) given the precomputed radius-only terms
+  cf_basis_t cf_basis[KERNEL_VARIANTS];
+
+  /// cf[i] = C(kstar[i]) and jacobian[p * count + i] = dC/dp(kstar[i]) for
+  /// p in radius, f0re, f0im, d0
+  void (*jacobian)(const LednickyKernelParams&, const T *kstar,
+                   T *cf, T *jacobian, std::size_t count);
+
+  /// jacobian() given the precomputed radius-only terms
+  void (*jacobian_basis)(const LednickyKernelParams&, const T *kstar,
+                         const T *f1, const T *f2, const T *gauss,
+                         T *cf, T *jacobian, std::size_t count);
+
+  /// cf[i] = C(kstar[i]) of a charged pair, see
+  /// evaluate_lednicky_coulomb()
+  cf_t coulomb;
+
+  typedef double (*statistic_t)(const LednickyKernelParams&, const T *kstar,
+                                const T *data, const T *aux, std::size_t count);
+  typedef double (*statistic_basis_t)(const LednickyKernelParams&, const T *kstar,
+                                      const T *f1, const T *f2, const T *gauss,
+                                      const T *data, const T *aux, std::size_t count);
+
+  /// sum_i ((data[i] - M(kstar[i])) / aux[i])^2 of the scaled model M,
+  /// without storing the curve
+  statistic_t chi2[KERNEL_VARIANTS];
+
+  /// Poisson deviance of the counts data[i] with expectation
+  /// M(kstar[i]) aux[i], without storing the curve
+  statistic_t poisson[KERNEL_VARIANTS];
+
+  /// chi2() and poisson() given the precomputed radius-only terms
+  statistic_basis_t chi2_basis[KERNEL_VARIANTS];
+  statistic_basis_t poisson_basis[KERNEL_VARIANTS];
+};
+
+typedef LednickyKernelTable<double> LednickyKernels;
+typedef LednickyKernelTable<float> LednickyKernelsFloat;
+
+extern const LednickyKernels lednicky_kernels_scalar;
+extern const LednickyKernels lednicky_kernels_avx2;
+extern const LednickyKernels lednicky_kernels_avx512;
+
+extern const LednickyKernelsFloat lednicky_kernels_float_scalar;
+extern const LednickyKernelsFloat lednicky_kernels_float_avx2;
+extern const LednickyKernelsFloat lednicky_kernels_float_avx512;
+
+/// Kernels of the widest instruction set usable on this machine
+const LednickyKernels& lednicky_kernels();
+
+/// Single precision kernels of the widest usable instruction set
+const LednickyKernelsFloat& lednicky_kernels_float();
+
+/// Every variant of `kernel` for the vector type V, in flag order
+#define LEDNICKY_KERNEL_VARIANTS(kernel, V)                     \
+  {                                                             \
+    &kernel<V, 0>, &kernel<V, 1>, &kernel<V, 2>, &kernel<V, 3>, \
+    &kernel<V, 4>, &kernel<V, 5>, &kernel<V, 6>, &kernel<V, 7>  \
+  }
+
+/// Every variant of the reduction `kernel` for the vector type V and the
+/// statistic S
+#define LEDNICKY_STATISTIC_VARIANTS(kernel, V, S)                           \
+  {                                                                         \
+    &kernel<V, 0, S>, &kernel<V, 1, S>, &kernel<V, 2, S>, &kernel<V, 3, S>, \
+    &kernel<V, 4, S>, &kernel<V, 5, S>, &kernel<V, 6, S>, &kernel<V, 7, S>  \
+  }
+
+/// Kernel table of a translation unit, for the vector type V
+#define LEDNICKY_KERNEL_TABLE(V)                                                       \
+  {                                                                                    \
+    LEDNICKY_KERNEL_VARIANTS(lednicky_cf_kernel, V),                                   \
+    &lednicky_basis_kernel<V>,                                                         \
+    LEDNICKY_KERNEL_VARIANTS(lednicky_cf_basis_kernel, V),                             \
+    &lednicky_jacobian_kernel<V>,                                                      \
+    &lednicky_jacobian_basis_kernel<V>,                                                \
+    &lednicky_coulomb_kernel<V>,                                                       \
+    LEDNICKY_STATISTIC_VARIANTS(lednicky_statistic_kernel, V, Chi2Statistic),          \
+    LEDNICKY_STATISTIC_VARIANTS(lednicky_statistic_kernel, V, PoissonStatistic),       \
+    LEDNICKY_STATISTIC_VARIANTS(lednicky_statistic_basis_kernel, V, Chi2Statistic),    \
+    LEDNICKY_STATISTIC_VARIANTS(lednicky_statistic_basis_kernel, V, PoissonStatistic)  \
+  }
+
+namespace {
+
+/// 1/(hbar c) in 1/(GeV fm)
+const double kernel_inv_hbarc = 1.0 / 0.19732697;
+
+/// Scattering amplitude f(k*) = num / denom for one register of k* values,
+/// with only the terms of the LednickyKernelFlags `Flags`
+template <typename V, unsigned Flags>
+struct AmplitudeLanes {
+  V num_re;
+  V num_im;
+  V inv_denom;
+
+  /// |f|^2
+  V norm;
+
+  AmplitudeLanes(const LednickyKernelParams &p, V k)
+  {
+    using simd::fma;
+
+    const V kh = k * V(kernel_inv_hbarc),
+            f0re_kh = V(p.f0re) * kh;
+
+    // (1 + f0im k)^2 + (f0re k)^2
+    V denom;
+    if (Flags & KERNEL_F0IM) {
+      const V f0im_kh1 = fma(V(p.f0im), kh, V(1.0));
+      denom = fma(f0im_kh1, f0im_kh1, f0re_kh * f0re_kh);
+      num_im = fma(V(p.f0_norm), kh, V(p.f0im));
+    } else {
+      denom = fma(f0re_kh, f0re_kh, V(1.0));
+      num_im = V(p.f0_norm) * kh;
+    }
+
+    num_re = V(p.f0re);
+    if (Flags & KERNEL_D0) {
+      const V d0_kh2 = V(p.d0) * kh * kh,
+              half_d0_norm_kh2 = V(0.5 * p.f0_norm) * d0_kh2;
+      denom = denom
+            + half_d0_norm_kh2 * d0_kh2 * V(0.5)
+            + d0_kh2 * V(p.f0re);
+      num_re = num_re + half_d0_norm_kh2;
+    }
+
+    inv_denom = V(1.0) / denom;
+    norm = (num_re * num_re + num_im * num_im) * inv_denom * inv_denom;
+  }
+};
+
+/// Most terms of the asymptotic series of F1 a kernel evaluates
+const unsigned asymptotic_max_terms = 16;
+
+/// Coefficients (2n - 1)!!/2^n of F1(z) = sum_n c_n z^(-2n-2) / 2 for large
+/// z, the expansion of Dawson(z) ~ 1/(2z) (1 + 1/(2z^2) + 3/(4z^4) + ...);
+/// all exact in double precision
+const double asymptotic_f1_coeffs[asymptotic_max_terms] = {
+  1.0, 1.0 / 2, 3.0 / 4, 15.0 / 8, 105.0 / 16, 945.0 / 32, 10395.0 / 64,
+  135135.0 / 128, 2027025.0 / 256, 34459425.0 / 512, 654729075.0 / 1024,
+  13749310575.0 / 2048, 316234143225.0 / 4096, 7905853580625.0 / 8192,
+  213458046676875.0 / 16384, 6190283353629375.0 / 32768
+};
+
+inline const double* spline_coeffs(const LednickyKernelParams &p, double) { return p.spline_coeffs; }
+inline const float* spline_coeffs(const LednickyKernelParams &p, float) { return p.spline_coeffs_float; }
+
+/// Cubic at `u` of the coefficients c[row + i] of fspline.h
+template <typename V>
+inline V
+f_spline_cubic(const typename V::scalar_t *c, typename V::index_t row, V u)
+{
+  using simd::fma;
+  return fma(fma(fma(simd::gather(c + 3, row), u,
+                     simd::gather(c + 2, row)), u,
+                 simd::gather(c + 1, row)), u,
+             simd::gather(c, row));
+}
+
+/// Radius-only terms for one register of k* values
+template <typename V>
+inline void
+basis_lanes(const LednickyKernelParams &p, V k, V &f1, V &f2, V &gauss)
+{
+  using simd::fma;
+
+  // z is clamped away from zero so both F1 and F2 reach their k*->0 limits
+  typedef typename V::scalar_t T;
+  const V z = simd::max(V(p.z_scale) * k, V(std::numeric_limits<T>::min()));
+
+  // past the femtoscopic region neither the Dawson function nor the
+  // exponential is needed; k* grids are sorted, so registers rarely mix
+  if (simd::all(z >= V(p.asymptotic_z))) {
+    const V inv_z = V(1.0) / z,
+            u = inv_z * inv_z,
+            u2 = u * u;
+
+    // even and odd coefficients as two independent chains in u^2; a zero
+    // coefficient pads an odd number of terms
+    const int pairs = (p.asymptotic_terms + 1) / 2;
+    V even = V(asymptotic_f1_coeffs[2 * pairs - 2]),
+      odd = V(2 * pairs - 1 < static_cast<int>(p.asymptotic_terms)
+              ? asymptotic_f1_coeffs[2 * pairs - 1] : 0.0);
+    for (int n = pairs - 2; n >= 0; --n) {
+      even = fma(even, u2, V(asymptotic_f1_coeffs[2 * n]));
+      odd = fma(odd, u2, V(asymptotic_f1_coeffs[2 * n + 1]));
+    }
+    f1 = V(0.5) * u * fma(odd, u, even);
+    f2 = inv_z;
+    gauss = V(0.0);
+    return;
+  }
+
+  if (simd::all(z < V(p.spline_z))) {
+    // the index is clamped for z rounding up to the end of the table
+    const T *c = spline_coeffs(p, T());
+    const V t = z * V(F_SPLINE_INTERVALS / F_SPLINE_Z_MAX),
+            n = simd::truncate(simd::min(t, V(F_SPLINE_INTERVALS - 1))),
+            u = t - n;
+    const typename V::index_t row = simd::to_index(n * V(F_SPLINE_STRIDE));
+    f1 = f_spline_cubic(c, row, u);
+    f2 = z * f_spline_cubic(c + 4, row, u);
+    gauss = V(1.0) - z * f2;
+    return;
+  }
+
+  gauss = simd::exp(-(z * z));
+  f1 = V(faddeeva_spi2) * w_im_lanes(z) / z;
+  f2 = (V(1.0) - gauss) / z;
+}
+
+/// Correlation function for one register, from amplitude and radius terms
+template <typename V, unsigned Flags>
+inline V
+combine_lanes(const LednickyKernelParams &p, const AmplitudeLanes<V, Flags> &f, V f1, V f2, V gauss)
+{
+  V cf = V(p.amp_factor) * f.norm
+       + V(p.f1_factor) * f.num_re * f.inv_denom * f1
+       - V(p.f2_factor) * f.num_im * f.inv_denom * f2;
+
+  if (Flags & KERNEL_IDENTICAL) {
+    // identical spin 1/2 particles get suppressed by 1/2
+    cf = V(0.5) * (cf - gauss);
+  }
+
+  return cf + V(1.0);
+}
+
+template <typename V, unsigned Flags>
+inline V
+lednicky_cf_lanes(const LednickyKernelParams &p, V k)
+{
+  V f1, f2, gauss;
+  basis_lanes(p, k, f1, f2, gauss);
+  return combine_lanes(p, AmplitudeLanes<V, Flags>(p, k), f1, f2, gauss);
+}
+
+/*
+ * The kernels below run V::width bins at a time and finish the remainder
+ * one bin at a time with the scalar lanes of the same precision.
+ */
+
+template <typename V, unsigned Flags>
+inline void
+lednicky_cf_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar, typename V::scalar_t *cf, std::size_t i)
+{
+  lednicky_cf_lanes<V, Flags>(p, V::load(kstar + i)).store(cf + i);
+}
+
+template <typename V, unsigned Flags>
+void
+lednicky_cf_kernel(const LednickyKernelParams &params,
+                   const typename V::scalar_t *kstar,
+                   typename V::scalar_t *cf,
+                   std::size_t count)
+{
+  // a local copy cannot alias `cf`, so the constants stay in registers
+  const LednickyKernelParams p = params;
+
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_cf_step<V, Flags>(p, kstar, cf, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_cf_step<typename V::tail_t, Flags>(p, kstar, cf, i);
+  }
+}
+
+template <typename V>
+inline void
+lednicky_basis_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                    typename V::scalar_t *f1, typename V::scalar_t *f2, typename V::scalar_t *gauss, std::size_t i)
+{
+  V f1_v, f2_v, gauss_v;
+  basis_lanes(p, V::load(kstar + i), f1_v, f2_v, gauss_v);
+  f1_v.store(f1 + i);
+  f2_v.store(f2 + i);
+  gauss_v.store(gauss + i);
+}
+
+template <typename V>
+void
+lednicky_basis_kernel(const LednickyKernelParams &p,
+                      const typename V::scalar_t *kstar,
+                      typename V::scalar_t *f1,
+                      typename V::scalar_t *f2,
+                      typename V::scalar_t *gauss,
+                      std::size_t count)
+{
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_basis_step<V>(p, kstar, f1, f2, gauss, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_basis_step<typename V::tail_t>(p, kstar, f1, f2, gauss, i);
+  }
+}
+
+template <typename V, unsigned Flags>
+inline void
+lednicky_cf_basis_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                       const typename V::scalar_t *f1, const typename V::scalar_t *f2, const typename V::scalar_t *gauss,
+                       typename V::scalar_t *cf, std::size_t i)
+{
+  const V k = V::load(kstar + i);
+
+  // exp(-z^2) is only read for identical particles
+  const V gauss_v = (Flags & KERNEL_IDENTICAL) ? V::load(gauss + i) : V(0.0);
+
+  combine_lanes(p, AmplitudeLanes<V, Flags>(p, k),
+                V::load(f1 + i), V::load(f2 + i), gauss_v).store(cf + i);
+}
+
+template <typename V, unsigned Flags>
+void
+lednicky_cf_basis_kernel(const LednickyKernelParams &params,
+                         const typename V::scalar_t *kstar,
+                         const typename V::scalar_t *f1,
+                         const typename V::scalar_t *f2,
+                         const typename V::scalar_t *gauss,
+                         typename V::scalar_t *cf,
+                         std::size_t count)
+{
+  // a local copy cannot alias `cf`, so the constants stay in registers
+  const LednickyKernelParams p = params;
+
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_cf_basis_step<V, Flags>(p, kstar, f1, f2, gauss, cf, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_cf_basis_step<typename V::tail_t, Flags>(p, kstar, f1, f2, gauss, cf, i);
+  }
+}
+
+/**
+ * C(k*) and its derivatives in R, f0re, f0im and d0 for one register, in
+ * a single forward-mode pass over the same terms as lednicky_cf_lanes().
+ *
+ * The amplitude is written as f = f0 q with q = 1/(1 + f0 (d0 k^2/2 - ik)),
+ * so df/df0re = q^2, df/df0im = i q^2 and df/dd0 = -f^2 k^2/2, and
+ * C = A |f|^2 + B F1 Re f - E F2 Im f changes with f as
+ * dC = (2A Re f + B F1) Re df + (2A Im f - E F2) Im df. The radius enters
+ * through A, B = 2/(sqrt(pi) R), E = 1/R and z = 2kR; with
+ * Dawson'(z) = 1 - 2z Dawson(z),
+ *
+ *   R dF1/dR = 1 - (1 + 2z^2) F1,    R dF2/dR = 2z exp(-z^2) - F2.
+ */
+template <typename V>
+inline void
+jacobian_lanes(const LednickyKernelParams &p, V k, V f1, V f2, V gauss,
+               V &cf, V &dradius, V &df0re, V &df0im, V &dd0)
+{
+  using simd::fma;
+
+  const V kh = k * V(kernel_inv_hbarc),
+          w_re = V(0.5 * p.d0) * kh * kh;
+
+  // den = 1 + f0 (w_re - i kh), q = 1/den
+  const V den_re = fma(V(p.f0re), w_re, fma(V(p.f0im), kh, V(1.0))),
+          den_im = V(p.f0im) * w_re - V(p.f0re) * kh,
+          inv_den2 = V(1.0) / fma(den_re, den_re, den_im * den_im),
+          q_re = den_re * inv_den2,
+          q_im = -(den_im * inv_den2);
+
+  const V f_re = V(p.f0re) * q_re - V(p.f0im) * q_im,
+          f_im = fma(V(p.f0re), q_im, V(p.f0im) * q_re),
+          norm = fma(f_re, f_re, f_im * f_im);
+
+  const V A = V(p.amp_factor),
+          B_f1 = V(p.f1_factor) * f1,
+          E_f2 = V(p.f2_factor) * f2;
+
+  cf = A * norm + B_f1 * f_re - E_f2 * f_im;
+
+  // dC = g_re Re df + g_im Im df
+  const V g_re = fma(V(2.0) * A, f_re, B_f1),
+          g_im = fma(V(2.0) * A, f_im, -E_f2);
+
+  const V q2_re = q_re * q_re - q_im * q_im,
+          q2_im = V(2.0) * q_re * q_im;
+  df0re = g_re * q2_re + g_im * q2_im;
+  df0im = g_im * q2_re - g_re * q2_im;
+
+  // df/dd0 = -k^2/2 f^2
+  const V half_kh2 = V(-0.5) * kh * kh,
+          fsq_re = f_re * f_re - f_im * f_im,
+          fsq_im = V(2.0) * f_re * f_im;
+  dd0 = half_kh2 * (g_re * fsq_re + g_im * fsq_im) + V(p.amp_factor_dd0) * norm;
+
+  typedef typename V::scalar_t T;
+  const V z = simd::max(V(p.z_scale) * k, V(std::numeric_limits<T>::min())),
+          z2 = z * z,
+          inv_R = V(p.f2_factor),
+          R_df1 = V(1.0) - fma(V(2.0), z2, V(1.0)) * f1,
+          R_df2 = V(2.0) * z * gauss - f2;
+  dradius = V(p.amp_factor_dradius) * norm
+          + inv_R * (V(p.f1_factor) * (R_df1 - f1) * f_re
+                     - V(p.f2_factor) * (R_df2 - f2) * f_im);
+
+  if (p.identical) {
+    cf = V(0.5) * (cf - gauss);
+    dradius = fma(V(0.5), dradius, z2 * gauss * inv_R);
+    df0re = V(0.5) * df0re;
+    df0im = V(0.5) * df0im;
+    dd0 = V(0.5) * dd0;
+  }
+
+  cf = cf + V(1.0);
+}
+
+template <typename V>
+inline void
+lednicky_jacobian_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                       typename V::scalar_t *cf, typename V::scalar_t *jacobian,
+                       std::size_t count, std::size_t i)
+{
+  const V k = V::load(kstar + i);
+  V f1, f2, gauss, cf_v, dradius, df0re, df0im, dd0;
+  basis_lanes(p, k, f1, f2, gauss);
+  jacobian_lanes(p, k, f1, f2, gauss, cf_v, dradius, df0re, df0im, dd0);
+  cf_v.store(cf + i);
+  dradius.store(jacobian + i);
+  df0re.store(jacobian + count + i);
+  df0im.store(jacobian + 2 * count + i);
+  dd0.store(jacobian + 3 * count + i);
+}
+
+template <typename V>
+void
+lednicky_jacobian_kernel(const LednickyKernelParams &params,
+                         const typename V::scalar_t *kstar,
+                         typename V::scalar_t *cf,
+                         typename V::scalar_t *jacobian,
+                         std::size_t count)
+{
+  const LednickyKernelParams p = params;
+
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_jacobian_step<V>(p, kstar, cf, jacobian, count, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_jacobian_step<typename V::tail_t>(p, kstar, cf, jacobian, count, i);
+  }
+}
+
+template <typename V>
+inline void
+lednicky_jacobian_basis_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                             const typename V::scalar_t *f1, const typename V::scalar_t *f2,
+                             const typename V::scalar_t *gauss, typename V::scalar_t *cf,
+                             typename V::scalar_t *jacobian, std::size_t count, std::size_t i)
+{
+  V cf_v, dradius, df0re, df0im, dd0;
+  jacobian_lanes(p, V::load(kstar + i), V::load(f1 + i), V::load(f2 + i), V::load(gauss + i),
+                 cf_v, dradius, df0re, df0im, dd0);
+  cf_v.store(cf + i);
+  dradius.store(jacobian + i);
+  df0re.store(jacobian + count + i);
+  df0im.store(jacobian + 2 * count + i);
+  dd0.store(jacobian + 3 * count + i);
+}
+
+template <typename V>
+void
+lednicky_jacobian_basis_kernel(const LednickyKernelParams &params,
+                               const typename V::scalar_t *kstar,
+                               const typename V::scalar_t *f1,
+                               const typename V::scalar_t *f2,
+                               const typename V::scalar_t *gauss,
+                               typename V::scalar_t *cf,
+                               typename V::scalar_t *jacobian,
+                               std::size_t count)
+{
+  const LednickyKernelParams p = params;
+
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_jacobian_basis_step<V>(p, kstar, f1, f2, gauss, cf, jacobian, count, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_jacobian_basis_step<typename V::tail_t>(p, kstar, f1, f2, gauss, cf, jacobian, count, i);
+  }
+}
+
+/// h(1/x) of coulomb.h for a register of x >= 0, from the table of
+/// coulomb_h_coeffs() and the series on either side of it
+template <typename V>
+inline V
+coulomb_h_lanes(V x, const typename V::scalar_t *coeffs)
+{
+  using simd::fma;
+  typedef typename V::scalar_t T;
+
+  const V x2 = x * x,
+          inv_x2 = V(1.0) / x2,
+          log_x = simd::log(simd::max(x, V(std::numeric_limits<T>::min())));
+
+  // x < COULOMB_H_X_MIN: sum_n |B_2n|/(2n) x^2n
+  const V small = x2 * fma(fma(fma(fma(fma(V(691.0 / 32760), x2,
+                                           V(1.0 / 132)), x2,
+                                       V(1.0 / 240)), x2,
+                                   V(1.0 / 252)), x2,
+                               V(1.0 / 120)), x2,
+                           V(1.0 / 12));
+
+  // x > COULOMB_H_X_MAX: ln x - gamma + sum_m (-1)^(m+1) zeta(2m+1) / x^2m
+  const V large = log_x - V(0.57721566490153286061)
+                + inv_x2 * (V(1.2020569031595942854)
+                            - inv_x2 * (V(1.0369277551433699263)
+                                        - inv_x2 * (V(1.0083492773819228268)
+                                                    - inv_x2 * (V(1.0020083928260822144)
+                                                                - inv_x2 * (V(1.0004941886041194646)
+                                                                            - inv_x2 * V(1.0001227133475784891))))));
+
+  // cubic in the position within the interval of ln x; the index is
+  // clamped so the lanes of the series still gather in bounds
+  const double t_min = std::log(COULOMB_H_X_MIN),
+               inv_step = COULOMB_H_INTERVALS / (std::log(COULOMB_H_X_MAX) - t_min);
+  const V t = simd::max((log_x - V(t_min)) * V(inv_step), V(0.0)),
+          n = simd::truncate(simd::min(t, V(COULOMB_H_INTERVALS - 1))),
+          u = t - n;
+  const typename V::index_t row = simd::to_index(n * V(4.0));
+  const V table = fma(fma(fma(simd::gather(coeffs + 3, row), u,
+                              simd::gather(coeffs + 2, row)), u,
+                          simd::gather(coeffs + 1, row)), u,
+                      simd::gather(coeffs, row));
+
+  const V result = simd::select(x < V(COULOMB_H_X_MIN), small, table);
+  return simd::select(x > V(COULOMB_H_X_MAX), large, result);
+}
+
+/// Gamow factor w / (exp(w) - 1) for a register of w = 2 pi eta
+template <typename V>
+inline V
+gamow_lanes(V w)
+{
+  using simd::fma;
+  typedef typename V::scalar_t T;
+
+  // exp() saturates beyond, where the factor is 0 to all digits
+  const double limit = (sizeof(T) == sizeof(float)) ? 80.0 : 700.0;
+  w = simd::min(w, V(limit));
+
+  // 1 - w/2 + sum_n B_2n w^2n / (2n)!, for the cancellation near w = 0
+  const V w2 = w * w,
+          series = fma(w2, fma(w2, fma(w2, fma(w2, V(-1.0 / 1209600), V(1.0 / 30240)),
+                                       V(-1.0 / 720)),
+                               V(1.0 / 12)),
+                       V(1.0) - V(0.5) * w);
+
+  return simd::select(simd::abs(w) < V(0.25), series, w / (simd::exp(w) - V(1.0)));
+}
+
+/// Per-curve state of lednicky_coulomb_kernel(): the tables, and the
+/// finite-size Coulomb integrals interpolated to the p = R/a_c of the curve
+/// on panels first..last of x
+template <typename T>
+struct CoulombCurve {
+  const T *h_coeffs;
+  const T *panels;
+  int first;
+  int last;
+
+  /// COULOMB_SOURCE_STRIDE coefficients per panel, as in the table
+  alignas(64) T source[COULOMB_SOURCE_PANELS * COULOMB_SOURCE_STRIDE];
+
+  /// R, 1/R^2 and d0/(4 sqrt(pi) R^3)
+  double radius;
+  double inv_radius2;
+  double d0_term;
+};
+
+/// The table of coulomb_source_coeffs() at the p nodes summed with
+/// `weights` into out, for panels first..last
+template <typename V>
+inline void
+coulomb_source_collapse(const typename V::scalar_t *table, const typename V::scalar_t *weights,
+                        int first, int last, typename V::scalar_t *out)
+{
+  using simd::fma;
+  typedef typename V::scalar_t T;
+  typedef typename V::tail_t V1;
+  const int W = V::width;
+
+  for (int n = first; n <= last; ++n) {
+    const T *panel = table + n * COULOMB_SOURCE_P_NODES * COULOMB_SOURCE_STRIDE;
+    T *o = out + n * COULOMB_SOURCE_STRIDE;
+    int i = 0;
+    for (; i + W <= COULOMB_SOURCE_STRIDE; i += W) {
+      V sum(0.0);
+      for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+        sum = fma(V(weights[j]), V::load(panel + j * COULOMB_SOURCE_STRIDE + i), sum);
+      }
+      sum.store(o + i);
+    }
+    for (; i < COULOMB_SOURCE_STRIDE; ++i) {
+      V1 sum(0.0);
+      for (int j = 0; j < COULOMB_SOURCE_P_NODES; ++j) {
+        sum = fma(V1(weights[j]), V1::load(panel + j * COULOMB_SOURCE_STRIDE + i), sum);
+      }
+      sum.store(o + i);
+    }
+  }
+}
+
+/// The finite-size Coulomb integrals of coulomb.h for a register of
+/// x = k* R within the table, from the polynomials of the curve
+template <typename V>
+inline void
+coulomb_source_lanes(const CoulombCurve<typename V::scalar_t> &c, V x,
+                     V (&integrals)[COULOMB_SOURCE_INTEGRALS])
+{
+  using simd::fma;
+  typedef typename V::scalar_t T;
+  const int order = COULOMB_SOURCE_DEGREE + 1;
+
+  // [0, 1/4), [1/4, 1/2), then sqrt(2) apart as coulomb_source_panel(),
+  // clamped to the panels of the curve, which hold all of its x up to the
+  // rounding of the logarithm
+  const V small = simd::truncate(V(4.0) * x),
+          large = V(2.0) + simd::truncate(V(2.0 / M_LN2) * simd::log(simd::max(V(2.0) * x, V(1.0)))),
+          n = simd::min(simd::max(simd::select(x < V(0.5), small, large), V(c.first)), V(c.last));
+
+  // k* grids are sorted, so a register mostly lies on one panel and its
+  // coefficients are broadcast rather than gathered
+  T lanes[V::width];
+  n.store(lanes);
+  const V n0(lanes[0]);
+  if (simd::all(n <= n0) && simd::all(n >= n0)) {
+    const int panel = static_cast<int>(lanes[0]);
+    const T *row = c.source + panel * COULOMB_SOURCE_STRIDE;
+    const V t = (x - V(c.panels[2 * panel])) * V(c.panels[2 * panel + 1]);
+    for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+      const T *coeffs = row + f * order;
+      V sum(coeffs[order - 1]);
+      for (int i = order - 2; i >= 0; --i) {
+        sum = fma(sum, t, V(coeffs[i]));
+      }
+      integrals[f] = sum;
+    }
+    return;
+  }
+
+  const typename V::index_t row = simd::to_index(n * V(COULOMB_SOURCE_STRIDE)),
+                            panel = simd::to_index(n * V(2.0));
+  const V t = (x - simd::gather(c.panels, panel)) * simd::gather(c.panels + 1, panel);
+  for (int f = 0; f < COULOMB_SOURCE_INTEGRALS; ++f) {
+    const T *coeffs = c.source + f * order;
+    V sum = simd::gather(coeffs + order - 1, row);
+    for (int i = order - 2; i >= 0; --i) {
+      sum = fma(sum, t, simd::gather(coeffs + i, row));
+    }
+    integrals[f] = sum;
+  }
+}
+
+/**
+ * C(k*) of a charged pair for one register, in the Lednicky-Lyuboshits
+ * model: the Coulomb wave averaged over the source, with the s-wave
+ * replaced by the one of the Coulomb-modified amplitude
+ *
+ *   1/f_c = 1/f0 + d0 k^2/2 - 2h(eta)/a_c - i k A_c(eta).
+ *
+ * With the integrals of coulomb.h at x = k* R, p = R/a_c and
+ * g = W f_c = R + (beta + i x A_c) f_c, where W is the coefficient of phi
+ * in the s-wave and beta = 2p (ln 2|p| + 2 gamma - 1 + h),
+ *
+ *   C = A_c [T0 + S],  S = (|f_c|^2 Y_22 + 2 Re(g f_c*) Y_2phi
+ *                           + |g|^2 Y_phiphi)/R^2 - Y_phiphi
+ *                          - |f_c|^2 d0/(4 sqrt(pi) R^3),
+ *
+ * and C = A_c [T0 - Q/2 + S/2] for identical spin 1/2 particles. Past
+ * the table the integrals take their leading large-x terms.
+ */
+template <typename V>
+inline V
+lednicky_coulomb_lanes(const LednickyKernelParams &p, const CoulombCurve<typename V::scalar_t> &c, V k)
+{
+  using simd::fma;
+
+  const V kh = k * V(kernel_inv_hbarc),
+          x = V(0.5 * p.z_scale) * k,
+          coulomb_x = V(p.coulomb_x_scale) * k,
+          gamow = gamow_lanes(V(p.gamow_scale) / coulomb_x),
+          h = coulomb_h_lanes(coulomb_x, c.h_coeffs);
+
+  const V den_re = fma(V(0.5 * p.d0) * kh, kh, fma(V(-p.coulomb_h_factor), h, V(p.inv_f0_re))),
+          den_im = V(p.inv_f0_im) - kh * gamow,
+          inv_den2 = V(1.0) / fma(den_re, den_re, den_im * den_im),
+          f_re = den_re * inv_den2,
+          f_im = -(den_im * inv_den2),
+          beta = fma(V(2.0 * p.coulomb_p), h, V(p.coulomb_beta0)),
+          x_gamow = x * gamow;
+
+  V s[COULOMB_SOURCE_INTEGRALS];
+  coulomb_source_lanes(c, x, s);
+
+  if (!simd::all(x <= V(COULOMB_SOURCE_X_MAX))) {
+    // A_c T0 = 1 - p/(sqrt(pi) x^2), A_c Q = p/(8 sqrt(pi) x^4),
+    // A_c Y_phiphi = 1/(4x^2), and in terms of y2 + beta phi, Y_2phi + beta
+    // Y_phiphi = D(2x)/(2 sqrt(pi) x) and its square A_c/4
+    const V inv_x2 = V(1.0) / (x * x),
+            inv_gamow = V(1.0) / gamow,
+            phi_phi = V(0.25) * inv_x2 * inv_gamow,
+            g_phi = V(0.125 / std::sqrt(M_PI)) * inv_x2 * fma(V(0.125), inv_x2, V(1.0)),
+            g_g = V(0.25) * gamow,
+            beta_phi_phi = beta * phi_phi;
+    const auto far = x > V(COULOMB_SOURCE_X_MAX);
+    s[COULOMB_SOURCE_T0] = simd::select(far, (V(1.0) - V(p.coulomb_p / std::sqrt(M_PI)) * inv_x2) * inv_gamow,
+                                        s[COULOMB_SOURCE_T0]);
+    s[COULOMB_SOURCE_Q] = simd::select(far, V(0.125 * p.coulomb_p / std::sqrt(M_PI)) * inv_x2 * inv_x2 * inv_gamow,
+                                       s[COULOMB_SOURCE_Q]);
+    s[COULOMB_SOURCE_PHI_PHI] = simd::select(far, phi_phi, s[COULOMB_SOURCE_PHI_PHI]);
+    s[COULOMB_SOURCE_Y2_PHI] = simd::select(far, g_phi - beta_phi_phi, s[COULOMB_SOURCE_Y2_PHI]);
+    s[COULOMB_SOURCE_Y2_Y2] = simd::select(far, g_g - beta * (V(2.0) * g_phi - beta_phi_phi),
+                                           s[COULOMB_SOURCE_Y2_Y2]);
+  }
+
+  // g = R + (beta + i x A_c) f_c stays finite as f_c -> 0
+  const V g_re = V(c.radius) + beta * f_re - x_gamow * f_im,
+          g_im = fma(beta, f_im, x_gamow * f_re),
+          f_norm = fma(f_re, f_re, f_im * f_im),
+          g_f = fma(g_re, f_re, g_im * f_im),
+          g_norm = fma(g_re, g_re, g_im * g_im),
+          swave = fma(f_norm, s[COULOMB_SOURCE_Y2_Y2],
+                      fma(V(2.0) * g_f, s[COULOMB_SOURCE_Y2_PHI], g_norm * s[COULOMB_SOURCE_PHI_PHI]))
+                  * V(c.inv_radius2)
+                - s[COULOMB_SOURCE_PHI_PHI] - f_norm * V(c.d0_term);
+
+  if (p.identical) {
+    return gamow * (s[COULOMB_SOURCE_T0] + V(0.5) * (swave - s[COULOMB_SOURCE_Q]));
+  }
+  return gamow * (s[COULOMB_SOURCE_T0] + swave);
+}
+
+template <typename V>
+inline void
+lednicky_coulomb_step(const LednickyKernelParams &p, const CoulombCurve<typename V::scalar_t> &c,
+                      const typename V::scalar_t *kstar, typename V::scalar_t *cf, std::size_t i)
+{
+  lednicky_coulomb_lanes<V>(p, c, V::load(kstar + i)).store(cf + i);
+}
+
+template <typename V>
+void
+lednicky_coulomb_kernel(const LednickyKernelParams &params,
+                        const typename V::scalar_t *kstar,
+                        typename V::scalar_t *cf,
+                        std::size_t count)
+{
+  typedef typename V::scalar_t T;
+  const LednickyKernelParams p = params;
+  if (count == 0) {
+    return;
+  }
+
+  CoulombCurve<T> c;
+  c.h_coeffs = coulomb_h_coeffs(T());
+  c.panels = coulomb_source_panels(T());
+  c.radius = 1.0 / p.f2_factor;
+  c.inv_radius2 = p.f2_factor * p.f2_factor;
+  c.d0_term = -p.d0 * p.amp_factor_dd0;
+
+  // only the panels the k* of the curve fall on are interpolated to its p
+  T k_min = kstar[0], k_max = kstar[0];
+  for (std::size_t i = 1; i < count; ++i) {
+    k_min = std::min(k_min, kstar[i]);
+    k_max = std::max(k_max, kstar[i]);
+  }
+  c.first = coulomb_source_panel(0.5 * p.z_scale * k_min);
+  c.last = coulomb_source_panel(0.5 * p.z_scale * k_max);
+
+  double weights[COULOMB_SOURCE_P_NODES];
+  T weights_t[COULOMB_SOURCE_P_NODES];
+  coulomb_source_weights(p.coulomb_p, weights);
+  std::copy(weights, weights + COULOMB_SOURCE_P_NODES, weights_t);
+  coulomb_source_collapse<V>(coulomb_source_coeffs(T()), weights_t, c.first, c.last, c.source);
+
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    lednicky_coulomb_step<V>(p, c, kstar, cf, i);
+  }
+  for (; i < count; ++i) {
+    lednicky_coulomb_step<typename V::tail_t>(p, c, kstar, cf, i);
+  }
+}
+
+/*
+ * Goodness of fit statistics. The reduction kernels below scale the curve
+ * of one register to the model M = (1 + (C-1) lambda)/N and add up
+ * S::term(M, data, aux) in registers, so the curve never goes through
+ * memory. Both sums are kept in the precision of the kernel.
+ */
+
+/// ((y - M) / error)^2
+struct Chi2Statistic {
+  template <typename V>
+  static V
+  term(V model, V y, V error)
+  {
+    const V r = (y - model) / error;
+    return r * r;
+  }
+};
+
+/// 2 (mu - n + n log(n/mu)) of `n` counts with expectation mu = M reference
+struct PoissonStatistic {
+  template <typename V>
+  static V
+  term(V model, V n, V reference)
+  {
+    typedef typename V::scalar_t T;
+    const V mu = model * reference;
+
+    // n log(n/mu) vanishes for empty bins
+    const V ratio = simd::max(n, V(std::numeric_limits<T>::min())) / mu;
+    return V(2.0) * (mu - n + n * simd::log(ratio));
+  }
+};
+
+template <typename V, unsigned Flags, typename S>
+inline V
+lednicky_statistic_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                        const typename V::scalar_t *data, const typename V::scalar_t *aux,
+                        std::size_t i)
+{
+  const V cf = lednicky_cf_lanes<V, Flags>(p, V::load(kstar + i));
+  return S::term(simd::fma(V(p.model_scale), cf, V(p.model_offset)),
+                 V::load(data + i), V::load(aux + i));
+}
+
+template <typename V, unsigned Flags, typename S>
+double
+lednicky_statistic_kernel(const LednickyKernelParams &params,
+                          const typename V::scalar_t *kstar,
+                          const typename V::scalar_t *data,
+                          const typename V::scalar_t *aux,
+                          std::size_t count)
+{
+  typedef typename V::tail_t V1;
+  const LednickyKernelParams p = params;
+
+  V total(0.0);
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    total = total + lednicky_statistic_step<V, Flags, S>(p, kstar, data, aux, i);
+  }
+
+  V1 tail(0.0);
+  for (; i < count; ++i) {
+    tail = tail + lednicky_statistic_step<V1, Flags, S>(p, kstar, data, aux, i);
+  }
+
+  return static_cast<double>(simd::sum(total)) + simd::sum(tail);
+}
+
+template <typename V, unsigned Flags, typename S>
+inline V
+lednicky_statistic_basis_step(const LednickyKernelParams &p, const typename V::scalar_t *kstar,
+                              const typename V::scalar_t *f1, const typename V::scalar_t *f2,
+                              const typename V::scalar_t *gauss, const typename V::scalar_t *data,
+                              const typename V::scalar_t *aux, std::size_t i)
+{
+  const V k = V::load(kstar + i),
+          gauss_v = (Flags & KERNEL_IDENTICAL) ? V::load(gauss + i) : V(0.0),
+          cf = combine_lanes(p, AmplitudeLanes<V, Flags>(p, k),
+                             V::load(f1 + i), V::load(f2 + i), gauss_v);
+  return S::term(simd::fma(V(p.model_scale), cf, V(p.model_offset)),
+                 V::load(data + i), V::load(aux + i));
+}
+
+template <typename V, unsigned Flags, typename S>
+double
+lednicky_statistic_basis_kernel(const LednickyKernelParams &params,
+                                const typename V::scalar_t *kstar,
+                                const typename V::scalar_t *f1,
+                                const typename V::scalar_t *f2,
+                                const typename V::scalar_t *gauss,
+                                const typename V::scalar_t *data,
+                                const typename V::scalar_t *aux,
+                                std::size_t count)
+{
+  typedef typename V::tail_t V1;
+  const LednickyKernelParams p = params;
+
+  V total(0.0);
+  std::size_t i = 0;
+  for (; i + V::width <= count; i += V::width) {
+    total = total + lednicky_statistic_basis_step<V, Flags, S>(p, kstar, f1, f2, gauss, data, aux, i);
+  }
+
+  V1 tail(0.0);
+  for (; i < count; ++i) {
+    tail = tail + lednicky_statistic_basis_step<V1, Flags, S>(p, kstar, f1, f2, gauss, data, aux, i);
+  }
+
+  return static_cast<double>(simd::sum(total)) + simd::sum(tail);
+}
+
+} // anonymous namespace
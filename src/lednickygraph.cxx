@@ -0,0 +1,22 @@
+///
+/// \file lednickygraph.cxx
+/// \brief Implementation of the ROOT graph helpers
+///
+
+#include "lednickygraph.h"
+
+TGraph*
+GetLednickyEqn(const LednickyEquation_s& eq)
+{
+  // Make a TGraph of the correlation function, filled in place
+  TGraph *cfGraph = new TGraph(eq.totalBins);
+  generate_lednicky_equation(eq, cfGraph->GetX(), cfGraph->GetY());
+  return cfGraph;
+}
+
+void
+GetLednickyEqn(const LednickyEquation_s& eq, TGraph& graph)
+{
+  graph.Set(eq.totalBins);
+  generate_lednicky_equation(eq, graph.GetX(), graph.GetY());
+}
@@ -0,0 +1,21 @@
+///
+/// \file lednickygraph.h
+/// \brief ROOT graphs of the Lednicky correlation function
+///
+/// Kept out of liblednicky so that only the plotting frontend links ROOT.
+///
+
+#pragma once
+
+#include "lednicky.h"
+
+#include <TGraph.h>
+
+/// Correlation function of `eq` on its bin centres as a new TGraph, owned
+/// by the caller
+TGraph* GetLednickyEqn(const LednickyEquation_s& eq);
+
+/// Correlation function of `eq` on its bin centres, written into `graph`.
+/// The points of `graph` are only reallocated if its size differs from
+/// `eq.totalBins`.
+void GetLednickyEqn(const LednickyEquation_s& eq, TGraph& graph);
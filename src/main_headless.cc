@@ -0,0 +1,28 @@
+///
+/// \file main_headless.cc
+/// \brief lednicky-headless: the command line tool without ROOT
+///
+/// Accepts the same options as `lednicky`, but always writes text output
+/// (the curve, or the scan) and only links liblednicky, so it starts in
+/// milliseconds.
+///
+
+#include "cli.h"
+
+int
+main(int argc, char **argv)
+{
+  const std::vector<std::string> argvv(argv, argv+argc);
+  const ProgramOptions args = parse_args(argvv);
+
+  if (args.fit_mode) {
+    return run_fit(args);
+  }
+  if (args.batch_mode) {
+    return run_batch(args);
+  }
+  if (args.scan_mode) {
+    return run_scan(args);
+  }
+  return run_headless(args);
+}
@@ -0,0 +1,81 @@
+///
+/// \file residuals.cxx
+/// \brief Implementation of LednickyResiduals
+///
+
+#include "residuals.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+const std::size_t LednickyResiduals::RESIDUAL_BLOCK_ROWS;
+
+LednickyResiduals::LednickyResiduals():
+  _bohr_radius(0.0)
+{
+}
+
+std::size_t
+LednickyResiduals::add_parent(const ResidualParent& parent)
+{
+  if (parent.kstar.size() != parent.transform.cols()) {
+    throw std::invalid_argument("residual parent k* axis does not match its transformation");
+  }
+  _parents.push_back(parent);
+  _bases.push_back(LednickyBasis());
+  _excess.push_back(std::vector<double>(parent.kstar.size()));
+  return _parents.size() - 1;
+}
+
+void
+LednickyResiduals::evaluate(const LednickyEquation_s& primary,
+                            const double *kstar,
+                            double *cf,
+                            std::size_t count)
+{
+  for (std::size_t j = 0; j < _parents.size(); ++j) {
+    if (_parents[j].transform.rows() != count) {
+      throw std::invalid_argument("residual transformation does not match the daughter bins");
+    }
+  }
+
+  // parent curves on their own axes, as C_j - 1
+  for (std::size_t j = 0; j < _parents.size(); ++j) {
+    const ResidualParent& parent = _parents[j];
+    std::vector<double>& excess = _excess[j];
+    excess.resize(parent.kstar.size());
+    if (parent.bohr_radius != 0.0) {
+      evaluate_lednicky_coulomb(parent.eq, parent.bohr_radius,
+                                parent.kstar.data(), excess.data(), excess.size());
+    } else {
+      _bases[j].evaluate(parent.eq, parent.kstar.data(), excess.data(), excess.size());
+    }
+    for (std::size_t k = 0; k < excess.size(); ++k) {
+      excess[k] -= 1.0;
+    }
+  }
+
+  if (_bohr_radius != 0.0) {
+    evaluate_lednicky_coulomb(primary, _bohr_radius, kstar, cf, count);
+  } else {
+    _basis.evaluate(primary, kstar, cf, count);
+  }
+
+  const double lambda = primary.lamPrimary,
+               inv_norm = 1.0 / primary.normalization;
+
+  for (std::size_t begin = 0; begin < count; begin += RESIDUAL_BLOCK_ROWS) {
+    const std::size_t end = std::min(count, begin + RESIDUAL_BLOCK_ROWS);
+
+    for (std::size_t i = begin; i < end; ++i) {
+      cf[i] = lambda * (cf[i] - 1.0);
+    }
+    for (std::size_t j = 0; j < _parents.size(); ++j) {
+      _parents[j].transform.multiply_add(_excess[j].data(), _parents[j].eq.lamPrimary,
+                                         cf, begin, end);
+    }
+    for (std::size_t i = begin; i < end; ++i) {
+      cf[i] = (1.0 + cf[i]) * inv_norm;
+    }
+  }
+}
@@ -0,0 +1,109 @@
+///
+/// \file residuals.h
+/// \brief Residual (feed-down) correlations on top of the primary
+///        Lednicky correlation function
+///
+
+#pragma once
+
+#include "lednicky.h"
+#include "banded.h"
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * ResidualParent
+ * \brief A parent pair feeding down into the measured pair.
+ *
+ * `transform` is the decay transformation matrix: row i holds the weights
+ * of the parent k* bins (columns, at `kstar`) that end up in daughter bin
+ * i. Rows are expected to sum to one (see BandedMatrix::normalize_rows());
+ * the share of the parent in the sample is the lambda parameter,
+ * `eq.lamPrimary`.
+ */
+struct ResidualParent {
+  /// Parent interaction; lamPrimary is the parent's lambda, normalization
+  /// and the binning fields are not read
+  LednickyEquation_s eq;
+
+  /// Parent k* axis (GeV/c), transform.cols() values
+  std::vector<double> kstar;
+
+  /// Daughter bins x parent bins
+  BandedMatrix transform;
+
+  /// Bohr radius (fm) of a charged parent pair, evaluated with
+  /// evaluate_lednicky_coulomb(); zero for a neutral one
+  double bohr_radius {0.0};
+};
+
+/**
+ * LednickyResiduals
+ * \brief The primary correlation function together with the residual
+ *        correlations of any number of parent pairs.
+ *
+ * The model is
+ *
+ *   M(k*) = (1 + lambda (C(k*) - 1) + sum_j lambda_j [T_j (C_j - 1)](k*)) / N
+ *
+ * with C the primary curve of lamPrimary = lambda and normalization N, and
+ * C_j, lambda_j, T_j the curve, lambda and transformation of parent j. At
+ * lambda_j = 0 it is the scaled curve of the other functions.
+ *
+ * Every parent curve is evaluated once per evaluate() on its own k* axis,
+ * through its own LednickyBasis so a fit that only moves f0 or d0 reuses
+ * the radius terms. The transformations are then applied in a single pass
+ * over the daughter bins: block after block of RESIDUAL_BLOCK_ROWS bins,
+ * every parent adds its band to the block while the block stays in cache,
+ * and the block is scaled and finished before the next.
+ *
+ * Not thread-safe; give each thread its own copy.
+ */
+class LednickyResiduals {
+public:
+  /// Daughter bins per block of evaluate()
+  static const std::size_t RESIDUAL_BLOCK_ROWS = 256;
+
+  LednickyResiduals();
+
+  /// Add a parent, returns its index. Throws std::invalid_argument if the
+  /// size of the k* axis is not transform.cols().
+  std::size_t add_parent(const ResidualParent& parent);
+
+  std::size_t size() const { return _parents.size(); }
+
+  /// Parent `index`, e.g. to change its parameters between evaluations;
+  /// its k* axis and transformation must keep their sizes
+  ResidualParent& parent(std::size_t index) { return _parents[index]; }
+  const ResidualParent& parent(std::size_t index) const { return _parents[index]; }
+
+  /// Evaluate the primary curve with the Coulomb interaction
+  /// (evaluate_lednicky_coulomb()) and Bohr radius `bohr_radius` (fm)
+  /// instead of the strong one; zero turns it off
+  void set_bohr_radius(double bohr_radius) { _bohr_radius = bohr_radius; }
+
+  /**
+   * Evaluate M at the `count` daughter k* values `kstar` (GeV/c) into `cf`,
+   * with lambda and normalization from `primary`. Throws
+   * std::invalid_argument if `count` differs from the rows of a
+   * transformation.
+   */
+  void evaluate(const LednickyEquation_s& primary,
+                const double *kstar,
+                double *cf,
+                std::size_t count);
+
+  /// C_j - 1 of parent `index` as of the last evaluate(), on its k* axis
+  const double* parent_excess(std::size_t index) const { return _excess[index].data(); }
+
+private:
+  std::vector<ResidualParent> _parents;
+  std::vector<LednickyBasis> _bases;
+
+  /// C_j - 1 of every parent
+  std::vector<std::vector<double>> _excess;
+
+  LednickyBasis _basis;
+  double _bohr_radius;
+};
@@ -0,0 +1,240 @@
+///
+/// \file scan.cxx
+/// \brief Implementation of LednickyScan
+///
+
+#include "scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+/// Order of the axes in a ScanGrid; the last one varies fastest
+enum ScanAxisIndex {
+  AXIS_RADIUS,
+  AXIS_F0RE,
+  AXIS_F0IM,
+  AXIS_D0,
+  AXIS_LAMBDA,
+  AXIS_COUNT
+};
+
+/// Points handed to a worker thread at a time
+static const std::size_t SCAN_CHUNK = 16;
+
+/// Largest count of a "start:stop:count" range
+static const unsigned long SCAN_AXIS_MAX_COUNT = 10000000;
+
+std::vector<double>*
+ScanGrid::axis(const std::string& name)
+{
+  if (name == "radius") return &radius;
+  if (name == "f0re") return &f0re;
+  if (name == "f0im") return &f0im;
+  if (name == "d0") return &d0;
+  if (name == "lamPrimary" || name == "lambda") return &lamPrimary;
+  return nullptr;
+}
+
+static double
+parse_scan_value(const std::string& str)
+{
+  const char *begin = str.c_str();
+  char *end = nullptr;
+  const double value = std::strtod(begin, &end);
+  if (end == begin || *end != '\0') {
+    throw std::invalid_argument("'" + str + "' is not a number");
+  }
+  return value;
+}
+
+std::vector<double>
+parse_scan_axis(const std::string& spec)
+{
+  std::vector<std::string> fields;
+  char separator = (spec.find(':') != std::string::npos) ? ':' : ',';
+
+  std::stringstream ss(spec);
+  for (std::string field; std::getline(ss, field, separator); ) {
+    fields.push_back(field);
+  }
+
+  std::vector<double> values;
+
+  if (separator == ',') {
+    for (const auto& field : fields) {
+      values.push_back(parse_scan_value(field));
+    }
+  } else {
+    if (fields.size() != 3) {
+      throw std::invalid_argument("range '" + spec + "' is not of the form start:stop:count");
+    }
+    const double start = parse_scan_value(fields[0]),
+                 stop = parse_scan_value(fields[1]);
+    const std::string &count_field = fields[2];
+    unsigned long count = 0;
+    std::size_t end = 0;
+    try {
+      count = std::stoul(count_field, &end);
+    } catch (const std::logic_error&) {
+      end = 0;
+    }
+    // stoul takes "-3" as a huge count, and stops at "3.5"
+    if (end == 0 || end != count_field.size() || count_field.find('-') != std::string::npos) {
+      throw std::invalid_argument("range '" + spec + "' does not end in a count of points");
+    }
+    if (count < 1) {
+      throw std::invalid_argument("range '" + spec + "' has no points");
+    }
+    if (count > SCAN_AXIS_MAX_COUNT) {
+      throw std::invalid_argument("range '" + spec + "' has more than "
+                                  + std::to_string(SCAN_AXIS_MAX_COUNT) + " points");
+    }
+    for (unsigned long i = 0; i < count; ++i) {
+      values.push_back(count == 1 ? start : start + (stop - start) * i / (count - 1));
+    }
+  }
+
+  if (values.empty()) {
+    throw std::invalid_argument("empty axis specification");
+  }
+  return values;
+}
+
+void
+read_scan_grid(std::istream& in, ScanGrid& grid)
+{
+  for (std::string line; std::getline(in, line); ) {
+    line = line.substr(0, line.find('#'));
+    std::replace(line.begin(), line.end(), '=', ' ');
+
+    std::stringstream ss(line);
+    std::string name, spec;
+    if (!(ss >> name)) {
+      continue;
+    }
+    ss >> spec;
+
+    std::vector<double> *axis = grid.axis(name);
+    if (axis == nullptr) {
+      throw std::invalid_argument("unknown scan axis '" + name + "'");
+    }
+    *axis = parse_scan_axis(spec);
+  }
+}
+
+LednickyScan::LednickyScan(const LednickyEquation_s& base, const ScanGrid& grid):
+  _base(base),
+  _size(1),
+  _kstar(base.totalBins)
+{
+  const std::vector<double> *axes[AXIS_COUNT] = {
+    &grid.radius, &grid.f0re, &grid.f0im, &grid.d0, &grid.lamPrimary
+  };
+  const double defaults[AXIS_COUNT] = {
+    base.radius, base.f0re, base.f0im, base.d0, base.lamPrimary
+  };
+
+  for (int a = 0; a < AXIS_COUNT; ++a) {
+    _axes[a] = axes[a]->empty() ? std::vector<double>(1, defaults[a]) : *axes[a];
+    if (_size > std::numeric_limits<std::size_t>::max() / _axes[a].size()) {
+      throw std::invalid_argument("the scan grid has too many points");
+    }
+    _size *= _axes[a].size();
+  }
+
+  for (std::size_t i = 0; i < _kstar.size(); ++i) {
+    _kstar[i] = (i + 0.5) * base.maxKstar / base.totalBins;
+  }
+}
+
+LednickyEquation_s
+LednickyScan::point(std::size_t index) const
+{
+  std::size_t pos[AXIS_COUNT];
+  for (int a = AXIS_COUNT - 1; a >= 0; --a) {
+    pos[a] = index % _axes[a].size();
+    index /= _axes[a].size();
+  }
+
+  LednickyEquation_s eq = _base;
+  eq.radius = _axes[AXIS_RADIUS][pos[AXIS_RADIUS]];
+  eq.f0re = _axes[AXIS_F0RE][pos[AXIS_F0RE]];
+  eq.f0im = _axes[AXIS_F0IM][pos[AXIS_F0IM]];
+  eq.d0 = _axes[AXIS_D0][pos[AXIS_D0]];
+  eq.lamPrimary = _axes[AXIS_LAMBDA][pos[AXIS_LAMBDA]];
+  return eq;
+}
+
+void
+LednickyScan::evaluate(std::size_t first, std::size_t count, double *out, unsigned threads) const
+{
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  const std::size_t chunks = (count + SCAN_CHUNK - 1) / SCAN_CHUNK,
+                    lambdas = _axes[AXIS_LAMBDA].size(),
+                    nbins = bins();
+
+  std::atomic<std::size_t> next_chunk(0);
+
+  auto worker = [&] () {
+    // points differing only in lamPrimary share one unscaled curve, and
+    // points with the same radius share the radius-only terms
+    LednickyBasis basis;
+    std::vector<double> raw(nbins);
+    std::size_t raw_group = static_cast<std::size_t>(-1);
+
+    for (std::size_t c; (c = next_chunk++) < chunks; ) {
+      const std::size_t begin = c * SCAN_CHUNK,
+                        end = std::min(count, begin + SCAN_CHUNK);
+
+      for (std::size_t i = begin; i < end; ++i) {
+        const std::size_t index = first + i;
+        const LednickyEquation_s eq = point(index);
+
+        if (index / lambdas != raw_group) {
+          raw_group = index / lambdas;
+          basis.evaluate(eq, _kstar.data(), raw.data(), nbins);
+        }
+
+        double *cf = out + i * nbins;
+        for (std::size_t b = 0; b < nbins; ++b) {
+          cf[b] = (1.0 + (raw[b] - 1.0) * eq.lamPrimary) / eq.normalization;
+        }
+      }
+    }
+  };
+
+  threads = static_cast<unsigned>(std::min<std::size_t>(threads, chunks));
+  if (threads <= 1) {
+    worker();
+    return;
+  }
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < threads; ++t) {
+    pool.emplace_back(worker);
+  }
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+
+void
+LednickyScan::run(const sink_t& sink, unsigned threads, std::size_t block) const
+{
+  block = std::max<std::size_t>(block, 1);
+  std::vector<double> curves(std::min(block, _size) * bins());
+
+  for (std::size_t first = 0; first < _size; first += block) {
+    const std::size_t count = std::min(block, _size - first);
+    evaluate(first, count, curves.data(), threads);
+    sink(first, count, curves.data());
+  }
+}
@@ -0,0 +1,93 @@
+///
+/// \file scan.h
+/// \brief Parallel evaluation of the Lednicky equation over a parameter grid
+///
+
+#pragma once
+
+#include "lednicky.h"
+
+#include <cstddef>
+#include <functional>
+#include <istream>
+#include <string>
+#include <vector>
+
+/**
+ * ScanGrid
+ * \brief Cartesian grid of Lednicky parameters.
+ *
+ * Each axis holds the values to visit for one parameter; an empty axis
+ * keeps the value of the base equation the scan is started from. Points
+ * are numbered with radius varying slowest and lamPrimary fastest.
+ */
+struct ScanGrid {
+  std::vector<double> radius;
+  std::vector<double> f0re;
+  std::vector<double> f0im;
+  std::vector<double> d0;
+  std::vector<double> lamPrimary;
+
+  /// Axis by name ("radius", "f0re", "f0im", "d0", "lamPrimary"),
+  /// nullptr if there is no such axis
+  std::vector<double>* axis(const std::string& name);
+};
+
+/// Parse an axis specification: either a comma separated list of values
+/// ("0.5,1,2") or an inclusive linear range "start:stop:count", with count
+/// a whole number from 1 to 10^7. Throws std::invalid_argument on malformed
+/// input.
+std::vector<double> parse_scan_axis(const std::string& spec);
+
+/// Read axes from a stream of "<name> <spec>" lines (an optional '='
+/// between name and spec is allowed, '#' starts a comment).
+/// Throws std::invalid_argument on unknown axes or malformed values.
+void read_scan_grid(std::istream& in, ScanGrid& grid);
+
+/**
+ * LednickyScan
+ * \brief Evaluates the correlation function at every point of a ScanGrid
+ *        using all cores.
+ *
+ * Every point produces `base.totalBins` values on the bin-centre k* axis
+ * of `base`, scaled by lamPrimary and normalization as in the single-curve
+ * program: 1 + (C-1)*lamPrimary, divided by normalization.
+ *
+ * The radius is the slowest axis, so each worker keeps a LednickyBasis
+ * and only recomputes the special functions when the radius changes.
+ */
+class LednickyScan {
+public:
+  /// Receives curves [first, first+count) in order, `count * bins()` values
+  typedef std::function<void(std::size_t first, std::size_t count, const double *curves)> sink_t;
+
+  /// Throws std::invalid_argument if the number of grid points does not
+  /// fit in std::size_t
+  LednickyScan(const LednickyEquation_s& base, const ScanGrid& grid);
+
+  /// Number of grid points
+  std::size_t size() const { return _size; }
+
+  /// Number of values in each curve
+  std::size_t bins() const { return _kstar.size(); }
+
+  /// The k* value of every bin
+  const std::vector<double>& kstar() const { return _kstar; }
+
+  /// Parameters of grid point `index`
+  LednickyEquation_s point(std::size_t index) const;
+
+  /// Evaluate points [first, first+count) into `out` (count * bins() values)
+  /// with `threads` worker threads (0: one per hardware thread).
+  void evaluate(std::size_t first, std::size_t count, double *out, unsigned threads = 0) const;
+
+  /// Evaluate the whole grid, `block` points at a time, handing each block
+  /// to `sink` as soon as it is finished.
+  void run(const sink_t& sink, unsigned threads = 0, std::size_t block = 4096) const;
+
+private:
+  LednickyEquation_s _base;
+  std::vector<double> _axes[5];
+  std::size_t _size;
+  std::vector<double> _kstar;
+};
@@ -0,0 +1,69 @@
+///
+/// \file simd.cxx
+/// \brief Runtime selection of the instruction set used by batch kernels
+///
+
+#include "simd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace simd {
+
+static Level
+cpu_level()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return Level::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return Level::AVX2;
+  }
+#endif
+  return Level::Scalar;
+}
+
+static Level
+requested_level(Level best)
+{
+  const char *env = std::getenv("LEDNICKY_SIMD");
+  if (env == nullptr) {
+    return best;
+  }
+
+  Level requested = best;
+  if (std::strcmp(env, "scalar") == 0) {
+    requested = Level::Scalar;
+  } else if (std::strcmp(env, "avx2") == 0) {
+    requested = Level::AVX2;
+  } else if (std::strcmp(env, "avx512") == 0) {
+    requested = Level::AVX512;
+  }
+
+  // never allow selecting instructions the cpu does not have
+  return (static_cast<int>(requested) < static_cast<int>(best)) ? requested : best;
+}
+
+Level
+detect()
+{
+  static const Level level = requested_level(cpu_level());
+  return level;
+}
+
+const char*
+level_name(Level level)
+{
+  switch (level) {
+  case Level::AVX512:
+    return "avx512";
+  case Level::AVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+} // namespace simd
@@ -0,0 +1,631 @@
+///
+/// \file simd.h
+/// \brief Thin vector-register wrappers used by the batch kernels
+///
+/// The batch kernels (see lednicky_kernel.h) are written once against the
+/// small interface provided here and instantiated for every instruction set.
+/// `Vec1d` is a plain double and is always available; `Vec4d` (AVX2+FMA) and
+/// `Vec8d` (AVX-512F) only exist in translation units compiled for those
+/// targets, which the Makefile does with per-file flags. `Vec1f`, `Vec8f`
+/// and `Vec16f` are the single precision counterparts, with twice the lanes.
+///
+/// Every type names its element type (`scalar_t`) and the one-lane type
+/// used for loop remainders (`tail_t`). The double types also load from
+/// float arrays, widening every lane.
+///
+/// Everything besides the runtime detection lives in an unnamed namespace:
+/// the same inline functions are compiled with different `-m` flags in
+/// different object files, and must never be merged by the linker.
+///
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace simd {
+
+/// Instruction sets the batch kernels can be dispatched to
+enum class Level {
+  Scalar,
+  AVX2,
+  AVX512
+};
+
+/// Best instruction set usable on this machine.
+///
+/// Determined once from cpuid; can be lowered (never raised) by setting the
+/// environment variable LEDNICKY_SIMD to "scalar", "avx2" or "avx512".
+Level detect();
+
+/// Human readable name of an instruction set level
+const char* level_name(Level level);
+
+namespace {
+
+/// Scalar "vector" of one lane, used for the fallback path and loop tails
+struct Vec1d {
+  static const std::size_t width = 1;
+  typedef double scalar_t;
+  typedef Vec1d tail_t;
+  typedef bool mask_t;
+  typedef int index_t;
+
+  double v;
+
+  Vec1d() {}
+  Vec1d(double x): v(x) {}
+
+  static Vec1d load(const double *p) { return Vec1d(*p); }
+  static Vec1d load(const float *p) { return Vec1d(*p); }
+  void store(double *p) const { *p = v; }
+};
+
+inline Vec1d operator+(Vec1d a, Vec1d b) { return a.v + b.v; }
+inline Vec1d operator-(Vec1d a, Vec1d b) { return a.v - b.v; }
+inline Vec1d operator*(Vec1d a, Vec1d b) { return a.v * b.v; }
+inline Vec1d operator/(Vec1d a, Vec1d b) { return a.v / b.v; }
+inline Vec1d operator-(Vec1d a) { return -a.v; }
+inline bool operator<(Vec1d a, Vec1d b) { return a.v < b.v; }
+inline bool operator>(Vec1d a, Vec1d b) { return a.v > b.v; }
+inline bool operator<=(Vec1d a, Vec1d b) { return a.v <= b.v; }
+inline bool operator>=(Vec1d a, Vec1d b) { return a.v >= b.v; }
+
+inline Vec1d fma(Vec1d a, Vec1d b, Vec1d c) { return a.v * b.v + c.v; }
+inline Vec1d min(Vec1d a, Vec1d b) { return a.v < b.v ? a.v : b.v; }
+inline Vec1d max(Vec1d a, Vec1d b) { return a.v > b.v ? a.v : b.v; }
+inline Vec1d abs(Vec1d a) { return std::fabs(a.v); }
+inline Vec1d copysign(Vec1d a, Vec1d s) { return std::copysign(a.v, s.v); }
+inline Vec1d truncate(Vec1d a) { return std::trunc(a.v); }
+inline Vec1d select(bool m, Vec1d a, Vec1d b) { return m ? a : b; }
+/// Whether every lane of a comparison holds; also serves Vec1f
+inline bool all(bool m) { return m; }
+inline Vec1d exp(Vec1d a) { return std::exp(a.v); }
+inline Vec1d log(Vec1d a) { return std::log(a.v); }
+inline double sum(Vec1d a) { return a.v; }
+
+inline int to_index(Vec1d a) { return static_cast<int>(a.v); }
+inline Vec1d gather(const double *base, int i) { return base[i]; }
+
+/// Single precision counterpart of Vec1d
+struct Vec1f {
+  static const std::size_t width = 1;
+  typedef float scalar_t;
+  typedef Vec1f tail_t;
+  typedef bool mask_t;
+  typedef int index_t;
+
+  float v;
+
+  Vec1f() {}
+  Vec1f(float x): v(x) {}
+
+  static Vec1f load(const float *p) { return Vec1f(*p); }
+  void store(float *p) const { *p = v; }
+};
+
+inline Vec1f operator+(Vec1f a, Vec1f b) { return a.v + b.v; }
+inline Vec1f operator-(Vec1f a, Vec1f b) { return a.v - b.v; }
+inline Vec1f operator*(Vec1f a, Vec1f b) { return a.v * b.v; }
+inline Vec1f operator/(Vec1f a, Vec1f b) { return a.v / b.v; }
+inline Vec1f operator-(Vec1f a) { return -a.v; }
+inline bool operator<(Vec1f a, Vec1f b) { return a.v < b.v; }
+inline bool operator>(Vec1f a, Vec1f b) { return a.v > b.v; }
+inline bool operator<=(Vec1f a, Vec1f b) { return a.v <= b.v; }
+inline bool operator>=(Vec1f a, Vec1f b) { return a.v >= b.v; }
+
+inline Vec1f fma(Vec1f a, Vec1f b, Vec1f c) { return a.v * b.v + c.v; }
+inline Vec1f min(Vec1f a, Vec1f b) { return a.v < b.v ? a.v : b.v; }
+inline Vec1f max(Vec1f a, Vec1f b) { return a.v > b.v ? a.v : b.v; }
+inline Vec1f abs(Vec1f a) { return std::fabs(a.v); }
+inline Vec1f copysign(Vec1f a, Vec1f s) { return std::copysign(a.v, s.v); }
+inline Vec1f truncate(Vec1f a) { return std::trunc(a.v); }
+inline Vec1f select(bool m, Vec1f a, Vec1f b) { return m ? a : b; }
+inline Vec1f exp(Vec1f a) { return std::exp(a.v); }
+inline Vec1f log(Vec1f a) { return std::log(a.v); }
+inline float sum(Vec1f a) { return a.v; }
+
+inline int to_index(Vec1f a) { return static_cast<int>(a.v); }
+inline Vec1f gather(const float *base, int i) { return base[i]; }
+
+
+#if defined(__AVX2__) && defined(__FMA__)
+
+/// Four doubles in a ymm register
+struct Vec4d {
+  static const std::size_t width = 4;
+  typedef double scalar_t;
+  typedef Vec1d tail_t;
+  typedef __m256d mask_t;
+  typedef __m128i index_t;
+
+  __m256d v;
+
+  Vec4d() {}
+  Vec4d(__m256d x): v(x) {}
+  Vec4d(double x): v(_mm256_set1_pd(x)) {}
+
+  static Vec4d load(const double *p) { return _mm256_loadu_pd(p); }
+  static Vec4d load(const float *p) { return _mm256_cvtps_pd(_mm_loadu_ps(p)); }
+  void store(double *p) const { _mm256_storeu_pd(p, v); }
+};
+
+inline Vec4d operator+(Vec4d a, Vec4d b) { return _mm256_add_pd(a.v, b.v); }
+inline Vec4d operator-(Vec4d a, Vec4d b) { return _mm256_sub_pd(a.v, b.v); }
+inline Vec4d operator*(Vec4d a, Vec4d b) { return _mm256_mul_pd(a.v, b.v); }
+inline Vec4d operator/(Vec4d a, Vec4d b) { return _mm256_div_pd(a.v, b.v); }
+inline Vec4d operator-(Vec4d a) { return _mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)); }
+inline __m256d operator<(Vec4d a, Vec4d b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ); }
+inline __m256d operator>(Vec4d a, Vec4d b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ); }
+inline __m256d operator<=(Vec4d a, Vec4d b) { return _mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ); }
+inline __m256d operator>=(Vec4d a, Vec4d b) { return _mm256_cmp_pd(a.v, b.v, _CMP_GE_OQ); }
+
+inline Vec4d fma(Vec4d a, Vec4d b, Vec4d c) { return _mm256_fmadd_pd(a.v, b.v, c.v); }
+inline Vec4d min(Vec4d a, Vec4d b) { return _mm256_min_pd(a.v, b.v); }
+inline Vec4d max(Vec4d a, Vec4d b) { return _mm256_max_pd(a.v, b.v); }
+inline Vec4d abs(Vec4d a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+inline Vec4d select(__m256d m, Vec4d a, Vec4d b) { return _mm256_blendv_pd(b.v, a.v, m); }
+inline bool all(__m256d m) { return _mm256_movemask_pd(m) == 0xf; }
+
+inline Vec4d
+copysign(Vec4d a, Vec4d s)
+{
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  return _mm256_or_pd(_mm256_andnot_pd(sign, a.v), _mm256_and_pd(sign, s.v));
+}
+
+inline Vec4d
+truncate(Vec4d a)
+{
+  return _mm256_round_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+/// Lanes converted (truncated) to 32 bit indices
+inline __m128i to_index(Vec4d a) { return _mm256_cvttpd_epi32(a.v); }
+
+/// Lanes loaded from base[i] for each index i
+inline Vec4d gather(const double *base, __m128i i) { return _mm256_i32gather_pd(base, i, 8); }
+
+inline Vec4d
+round_nearest(Vec4d a)
+{
+  return _mm256_round_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+/// a * 2^n, where n holds integral values in [-1022, 1023]
+inline Vec4d
+scale_pow2(Vec4d a, Vec4d n)
+{
+  const __m256i e = _mm256_add_epi64(_mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n.v)),
+                                     _mm256_set1_epi64x(1023));
+  return _mm256_mul_pd(a.v, _mm256_castsi256_pd(_mm256_slli_epi64(e, 52)));
+}
+
+/// Mantissa in [0.5, 1) of positive normal lanes, their exponent in `e`
+inline Vec4d
+frexp(Vec4d a, Vec4d &e)
+{
+  const __m256i bits = _mm256_castpd_si256(a.v);
+
+  // the biased exponent n, converted through the bit pattern of 2^52 + n
+  const __m256i biased = _mm256_or_si256(_mm256_srli_epi64(bits, 52),
+                                         _mm256_set1_epi64x(0x4330000000000000LL));
+  e = _mm256_sub_pd(_mm256_castsi256_pd(biased), _mm256_set1_pd(4503599627370496.0 + 1022.0));
+
+  return _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                             _mm256_set1_epi64x(0x3FE0000000000000LL)));
+}
+
+/// Sum of the lanes
+inline double
+sum(Vec4d a)
+{
+  const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(a.v), _mm256_extractf128_pd(a.v, 1));
+  return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+/// Eight floats in a ymm register
+struct Vec8f {
+  static const std::size_t width = 8;
+  typedef float scalar_t;
+  typedef Vec1f tail_t;
+  typedef __m256 mask_t;
+  typedef __m256i index_t;
+
+  __m256 v;
+
+  Vec8f() {}
+  Vec8f(__m256 x): v(x) {}
+  Vec8f(float x): v(_mm256_set1_ps(x)) {}
+
+  static Vec8f load(const float *p) { return _mm256_loadu_ps(p); }
+  void store(float *p) const { _mm256_storeu_ps(p, v); }
+};
+
+inline Vec8f operator+(Vec8f a, Vec8f b) { return _mm256_add_ps(a.v, b.v); }
+inline Vec8f operator-(Vec8f a, Vec8f b) { return _mm256_sub_ps(a.v, b.v); }
+inline Vec8f operator*(Vec8f a, Vec8f b) { return _mm256_mul_ps(a.v, b.v); }
+inline Vec8f operator/(Vec8f a, Vec8f b) { return _mm256_div_ps(a.v, b.v); }
+inline Vec8f operator-(Vec8f a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+inline __m256 operator<(Vec8f a, Vec8f b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+inline __m256 operator>(Vec8f a, Vec8f b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+inline __m256 operator<=(Vec8f a, Vec8f b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+inline __m256 operator>=(Vec8f a, Vec8f b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+
+inline Vec8f fma(Vec8f a, Vec8f b, Vec8f c) { return _mm256_fmadd_ps(a.v, b.v, c.v); }
+inline Vec8f min(Vec8f a, Vec8f b) { return _mm256_min_ps(a.v, b.v); }
+inline Vec8f max(Vec8f a, Vec8f b) { return _mm256_max_ps(a.v, b.v); }
+inline Vec8f abs(Vec8f a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+inline Vec8f select(__m256 m, Vec8f a, Vec8f b) { return _mm256_blendv_ps(b.v, a.v, m); }
+inline bool all(__m256 m) { return _mm256_movemask_ps(m) == 0xff; }
+
+inline Vec8f
+copysign(Vec8f a, Vec8f s)
+{
+  const __m256 sign = _mm256_set1_ps(-0.0f);
+  return _mm256_or_ps(_mm256_andnot_ps(sign, a.v), _mm256_and_ps(sign, s.v));
+}
+
+inline Vec8f
+truncate(Vec8f a)
+{
+  return _mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+/// Lanes converted (truncated) to 32 bit indices
+inline __m256i to_index(Vec8f a) { return _mm256_cvttps_epi32(a.v); }
+
+/// Lanes loaded from base[i] for each index i
+inline Vec8f gather(const float *base, __m256i i) { return _mm256_i32gather_ps(base, i, 4); }
+
+inline Vec8f
+round_nearest(Vec8f a)
+{
+  return _mm256_round_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+/// a * 2^n, where n holds integral values in [-126, 127]
+inline Vec8f
+scale_pow2(Vec8f a, Vec8f n)
+{
+  const __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127));
+  return _mm256_mul_ps(a.v, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+/// Mantissa in [0.5, 1) of positive normal lanes, their exponent in `e`
+inline Vec8f
+frexp(Vec8f a, Vec8f &e)
+{
+  const __m256i bits = _mm256_castps_si256(a.v);
+  e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+  return _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                                             _mm256_set1_epi32(0x3F000000)));
+}
+
+/// Sum of the lanes
+inline float
+sum(Vec8f a)
+{
+  __m128 quad = _mm_add_ps(_mm256_castps256_ps128(a.v), _mm256_extractf128_ps(a.v, 1));
+  quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+  return _mm_cvtss_f32(_mm_add_ss(quad, _mm_shuffle_ps(quad, quad, 1)));
+}
+
+#endif // AVX2
+
+
+#if defined(__AVX512F__)
+
+/// Eight doubles in a zmm register
+struct Vec8d {
+  static const std::size_t width = 8;
+  typedef double scalar_t;
+  typedef Vec1d tail_t;
+  typedef __mmask8 mask_t;
+  typedef __m256i index_t;
+
+  __m512d v;
+
+  Vec8d() {}
+  Vec8d(__m512d x): v(x) {}
+  Vec8d(double x): v(_mm512_set1_pd(x)) {}
+
+  static Vec8d load(const double *p) { return _mm512_loadu_pd(p); }
+  static Vec8d load(const float *p) { return _mm512_cvtps_pd(_mm256_loadu_ps(p)); }
+  void store(double *p) const { _mm512_storeu_pd(p, v); }
+};
+
+inline Vec8d operator+(Vec8d a, Vec8d b) { return _mm512_add_pd(a.v, b.v); }
+inline Vec8d operator-(Vec8d a, Vec8d b) { return _mm512_sub_pd(a.v, b.v); }
+inline Vec8d operator*(Vec8d a, Vec8d b) { return _mm512_mul_pd(a.v, b.v); }
+inline Vec8d operator/(Vec8d a, Vec8d b) { return _mm512_div_pd(a.v, b.v); }
+inline __mmask8 operator<(Vec8d a, Vec8d b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ); }
+inline __mmask8 operator>(Vec8d a, Vec8d b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ); }
+inline __mmask8 operator<=(Vec8d a, Vec8d b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_LE_OQ); }
+inline __mmask8 operator>=(Vec8d a, Vec8d b) { return _mm512_cmp_pd_mask(a.v, b.v, _CMP_GE_OQ); }
+
+inline Vec8d fma(Vec8d a, Vec8d b, Vec8d c) { return _mm512_fmadd_pd(a.v, b.v, c.v); }
+inline Vec8d min(Vec8d a, Vec8d b) { return _mm512_min_pd(a.v, b.v); }
+inline Vec8d max(Vec8d a, Vec8d b) { return _mm512_max_pd(a.v, b.v); }
+inline Vec8d abs(Vec8d a) { return _mm512_abs_pd(a.v); }
+inline Vec8d select(__mmask8 m, Vec8d a, Vec8d b) { return _mm512_mask_blend_pd(m, b.v, a.v); }
+inline bool all(__mmask8 m) { return m == 0xff; }
+
+// AVX-512F only has the sign manipulations on integer registers
+inline Vec8d
+operator-(Vec8d a)
+{
+  const __m512i sign = _mm512_set1_epi64(0x8000000000000000ULL);
+  return _mm512_castsi512_pd(_mm512_xor_epi64(_mm512_castpd_si512(a.v), sign));
+}
+
+inline Vec8d
+copysign(Vec8d a, Vec8d s)
+{
+  const __m512i sign = _mm512_set1_epi64(0x8000000000000000ULL);
+  return _mm512_castsi512_pd(_mm512_or_epi64(_mm512_andnot_epi64(sign, _mm512_castpd_si512(a.v)),
+                                             _mm512_and_epi64(sign, _mm512_castpd_si512(s.v))));
+}
+
+inline Vec8d
+truncate(Vec8d a)
+{
+  return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+/// Lanes converted (truncated) to 32 bit indices
+inline __m256i to_index(Vec8d a) { return _mm512_cvttpd_epi32(a.v); }
+
+/// Lanes loaded from base[i] for each index i
+inline Vec8d gather(const double *base, __m256i i) { return _mm512_i32gather_pd(i, base, 8); }
+
+inline Vec8d
+round_nearest(Vec8d a)
+{
+  return _mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+/// a * 2^n, where n holds integral values
+inline Vec8d
+scale_pow2(Vec8d a, Vec8d n)
+{
+  return _mm512_scalef_pd(a.v, n.v);
+}
+
+/// Mantissa in [0.5, 1) of positive normal lanes, their exponent in `e`
+inline Vec8d
+frexp(Vec8d a, Vec8d &e)
+{
+  e = _mm512_add_pd(_mm512_getexp_pd(a.v), _mm512_set1_pd(1.0));
+  return _mm512_getmant_pd(a.v, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero);
+}
+
+/// Sum of the lanes
+inline double sum(Vec8d a) { return _mm512_reduce_add_pd(a.v); }
+
+/// Sixteen floats in a zmm register
+struct Vec16f {
+  static const std::size_t width = 16;
+  typedef float scalar_t;
+  typedef Vec1f tail_t;
+  typedef __mmask16 mask_t;
+  typedef __m512i index_t;
+
+  __m512 v;
+
+  Vec16f() {}
+  Vec16f(__m512 x): v(x) {}
+  Vec16f(float x): v(_mm512_set1_ps(x)) {}
+
+  static Vec16f load(const float *p) { return _mm512_loadu_ps(p); }
+  void store(float *p) const { _mm512_storeu_ps(p, v); }
+};
+
+inline Vec16f operator+(Vec16f a, Vec16f b) { return _mm512_add_ps(a.v, b.v); }
+inline Vec16f operator-(Vec16f a, Vec16f b) { return _mm512_sub_ps(a.v, b.v); }
+inline Vec16f operator*(Vec16f a, Vec16f b) { return _mm512_mul_ps(a.v, b.v); }
+inline Vec16f operator/(Vec16f a, Vec16f b) { return _mm512_div_ps(a.v, b.v); }
+inline __mmask16 operator<(Vec16f a, Vec16f b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ); }
+inline __mmask16 operator>(Vec16f a, Vec16f b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ); }
+inline __mmask16 operator<=(Vec16f a, Vec16f b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ); }
+inline __mmask16 operator>=(Vec16f a, Vec16f b) { return _mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ); }
+
+inline Vec16f fma(Vec16f a, Vec16f b, Vec16f c) { return _mm512_fmadd_ps(a.v, b.v, c.v); }
+inline Vec16f min(Vec16f a, Vec16f b) { return _mm512_min_ps(a.v, b.v); }
+inline Vec16f max(Vec16f a, Vec16f b) { return _mm512_max_ps(a.v, b.v); }
+inline Vec16f abs(Vec16f a) { return _mm512_abs_ps(a.v); }
+inline Vec16f select(__mmask16 m, Vec16f a, Vec16f b) { return _mm512_mask_blend_ps(m, b.v, a.v); }
+inline bool all(__mmask16 m) { return m == 0xffff; }
+
+inline Vec16f
+operator-(Vec16f a)
+{
+  const __m512i sign = _mm512_set1_epi32(0x80000000);
+  return _mm512_castsi512_ps(_mm512_xor_epi32(_mm512_castps_si512(a.v), sign));
+}
+
+inline Vec16f
+copysign(Vec16f a, Vec16f s)
+{
+  const __m512i sign = _mm512_set1_epi32(0x80000000);
+  return _mm512_castsi512_ps(_mm512_or_epi32(_mm512_andnot_epi32(sign, _mm512_castps_si512(a.v)),
+                                             _mm512_and_epi32(sign, _mm512_castps_si512(s.v))));
+}
+
+inline Vec16f
+truncate(Vec16f a)
+{
+  return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+}
+
+/// Lanes converted (truncated) to 32 bit indices
+inline __m512i to_index(Vec16f a) { return _mm512_cvttps_epi32(a.v); }
+
+/// Lanes loaded from base[i] for each index i
+inline Vec16f gather(const float *base, __m512i i) { return _mm512_i32gather_ps(i, base, 4); }
+
+inline Vec16f
+round_nearest(Vec16f a)
+{
+  return _mm512_roundscale_ps(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+
+/// a * 2^n, where n holds integral values
+inline Vec16f
+scale_pow2(Vec16f a, Vec16f n)
+{
+  return _mm512_scalef_ps(a.v, n.v);
+}
+
+/// Mantissa in [0.5, 1) of positive normal lanes, their exponent in `e`
+inline Vec16f
+frexp(Vec16f a, Vec16f &e)
+{
+  e = _mm512_add_ps(_mm512_getexp_ps(a.v), _mm512_set1_ps(1.0f));
+  return _mm512_getmant_ps(a.v, _MM_MANT_NORM_p5_1, _MM_MANT_SIGN_zero);
+}
+
+/// Sum of the lanes
+inline float sum(Vec16f a) { return _mm512_reduce_add_ps(a.v); }
+
+#endif // AVX512F
+
+
+/// exp(x) for the vector types, following the Cephes range reduction and
+/// Pade approximant (relative error below 2.5e-16 over the whole range).
+/// Arguments below -708 flush to (nearly) zero instead of denormals.
+template <typename V>
+inline V
+exp(V x)
+{
+  const double LOG2E = 1.4426950408889634073599,
+               C1 = 6.93145751953125e-1,
+               C2 = 1.42860682030941723212e-6;
+
+  x = max(min(x, V(709.0)), V(-708.0));
+
+  const V n = round_nearest(x * V(LOG2E)),
+          r = x - n * V(C1) - n * V(C2),
+         rr = r * r;
+
+  const V p = r * fma(fma(V(1.26177193074810590878e-4), rr,
+                          V(3.02994407707441961300e-2)), rr,
+                      V(9.99999999999999999910e-1)),
+          q = fma(fma(fma(V(3.00198505138664455042e-6), rr,
+                          V(2.52448340349684104192e-3)), rr,
+                      V(2.27265548208155028766e-1)), rr,
+                  V(2.00000000000000000009e0));
+
+  return scale_pow2(V(1.0) + V(2.0) * p / (q - p), n);
+}
+
+/// expf for the single precision vector types, following the Cephes range
+/// reduction and polynomial (relative error below 2e-7). Arguments are
+/// clamped to [-87, 88].
+template <typename V>
+inline V
+exp_float(V x)
+{
+  const float LOG2E = 1.44269504088896341f,
+              C1 = 0.693359375f,
+              C2 = -2.12194440e-4f;
+
+  x = max(min(x, V(88.0f)), V(-87.0f));
+
+  const V n = round_nearest(x * V(LOG2E)),
+          r = x - n * V(C1) - n * V(C2);
+
+  const V p = fma(fma(fma(fma(fma(V(1.9875691500e-4f), r,
+                                  V(1.3981999507e-3f)), r,
+                              V(8.3334519073e-3f)), r,
+                          V(4.1665795894e-2f)), r,
+                      V(1.6666665459e-1f)), r,
+                  V(5.0000001201e-1f));
+
+  return scale_pow2(fma(p, r * r, r + V(1.0f)), n);
+}
+
+/// log(x) for the vector types, following the Cephes range reduction and
+/// rational approximation (relative error below 1e-16 over the normal
+/// range). Only defined for positive normal arguments.
+template <typename V>
+inline V
+log(V x)
+{
+  const double SQRTH = 0.70710678118654752440,
+               C1 = 0.693359375,
+               C2 = -2.121944400546905827679e-4;
+
+  // x = m 2^e with m in [sqrt(1/2), sqrt(2))
+  V e;
+  V m = frexp(x, e);
+  const typename V::mask_t low = m < V(SQRTH);
+  e = select(low, e - V(1.0), e);
+  m = select(low, m + m, m) - V(1.0);
+
+  const V z = m * m;
+  const V p = fma(fma(fma(fma(fma(V(1.01875663804580931796e-4), m,
+                                  V(4.97494994976747001425e-1)), m,
+                              V(4.70579119878881725854e0)), m,
+                          V(1.44989225341610930846e1)), m,
+                      V(1.79368678507819816313e1)), m,
+                  V(7.70838733755885391666e0)),
+          q = fma(fma(fma(fma(m + V(1.12873587189167450590e1), m,
+                              V(4.52279145837532221105e1)), m,
+                          V(8.29875266912776603211e1)), m,
+                      V(7.11544750618563894466e1)), m,
+                  V(2.31251620126765340583e1));
+
+  const V y = fma(e, V(C2), fma(V(-0.5), z, m * z * p / q));
+  return fma(e, V(C1), m + y);
+}
+
+/// logf for the single precision vector types, following the Cephes range
+/// reduction and polynomial (relative error below 2e-7). Only defined for
+/// positive normal arguments.
+template <typename V>
+inline V
+log_float(V x)
+{
+  const float SQRTH = 0.707106781186547524f,
+              C1 = 0.693359375f,
+              C2 = -2.12194440e-4f;
+
+  V e;
+  V m = frexp(x, e);
+  const typename V::mask_t low = m < V(SQRTH);
+  e = select(low, e - V(1.0f), e);
+  m = select(low, m + m, m) - V(1.0f);
+
+  const V z = m * m;
+  V p = V(7.0376836292e-2f);
+  p = fma(p, m, V(-1.1514610310e-1f));
+  p = fma(p, m, V(1.1676998740e-1f));
+  p = fma(p, m, V(-1.2420140846e-1f));
+  p = fma(p, m, V(1.4249322787e-1f));
+  p = fma(p, m, V(-1.6668057665e-1f));
+  p = fma(p, m, V(2.0000714765e-1f));
+  p = fma(p, m, V(-2.4999993993e-1f));
+  p = fma(p, m, V(3.3333331174e-1f));
+
+  const V y = fma(e, V(C2), fma(V(-0.5f), z, p * m * z));
+  return fma(e, V(C1), m + y);
+}
+
+#if defined(__AVX2__) && defined(__FMA__)
+inline Vec8f exp(Vec8f x) { return exp_float(x); }
+inline Vec8f log(Vec8f x) { return log_float(x); }
+#endif
+
+#if defined(__AVX512F__)
+inline Vec16f exp(Vec16f x) { return exp_float(x); }
+inline Vec16f log(Vec16f x) { return log_float(x); }
+#endif
+
+} // anonymous namespace
+
+} // namespace simd
@@ -0,0 +1,117 @@
+///
+/// \file smearing.cxx
+/// \brief Implementation of MomentumResponse
+///
+
+#include "smearing.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+MomentumResponse::MomentumResponse()
+{
+}
+
+MomentumResponse::MomentumResponse(const std::vector<double>& true_kstar,
+                                   const std::vector<double>& reco_kstar,
+                                   const BandedMatrix& matrix):
+  _true_kstar(true_kstar),
+  _reco_kstar(reco_kstar),
+  _matrix(matrix)
+{
+  if (matrix.cols() != true_kstar.size() || matrix.rows() != reco_kstar.size()) {
+    throw std::invalid_argument("response matrix does not match its k* axes");
+  }
+  _matrix.normalize_rows();
+}
+
+void
+MomentumResponse::smear(const double *cf, double *out) const
+{
+  _matrix.multiply(cf, out);
+}
+
+void
+MomentumResponse::smear(const double *cf, double *out, std::size_t columns) const
+{
+  for (std::size_t c = 0; c < columns; ++c) {
+    _matrix.multiply(cf + c * true_bins(), out + c * reco_bins());
+  }
+}
+
+MomentumResponse
+read_momentum_response(std::istream& in)
+{
+  std::vector<double> true_kstar, reco_kstar;
+  bool have_axis = false;
+
+  // nonzero band of every row, kept until the widest band is known
+  std::vector<std::size_t> first;
+  std::vector<std::vector<double>> bands;
+  std::size_t width = 0;
+
+  std::size_t line_number = 0;
+  for (std::string line; std::getline(in, line); ) {
+    ++line_number;
+    std::replace(line.begin(), line.end(), ',', ' ');
+
+    std::istringstream fields(line);
+    std::string head;
+    if (!(fields >> head) || head[0] == '#') {
+      continue;
+    }
+
+    const std::string where = "line " + std::to_string(line_number) + ": ";
+    std::vector<double> values;
+    for (double value; fields >> value; ) {
+      values.push_back(value);
+    }
+    if (!fields.eof()) {
+      throw std::invalid_argument(where + "expected numbers");
+    }
+
+    if (!have_axis) {
+      if (head != "true" || values.empty()) {
+        throw std::invalid_argument(where + "expected 'true' and the true k* bin centres");
+      }
+      true_kstar = values;
+      have_axis = true;
+      continue;
+    }
+
+    double kstar;
+    std::istringstream head_value(head);
+    if (!(head_value >> kstar)) {
+      throw std::invalid_argument(where + "expected the reconstructed k* bin centre");
+    }
+    if (values.size() > true_kstar.size()) {
+      throw std::invalid_argument(where + "more counts than true bins");
+    }
+
+    std::size_t begin = 0, end = values.size();
+    while (begin < end && values[begin] == 0.0) {
+      ++begin;
+    }
+    while (end > begin && values[end - 1] == 0.0) {
+      --end;
+    }
+    reco_kstar.push_back(kstar);
+    first.push_back(begin);
+    bands.push_back(std::vector<double>(values.begin() + begin, values.begin() + end));
+    width = std::max(width, end - begin);
+  }
+
+  if (!have_axis) {
+    throw std::invalid_argument("no 'true' k* axis");
+  }
+
+  BandedMatrix matrix(reco_kstar.size(), true_kstar.size(), width);
+  for (std::size_t i = 0; i < bands.size(); ++i) {
+    if (!bands[i].empty()) {
+      matrix.set_row(i, first[i], bands[i].data(), bands[i].size());
+    }
+  }
+  return MomentumResponse(true_kstar, reco_kstar, matrix);
+}
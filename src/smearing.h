@@ -0,0 +1,78 @@
+///
+/// \file smearing.h
+/// \brief Folding of correlation functions with the momentum resolution
+///        of the detector
+///
+
+#pragma once
+
+#include "banded.h"
+
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+/**
+ * MomentumResponse
+ * \brief Detector response matrix from true to reconstructed k*.
+ *
+ * Row i holds the pair counts that were generated in each true k* bin and
+ * reconstructed in bin i; the rows are normalized on construction, so the
+ * smeared correlation function
+ *
+ *   C_reco(k*_i) = sum_j R_ij C(k*_true_j) / sum_j R_ij
+ *
+ * is a weighted average and a flat curve stays flat. Reconstructed bins
+ * without any entries come out as zero.
+ *
+ * The matrix is kept as a BandedMatrix, so smearing costs one contiguous,
+ * vectorized dot product of the band width per reconstructed bin and runs
+ * at close to the memory bandwidth of the band.
+ */
+class MomentumResponse {
+public:
+  /// Empty response of no bins
+  MomentumResponse();
+
+  /// Response `matrix` of the reconstructed bins at `reco_kstar` (rows)
+  /// against the true bins at `true_kstar` (columns). Throws
+  /// std::invalid_argument if the axes do not match the matrix.
+  MomentumResponse(const std::vector<double>& true_kstar,
+                   const std::vector<double>& reco_kstar,
+                   const BandedMatrix& matrix);
+
+  std::size_t true_bins() const { return _true_kstar.size(); }
+  std::size_t reco_bins() const { return _reco_kstar.size(); }
+
+  /// Bin centres (GeV/c) the correlation function is evaluated at
+  const std::vector<double>& true_kstar() const { return _true_kstar; }
+
+  /// Bin centres (GeV/c) of the smeared correlation function
+  const std::vector<double>& reco_kstar() const { return _reco_kstar; }
+
+  const BandedMatrix& matrix() const { return _matrix; }
+
+  /// Smear `cf`, true_bins() values at true_kstar(), into the reco_bins()
+  /// values of `out`
+  void smear(const double *cf, double *out) const;
+
+  /// Smear `columns` curves stored one after the other, e.g. the Jacobian
+  /// of evaluate_lednicky_jacobian()
+  void smear(const double *cf, double *out, std::size_t columns) const;
+
+private:
+  std::vector<double> _true_kstar;
+  std::vector<double> _reco_kstar;
+  BandedMatrix _matrix;
+};
+
+/**
+ * Read a response matrix as text: the first line is 'true' followed by the
+ * true k* bin centres, every following line a reconstructed bin centre
+ * followed by its counts in the true bins, in order (missing trailing
+ * values are zero). Values are separated by whitespace or commas; blank
+ * lines and lines starting with '#' are skipped. Only the band of nonzero
+ * counts of each row is kept. Throws std::invalid_argument, naming the
+ * line, on malformed input.
+ */
+MomentumResponse read_momentum_response(std::istream& in);
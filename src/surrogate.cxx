@@ -0,0 +1,419 @@
+///
+/// \file surrogate.cxx
+/// \brief Implementation of LednickySurrogate
+///
+
+#include "surrogate.h"
+#include "surrogate_kernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+const int LednickySurrogate::AXES;
+
+namespace {
+
+/// Axis names of the error messages, in CurveParameter order
+const char *const AXIS_NAMES[LednickySurrogate::AXES] = {"radius", "f0re", "f0im", "d0"};
+
+/// The grid cell holding `x` along one axis: `count` grid values from
+/// `first` with their linear weights
+struct AxisCell {
+  std::size_t first;
+  int count;
+  double w[2];
+
+  /// (x - x0)(x1 - x), the factor of C''/2 in the interpolation error
+  double spread;
+};
+
+/// The cell of `axis` holding `x`; axes of one value only hold that value
+AxisCell
+locate(const std::vector<double>& axis, double x, int index)
+{
+  const std::size_t n = axis.size();
+  AxisCell cell;
+  if (n == 1) {
+    if (x != axis[0]) {
+      throw std::invalid_argument(std::string(AXIS_NAMES[index]) + " is fixed by the surrogate grid");
+    }
+    cell.first = 0;
+    cell.count = 1;
+    cell.w[0] = 1.0;
+    cell.spread = 0.0;
+    return cell;
+  }
+  if (!(x >= axis.front() && x <= axis.back())) {
+    throw std::invalid_argument(std::string(AXIS_NAMES[index]) + " is outside the surrogate grid");
+  }
+
+  const std::size_t j = std::min<std::size_t>(std::upper_bound(axis.begin(), axis.end(), x) - axis.begin() - 1,
+                                              n - 2);
+  const double u = (x - axis[j]) / (axis[j + 1] - axis[j]);
+  cell.first = j;
+  cell.count = 2;
+  cell.w[0] = 1.0 - u;
+  cell.w[1] = u;
+  cell.spread = (x - axis[j]) * (axis[j + 1] - x);
+  return cell;
+}
+
+/// Largest |second divided difference| over the bins of three curves at
+/// grid values h0 apart and h1 apart, an estimate of |C''|/2
+template <typename T>
+double
+max_second_difference(const T *c0, const T *c1, const T *c2, std::size_t bins, double h0, double h1)
+{
+  const double a = 1.0 / (h0 * (h0 + h1)),
+               b = 1.0 / (h1 * (h0 + h1));
+  double largest = 0.0;
+  for (std::size_t k = 0; k < bins; ++k) {
+    largest = std::max(largest, std::fabs(b * (c2[k] - c1[k]) - a * (c1[k] - c0[k])));
+  }
+  return largest;
+}
+
+} // anonymous namespace
+
+static void
+surrogate_sum_scalar(const double *const *curves, const double *w, int count, double bias,
+                     std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec1d>(curves, w, count, bias, bins, cf);
+}
+
+static void
+surrogate_sum_float_scalar(const float *const *curves, const double *w, int count, double bias,
+                           std::size_t bins, double *cf)
+{
+  surrogate_sum_curves<simd::Vec1d>(curves, w, count, bias, bins, cf);
+}
+
+static surrogate_sum_t
+select_surrogate_kernel()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  switch (simd::detect()) {
+  case simd::Level::AVX512:
+    return surrogate_sum_avx512;
+  case simd::Level::AVX2:
+    return surrogate_sum_avx2;
+  default:
+    break;
+  }
+#endif
+  return surrogate_sum_scalar;
+}
+
+static surrogate_sum_float_t
+select_surrogate_kernel_float()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+  switch (simd::detect()) {
+  case simd::Level::AVX512:
+    return surrogate_sum_float_avx512;
+  case simd::Level::AVX2:
+    return surrogate_sum_float_avx2;
+  default:
+    break;
+  }
+#endif
+  return surrogate_sum_float_scalar;
+}
+
+static surrogate_sum_t
+surrogate_kernel()
+{
+  static const surrogate_sum_t kernel = select_surrogate_kernel();
+  return kernel;
+}
+
+static surrogate_sum_float_t
+surrogate_kernel_float()
+{
+  static const surrogate_sum_float_t kernel = select_surrogate_kernel_float();
+  return kernel;
+}
+
+LednickySurrogate::LednickySurrogate(const std::string& path):
+  _file(path),
+  _error(0.0)
+{
+  const std::size_t curves = _file.size();
+  if (curves == 0 || _file.bins() == 0) {
+    throw std::runtime_error("'" + path + "' holds no curves");
+  }
+
+  const double *columns[AXES] = {
+    _file.parameter(CURVE_RADIUS),
+    _file.parameter(CURVE_F0RE),
+    _file.parameter(CURVE_F0IM),
+    _file.parameter(CURVE_D0)
+  };
+
+  // the stride of each axis is the run of curves sharing every slower
+  // parameter, from the fastest axis up
+  std::size_t strides[AXES];
+  std::size_t stride = 1;
+  for (int a = AXES - 1; a >= 0; --a) {
+    strides[a] = stride;
+    std::size_t run = stride;
+    while (run < curves) {
+      bool same = true;
+      for (int slower = 0; slower < a; ++slower) {
+        same = same && columns[slower][run] == columns[slower][0];
+      }
+      if (!same) {
+        break;
+      }
+      run += stride;
+    }
+    for (std::size_t i = 0; i < run; i += stride) {
+      _axes[a].push_back(columns[a][i]);
+    }
+    stride = run;
+  }
+
+  const char *error = nullptr;
+  if (stride != curves) {
+    error = "is not a parameter grid";
+  }
+  for (int a = 0; a < AXES && error == nullptr; ++a) {
+    if (std::adjacent_find(_axes[a].begin(), _axes[a].end(), std::greater_equal<double>()) != _axes[a].end()) {
+      error = "has a grid axis that is not ascending";
+    }
+  }
+
+  const double lambda = _file.parameter(CURVE_LAMBDA)[0],
+               normalization = _file.parameter(CURVE_NORMALIZATION)[0],
+               identical = _file.parameter(CURVE_IDENTICAL)[0];
+  for (std::size_t i = 0; i < curves && error == nullptr; ++i) {
+    for (int a = 0; a < AXES; ++a) {
+      if (columns[a][i] != _axes[a][(i / strides[a]) % _axes[a].size()]) {
+        error = "is not a parameter grid in scan order";
+      }
+    }
+    if (_file.parameter(CURVE_LAMBDA)[i] != lambda
+        || _file.parameter(CURVE_NORMALIZATION)[i] != normalization
+        || _file.parameter(CURVE_IDENTICAL)[i] != identical) {
+      error = "varies lambda, normalization or identical";
+    }
+  }
+  if (error == nullptr && !(lambda != 0.0 && normalization != 0.0)) {
+    error = "has curves of zero lambda or normalization";
+  }
+  if (error != nullptr) {
+    throw std::runtime_error("'" + path + "' " + error);
+  }
+
+  // the scan stores (1 + (C - 1) lambda)/N
+  _identical = identical != 0.0;
+  _file.kernel_settings(_kernel);
+  _offset = (1.0 - lambda) / normalization;
+  _scale = lambda / normalization;
+
+  measure_curvature(strides);
+}
+
+void
+LednickySurrogate::measure_curvature(const std::size_t *strides)
+{
+  const std::size_t curves = _file.size(),
+                    bins = _file.bins();
+  const double inv_scale = 1.0 / std::fabs(_scale);
+
+  // |C''|/2 along every axis at every grid point, from the three nearest
+  // grid values (the end points share their neighbour's)
+  std::vector<float> point(curves * AXES, 0.0f);
+  for (std::size_t p = 0; p < curves; ++p) {
+    for (int a = 0; a < AXES; ++a) {
+      const std::vector<double>& axis = _axes[a];
+      const std::size_t n = axis.size();
+      if (n < 3) {
+        continue;
+      }
+      const std::size_t i = (p / strides[a]) % n,
+                        c = std::min(std::max<std::size_t>(i, 1), n - 2),
+                        centre = p - i * strides[a] + c * strides[a];
+      const double h0 = axis[c] - axis[c - 1],
+                   h1 = axis[c + 1] - axis[c];
+      double d;
+      if (_file.value_size() == sizeof(double)) {
+        d = max_second_difference(_file.curve_double(centre - strides[a]), _file.curve_double(centre),
+                                  _file.curve_double(centre + strides[a]), bins, h0, h1);
+      } else {
+        d = max_second_difference(_file.curve_float(centre - strides[a]), _file.curve_float(centre),
+                                  _file.curve_float(centre + strides[a]), bins, h0, h1);
+      }
+      point[p * AXES + a] = static_cast<float>(d * inv_scale);
+    }
+  }
+
+  // the largest at the corners of every cell
+  std::size_t cells = 1;
+  for (int a = 0; a < AXES; ++a) {
+    _cells[a] = std::max<std::size_t>(_axes[a].size() - 1, 1);
+    cells *= _cells[a];
+  }
+  std::vector<float> corner(cells * AXES, 0.0f);
+  for (std::size_t cell = 0; cell < cells; ++cell) {
+    std::size_t first = 0,
+                rest = cell;
+    int corners[AXES];
+    for (int a = AXES - 1; a >= 0; --a) {
+      first += (rest % _cells[a]) * strides[a];
+      rest /= _cells[a];
+      corners[a] = (_axes[a].size() == 1) ? 1 : 2;
+    }
+    for (int r = 0; r < corners[0]; ++r) {
+      for (int f = 0; f < corners[1]; ++f) {
+        for (int i = 0; i < corners[2]; ++i) {
+          for (int d = 0; d < corners[3]; ++d) {
+            const std::size_t p = first + r * strides[0] + f * strides[1] + i * strides[2] + d * strides[3];
+            for (int a = 0; a < AXES; ++a) {
+              corner[cell * AXES + a] = std::max(corner[cell * AXES + a], point[p * AXES + a]);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // C'' can grow between the grid points, so along every axis the cell
+  // also takes the value of its neighbours there
+  _curvature = corner;
+  std::size_t cell_stride = 1;
+  for (int a = AXES - 1; a >= 0; --a) {
+    for (std::size_t cell = 0; cell < cells; ++cell) {
+      const std::size_t j = (cell / cell_stride) % _cells[a];
+      float &c = _curvature[cell * AXES + a];
+      if (j > 0) {
+        c = std::max(c, corner[(cell - cell_stride) * AXES + a]);
+      }
+      if (j + 1 < _cells[a]) {
+        c = std::max(c, corner[(cell + cell_stride) * AXES + a]);
+      }
+    }
+    cell_stride *= _cells[a];
+  }
+}
+
+double
+LednickySurrogate::evaluate(const LednickyEquation_s& eq, double *cf) const
+{
+  if (eq.identical != _identical) {
+    throw std::invalid_argument("identical differs from the surrogate grid");
+  }
+
+  const double values[AXES] = {eq.radius, eq.f0re, eq.f0im, eq.d0};
+  AxisCell cells[AXES];
+  for (int a = 0; a < AXES; ++a) {
+    cells[a] = locate(_axes[a], values[a], a);
+  }
+
+  const std::size_t n_f0re = _axes[CURVE_F0RE].size(),
+                    n_f0im = _axes[CURVE_F0IM].size(),
+                    n_d0 = _axes[CURVE_D0].size();
+  const AxisCell &radius = cells[CURVE_RADIUS],
+                 &f0re = cells[CURVE_F0RE],
+                 &f0im = cells[CURVE_F0IM],
+                 &d0 = cells[CURVE_D0];
+
+  // the corners with their weights, divided by the scale of the grid so
+  // that C = sum w stored - offset/scale (the weights sum to 1)
+  std::size_t index[16];
+  double w[16];
+  int count = 0;
+  const double inv_scale = 1.0 / _scale;
+  for (int r = 0; r < radius.count; ++r) {
+    for (int f = 0; f < f0re.count; ++f) {
+      for (int i = 0; i < f0im.count; ++i) {
+        for (int d = 0; d < d0.count; ++d) {
+          const double weight = radius.w[r] * f0re.w[f] * f0im.w[i] * d0.w[d];
+          if (weight == 0.0) {
+            continue;
+          }
+          index[count] = (((radius.first + r) * n_f0re + f0re.first + f) * n_f0im + f0im.first + i) * n_d0
+                       + d0.first + d;
+          w[count] = weight * inv_scale;
+          ++count;
+        }
+      }
+    }
+  }
+
+  const std::size_t bins = _file.bins();
+  const double bias = -_offset * inv_scale;
+  if (_file.value_size() == sizeof(double)) {
+    const double *curves[16];
+    for (int j = 0; j < count; ++j) {
+      curves[j] = _file.curve_double(index[j]);
+    }
+    surrogate_kernel()(curves, w, count, bias, bins, cf);
+  } else {
+    const float *curves[16];
+    for (int j = 0; j < count; ++j) {
+      curves[j] = _file.curve_float(index[j]);
+    }
+    surrogate_kernel_float()(curves, w, count, bias, bins, cf);
+  }
+
+  std::size_t cell = 0;
+  for (int a = 0; a < AXES; ++a) {
+    cell = cell * _cells[a] + cells[a].first;
+  }
+  double error = 0.0;
+  for (int a = 0; a < AXES; ++a) {
+    error += cells[a].spread * _curvature[cell * AXES + a];
+  }
+  return error;
+}
+
+double
+LednickySurrogate::validate(std::size_t samples)
+{
+  // cells of every axis, and their centres
+  std::size_t cells = 1;
+  for (int a = 0; a < AXES; ++a) {
+    cells *= _cells[a];
+  }
+  samples = std::min(samples, cells);
+
+  const std::size_t bins = _file.bins();
+  std::vector<double> exact(bins), interpolated(bins);
+  LednickyEquation_s eq = _kernel;
+  eq.identical = _identical;
+
+  double error = 0.0;
+  for (std::size_t s = 0; s < samples; ++s) {
+    // all cells if there are few, else a golden ratio sequence over them
+    std::size_t cell = s;
+    if (samples < cells) {
+      const double phase = (s + 0.5) * 0.61803398874989484820;
+      cell = std::min(static_cast<std::size_t>((phase - std::floor(phase)) * cells), cells - 1);
+    }
+
+    double centre[AXES];
+    for (int a = AXES - 1; a >= 0; --a) {
+      const std::vector<double>& axis = _axes[a];
+      const std::size_t j = cell % _cells[a];
+      cell /= _cells[a];
+      centre[a] = (axis.size() == 1) ? axis[0] : 0.5 * (axis[j] + axis[j + 1]);
+    }
+    eq.radius = centre[CURVE_RADIUS];
+    eq.f0re = centre[CURVE_F0RE];
+    eq.f0im = centre[CURVE_F0IM];
+    eq.d0 = centre[CURVE_D0];
+
+    evaluate_lednicky_equation(eq, _file.kstar(), exact.data(), bins);
+    evaluate(eq, interpolated.data());
+    for (std::size_t k = 0; k < bins; ++k) {
+      error = std::max(error, std::fabs(interpolated[k] - exact[k]));
+    }
+  }
+
+  _error = error;
+  return error;
+}
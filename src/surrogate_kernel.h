@@ -0,0 +1,62 @@
+///
+/// \file surrogate_kernel.h
+/// \brief Vectorized weighted sum of the corner curves of a surrogate cell
+///
+/// Internal header, instantiated by surrogate.cxx (scalar fallback),
+/// kernels_avx2.cxx and kernels_avx512.cxx like the kernels of
+/// lednicky_kernel.h.
+///
+
+#pragma once
+
+#include "simd.h"
+
+#include <cstddef>
+
+/// cf[k] = bias + sum_j w[j] curves[j][k] for `count` curves of `bins`
+/// values, stored as doubles or floats
+typedef void (*surrogate_sum_t)(const double *const *curves, const double *w, int count,
+                                double bias, std::size_t bins, double *cf);
+typedef void (*surrogate_sum_float_t)(const float *const *curves, const double *w, int count,
+                                      double bias, std::size_t bins, double *cf);
+
+void surrogate_sum_avx2(const double *const*, const double*, int, double, std::size_t, double*);
+void surrogate_sum_float_avx2(const float *const*, const double*, int, double, std::size_t, double*);
+void surrogate_sum_avx512(const double *const*, const double*, int, double, std::size_t, double*);
+void surrogate_sum_float_avx512(const float *const*, const double*, int, double, std::size_t, double*);
+
+namespace {
+
+/// Two vectors of bins at a time, so each curve pointer and weight is
+/// loaded once per pair and the two sums overlap their latencies
+template <typename V, typename T>
+inline void
+surrogate_sum_curves(const T *const *curves, const double *w, int count,
+                     double bias, std::size_t bins, double *cf)
+{
+  using simd::fma;
+  typedef typename V::tail_t V1;
+  const std::size_t W = V::width;
+
+  std::size_t k = 0;
+  for (; k + 2 * W <= bins; k += 2 * W) {
+    V acc0(bias), acc1(bias);
+    for (int j = 0; j < count; ++j) {
+      const V wj(w[j]);
+      acc0 = fma(wj, V::load(curves[j] + k), acc0);
+      acc1 = fma(wj, V::load(curves[j] + k + W), acc1);
+    }
+    acc0.store(cf + k);
+    acc1.store(cf + k + W);
+  }
+
+  for (; k < bins; ++k) {
+    V1 acc(bias);
+    for (int j = 0; j < count; ++j) {
+      acc = fma(V1(w[j]), V1::load(curves[j] + k), acc);
+    }
+    acc.store(cf + k);
+  }
+}
+
+} // anonymous namespace